@@ -0,0 +1,233 @@
+/*
+ * Binary image utilities
+ *
+ * Contains functions to generate the compact binary image responses a host may request
+ * instead of json image responses.  A binary response is a fixed length header followed
+ * by the raw pixels and raw telemetry so there is no base64 encoding or json printing.
+ * All multi-byte values are little-endian (the ESP32's native byte order so the pixels
+ * and telemetry are copied directly).
+ *
+ *   Offset  Size  Item
+ *     0      1    CMD_BINARY_START
+ *     1      1    BIN_VERSION
+ *     2      2    Header length (BIN_HEADER_LEN)
+ *     4      4    Payload length (bytes following the header)
+ *     8      4    Frame sequence number
+ *    12      4    Time (seconds since 1/1/1970)
+ *    16      2    Time milliseconds
+ *    18      2    Flags (BIN_FLAG_xxx)
+ *    20      2    Width
+ *    22      2    Height
+ *    24      2    Minimum pixel value
+ *    26      2    Maximum pixel value
+ *    28      2    Telemetry length (bytes)
+ *    30      2    Crop row
+ *    32      2    Crop column
+ *    34      2    Decimation scale
+ *
+ * The start byte can not start a json response so a host can tell the two apart, and the
+ * payload length lets it skip to the next response.
+ *
+ * Responses are built in the same pre-allocated image buffer as json image responses.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "bin_utilities.h"
+#include "agc_utilities.h"
+#include "cmd_utilities.h"
+#include "crop_utilities.h"
+#include "decimate_utilities.h"
+#include "lepton_utilities.h"
+#include "temp_utilities.h"
+#include "time_utilities.h"
+#include "system_config.h"
+#include "vospi.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include <string.h>
+
+
+
+//
+// Binary Utilities variables
+//
+static const char* TAG = "bin_utilities";
+
+
+
+//
+// Binary Utilities Forward Declarations for internal functions
+//
+static uint32_t bin_add_image(char* bin_image, lep_buffer_t* lep_buffer, uint8_t* pixP, int w, int h, uint16_t flags,
+	uint16_t min_val, uint16_t max_val, int row, int col, int scale);
+static void bin_put16(char* bufP, uint16_t v);
+static void bin_put32(char* bufP, uint32_t v);
+
+
+
+//
+// Binary Utilities API
+//
+
+/**
+ * Load a binary response for a lepton image into the pre-allocated image buffer.  Returns
+ * a non-zero length for a successful operation.
+ */
+uint32_t bin_get_image(char* bin_image, lep_buffer_t* lep_buffer)
+{
+	return bin_add_image(bin_image, lep_buffer, (uint8_t*) lep_buffer->lep_bufferP, LEP_WIDTH, LEP_HEIGHT, 0,
+		lep_buffer->lep_min_val, lep_buffer->lep_max_val, 0, 0, 1);
+}
+
+
+/**
+ * Load a binary response for a decimated lepton image into the pre-allocated image buffer.
+ * The minimum and maximum are those of the thumbnail.  Returns a non-zero length for a
+ * successful operation.
+ */
+uint32_t bin_get_decimated_image(char* bin_image, lep_buffer_t* lep_buffer, int factor, int mode)
+{
+	uint16_t* dec_imgP;
+	uint16_t min_val, max_val;
+	
+	dec_imgP = decimate_process(lep_buffer->lep_bufferP, factor, mode, &min_val, &max_val);
+	if (dec_imgP == NULL) return 0;
+	
+	return bin_add_image(bin_image, lep_buffer, (uint8_t*) dec_imgP, LEP_WIDTH / factor, LEP_HEIGHT / factor,
+		BIN_FLAG_DECIMATED, min_val, max_val, 0, 0, factor);
+}
+
+
+/**
+ * Load a binary response for a rectangle cropped from a lepton image into the
+ * pre-allocated image buffer.  The minimum and maximum are those of the cropped pixels.
+ * Returns a non-zero length for a successful operation.
+ */
+uint32_t bin_get_cropped_image(char* bin_image, lep_buffer_t* lep_buffer, int r1, int c1, int r2, int c2)
+{
+	uint16_t* crop_imgP;
+	uint16_t min_val, max_val;
+	
+	crop_imgP = crop_process(lep_buffer->lep_bufferP, r1, c1, r2, c2, &min_val, &max_val);
+	if (crop_imgP == NULL) return 0;
+	
+	return bin_add_image(bin_image, lep_buffer, (uint8_t*) crop_imgP, c2 - c1 + 1, r2 - r1 + 1,
+		BIN_FLAG_CROPPED, min_val, max_val, r1, c1, 1);
+}
+
+
+/**
+ * Load a binary response for an 8-bit AGC preview of a lepton image into the
+ * pre-allocated image buffer.  The minimum and maximum are the scene range mapped to the
+ * preview.  Returns a non-zero length for a successful operation.
+ */
+uint32_t bin_get_agc_image(char* bin_image, lep_buffer_t* lep_buffer)
+{
+	uint8_t* agc_imgP;
+	uint16_t lo, hi;
+	
+	agc_imgP = agc_process(lep_buffer, &lo, &hi);
+	if (agc_imgP == NULL) return 0;
+	
+	return bin_add_image(bin_image, lep_buffer, agc_imgP, LEP_WIDTH, LEP_HEIGHT, BIN_FLAG_8BIT | BIN_FLAG_AGC,
+		lo, hi, 0, 0, 1);
+}
+
+
+
+//
+// Binary Utilities internal functions
+//
+
+/**
+ * Load the header, w x h pixels and telemetry into the image buffer.  Returns the total
+ * length.
+ */
+static uint32_t bin_add_image(char* bin_image, lep_buffer_t* lep_buffer, uint8_t* pixP, int w, int h, uint16_t flags,
+	uint16_t min_val, uint16_t max_val, int row, int col, int scale)
+{
+	bool agc_state;
+	int pix_len;
+	int telem_len;
+	tmElements_t te;
+	
+	// Fill in the flags describing the image data.  Telemetry is only included when the
+	// frame has it, otherwise the AGC state comes from the configuration.
+	if (lep_buffer->telem_valid) {
+		agc_state = (lepton_get_tel_status(lep_buffer->lep_telemP) & LEP_STATUS_AGC_STATE) != 0;
+		flags |= BIN_FLAG_TELEM;
+		telem_len = LEP_TEL_WORDS * 2;
+	} else {
+		agc_state = system_get_lep_st()->agc_set_enabled;
+		telem_len = 0;
+	}
+	if (agc_state) {
+		flags |= BIN_FLAG_AGC;
+	} else if (temp_get_resolution(lep_buffer) == TEMP_RES_HIGH) {
+		flags |= BIN_FLAG_TLIN_HIGH;
+	}
+	
+	pix_len = w * h * (((flags & BIN_FLAG_8BIT) != 0) ? 1 : 2);
+	if ((BIN_HEADER_LEN + pix_len + telem_len) > JSON_MAX_IMAGE_TEXT_LEN) {
+		ESP_LOGE(TAG, "binary image too large (%d bytes)", BIN_HEADER_LEN + pix_len + telem_len);
+		return 0;
+	}
+	
+	time_get(&te);
+	
+	// Header
+	*bin_image = CMD_BINARY_START;
+	*(bin_image + 1) = BIN_VERSION;
+	bin_put16(bin_image + 2, BIN_HEADER_LEN);
+	bin_put32(bin_image + 4, pix_len + telem_len);
+	bin_put32(bin_image + 8, lep_buffer->frame_num);
+	bin_put32(bin_image + 12, (uint32_t) rtc_makeTime(te));
+	bin_put16(bin_image + 16, te.Millisecond);
+	bin_put16(bin_image + 18, flags);
+	bin_put16(bin_image + 20, w);
+	bin_put16(bin_image + 22, h);
+	bin_put16(bin_image + 24, min_val);
+	bin_put16(bin_image + 26, max_val);
+	bin_put16(bin_image + 28, telem_len);
+	bin_put16(bin_image + 30, row);
+	bin_put16(bin_image + 32, col);
+	bin_put16(bin_image + 34, scale);
+	
+	// Raw pixels and telemetry
+	memcpy(bin_image + BIN_HEADER_LEN, pixP, pix_len);
+	if (telem_len != 0) {
+		memcpy(bin_image + BIN_HEADER_LEN + pix_len, lep_buffer->lep_telemP, telem_len);
+	}
+	
+	return BIN_HEADER_LEN + pix_len + telem_len;
+}
+
+
+static void bin_put16(char* bufP, uint16_t v)
+{
+	*bufP = v & 0xFF;
+	*(bufP + 1) = v >> 8;
+}
+
+
+static void bin_put32(char* bufP, uint32_t v)
+{
+	bin_put16(bufP, v & 0xFFFF);
+	bin_put16(bufP + 2, v >> 16);
+}
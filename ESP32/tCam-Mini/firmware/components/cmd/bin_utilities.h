@@ -0,0 +1,67 @@
+/*
+ * Binary image utilities
+ *
+ * Contains functions to generate the compact binary image responses a host may request
+ * instead of json image responses.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef BIN_UTILITIES_H
+#define BIN_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Binary Utilities constants
+//
+
+// Header format version
+#define BIN_VERSION            1
+
+// Header length (bytes)
+#define BIN_HEADER_LEN         36
+
+// Header flags
+//   BIN_FLAG_TELEM     - Telemetry follows the pixels
+//   BIN_FLAG_8BIT      - One byte per pixel (otherwise two)
+//   BIN_FLAG_AGC       - Pixels are AGC values instead of radiometric values
+//   BIN_FLAG_TLIN_HIGH - Radiometric pixels are K x 100 (otherwise K x 10)
+//   BIN_FLAG_DECIMATED - Thumbnail (decimated by the header scale)
+//   BIN_FLAG_CROPPED   - Rectangle cropped from the image at the header row and column
+#define BIN_FLAG_TELEM         0x0001
+#define BIN_FLAG_8BIT          0x0002
+#define BIN_FLAG_AGC           0x0004
+#define BIN_FLAG_TLIN_HIGH     0x0008
+#define BIN_FLAG_DECIMATED     0x0010
+#define BIN_FLAG_CROPPED       0x0020
+
+
+
+//
+// Binary Utilities API
+//
+uint32_t bin_get_image(char* bin_image, lep_buffer_t* lep_buffer);
+uint32_t bin_get_decimated_image(char* bin_image, lep_buffer_t* lep_buffer, int factor, int mode);
+uint32_t bin_get_cropped_image(char* bin_image, lep_buffer_t* lep_buffer, int r1, int c1, int r2, int c2);
+uint32_t bin_get_agc_image(char* bin_image, lep_buffer_t* lep_buffer);
+
+#endif /* BIN_UTILITIES_H */
@@ -23,7 +23,13 @@
  */
 
 #include "cmd_utilities.h"
+#include "agc_utilities.h"
+#include "alarm_utilities.h"
+#include "burst_utilities.h"
+#include "filter_utilities.h"
+#include "roi_utilities.h"
 #include "cci.h"
+#include "ctrl_task.h"
 #include "rsp_task.h"
 #include "json_utilities.h"
 #include "lepton_utilities.h"
@@ -67,13 +73,20 @@ static void process_rx_packet();
 static void push_response(char* buf, uint32_t len);
 static bool process_set_config(cJSON* cmd_args);
 static bool process_set_spotmeter(cJSON* cmd_args);
+static bool process_get_image(cJSON* cmd_args);
 static bool process_stream_on(cJSON* cmd_args);
+static bool process_burst_on(cJSON* cmd_args);
+static bool process_set_filter(cJSON* cmd_args);
+static bool process_set_roi(cJSON* cmd_args);
+static bool process_set_alarm(cJSON* cmd_args);
+static bool process_set_agc_preview(cJSON* cmd_args);
 static bool process_set_time(cJSON* cmd_args);
 static bool process_set_wifi(cJSON* cmd_args);
 static bool process_get_lep_cci(cJSON* cmd_args);
 static bool process_set_lep_cci(cJSON* cmd_args);
 static bool process_fw_upd_request(cJSON* cmd_args);
 static bool process_fw_segment(cJSON* cmd_args);
+static bool binary_allowed(bool binary);
 static int in_buffer(char c);
 
 
@@ -192,7 +205,9 @@ static void process_rx_packet()
 					break;
 					
 				case CMD_GET_IMAGE:
-					xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_GET_IMG_MASK, eSetBits);
+					if (!process_get_image(cmd_args)) {
+						cmd_success = 2;
+					}
 					break;
 					
 				case CMD_SET_TIME:					
@@ -296,6 +311,68 @@ static void process_rx_packet()
 					}
 					break;
 				
+				case CMD_BURST_ON:
+					if (process_burst_on(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_BURST_TRIG:
+					if (burst_trigger()) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_BURST_GET:
+					if (burst_get_state() != BURST_STATE_OFF) {
+						xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_BURST_GET_MASK, eSetBits);
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_BURST_OFF:
+					burst_off();
+					cmd_success = 1;
+					break;
+				
+				case CMD_SET_FILTER:
+					if (process_set_filter(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_SET_ROI:
+					if (process_set_roi(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_SET_ALARM:
+					if (process_set_alarm(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_SET_AGC_PREVIEW:
+					if (process_set_agc_preview(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
 				case CMD_TAKE_PIC:
 				case CMD_RECORD_ON:			
 				case CMD_RECORD_OFF:
@@ -423,12 +500,26 @@ static bool process_set_spotmeter(cJSON* cmd_args)
 }
 
 
+static bool process_get_image(cJSON* cmd_args)
+{
+	bool binary;
+	
+	if (json_parse_get_image(cmd_args, &binary) && binary_allowed(binary)) {
+		rsp_set_image_parameters(binary);
+		xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_GET_IMG_MASK, eSetBits);
+		return true;
+	}
+	
+	return false;
+}
+
+
 static bool process_stream_on(cJSON* cmd_args)
 {
-	uint32_t delay_ms, num_frames;
+	json_stream_on_t stream_params;
 	
-	if (json_parse_stream_on(cmd_args, &delay_ms, &num_frames)) {
-		rsp_set_stream_parameters(delay_ms, num_frames);
+	if (json_parse_stream_on(cmd_args, &stream_params) && binary_allowed(stream_params.binary)) {
+		rsp_set_stream_parameters(&stream_params);
 		xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_STREAM_ON_MASK, eSetBits);
 		return true;
 	}
@@ -437,6 +528,72 @@ static bool process_stream_on(cJSON* cmd_args)
 }
 
 
+static bool process_burst_on(cJSON* cmd_args)
+{
+	int post_frames;
+	
+	if (json_parse_burst_on(cmd_args, &post_frames)) {
+		return burst_arm(post_frames);
+	}
+	
+	return false;
+}
+
+
+static bool process_set_filter(cJSON* cmd_args)
+{
+	int mode, strength, motion;
+	
+	if (json_parse_set_filter(cmd_args, &mode, &strength, &motion)) {
+		filter_set_config(mode, strength, motion);
+		return true;
+	}
+	
+	return false;
+}
+
+
+static bool process_set_roi(cJSON* cmd_args)
+{
+	int num;
+	roi_def_t defs[ROI_MAX_NUM];
+	
+	if (json_parse_set_roi(cmd_args, defs, &num)) {
+		roi_set_regions(defs, num);
+		return true;
+	}
+	
+	return false;
+}
+
+
+static bool process_set_alarm(cJSON* cmd_args)
+{
+	int num;
+	alarm_rule_t rules[ALARM_MAX_NUM];
+	
+	if (json_parse_set_alarm(cmd_args, rules, &num)) {
+		alarm_set_rules(rules, num);
+		return true;
+	}
+	
+	return false;
+}
+
+
+static bool process_set_agc_preview(cJSON* cmd_args)
+{
+	agc_config_t config;
+	
+	if (json_parse_set_agc_preview(cmd_args, &config)) {
+		agc_set_config(&config);
+		return true;
+	}
+	
+	return false;
+}
+
+
 static bool process_set_time(cJSON* cmd_args)
 {
 	tmElements_t te;
@@ -566,6 +723,28 @@ static bool process_fw_segment(cJSON* cmd_args)
 }
 
 
+/**
+ * Return false (and log why) if binary images were requested on the serial interface.
+ * Hosts on that interface read each image over the SPI slave interface as a delimited
+ * json image after its image_ready response.
+ */
+static bool binary_allowed(bool binary)
+{
+	int brd_type;
+	int if_type;
+	
+	if (binary) {
+		ctrl_get_if_mode(&brd_type, &if_type);
+		if (if_type == CTRL_IF_MODE_SIF) {
+			ESP_LOGE(TAG, "Binary images are not supported on the serial interface");
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
 /**
  * Look for c in the rx_circular_buffer and return its location if found, -1 otherwise
  */
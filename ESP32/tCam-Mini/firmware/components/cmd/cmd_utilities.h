@@ -57,7 +57,15 @@
 #define CMD_FW_UPD_REQ  20
 #define CMD_FW_UPD_SEG  21
 #define CMD_DUMP_SCREEN 22
-#define CMD_NUM         23
+#define CMD_BURST_ON    23
+#define CMD_BURST_TRIG  24
+#define CMD_BURST_GET   25
+#define CMD_BURST_OFF   26
+#define CMD_SET_FILTER  27
+#define CMD_SET_ROI     28
+#define CMD_SET_ALARM   29
+#define CMD_SET_AGC_PREVIEW 30
+#define CMD_NUM         31
 
 #define CMD_UNKNOWN     999
 
@@ -85,12 +93,23 @@
 #define CMD_FW_UPD_REQ_S  "fw_update_request"
 #define CMD_FW_UPD_SEG_S  "fw_segment"
 #define CMD_DUMP_SCREEN_S "dump_screen"
+#define CMD_BURST_ON_S    "burst_on"
+#define CMD_BURST_TRIG_S  "burst_trigger"
+#define CMD_BURST_GET_S   "burst_get"
+#define CMD_BURST_OFF_S   "burst_off"
+#define CMD_SET_FILTER_S  "set_filter"
+#define CMD_SET_ROI_S     "set_roi"
+#define CMD_SET_ALARM_S   "set_alarm"
+#define CMD_SET_AGC_PREVIEW_S "set_agc_preview"
 
 
 // Delimiters used to wrap json strings sent over the network
 #define CMD_JSON_STRING_START 0x02
 #define CMD_JSON_STRING_STOP  0x03
 
+// Start of a binary image response (followed by its header and payload, see bin_utilities)
+#define CMD_BINARY_START      0x01
+
 
 //
 // CMD Utilities API
@@ -31,6 +31,13 @@
  *
  */
 #include "json_utilities.h"
+#include "agc_utilities.h"
+#include "burst_utilities.h"
+#include "change_utilities.h"
+#include "crop_utilities.h"
+#include "decimate_utilities.h"
+#include "filter_utilities.h"
+#include "isotherm_utilities.h"
 #include "ps_utilities.h"
 #include "lepton_utilities.h"
 #include "time_utilities.h"
@@ -38,6 +45,8 @@
 #include "ps_utilities.h"
 #include "upd_utilities.h"
 #include "ctrl_task.h"
+#include "lep_task.h"
+#include "rsp_task.h"
 #include "system_config.h"
 #include "vospi.h"
 #include "mbedtls/base64.h"
@@ -45,6 +54,7 @@
 #include "esp_ota_ops.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include <math.h>
 #include <string.h>
 
 
@@ -86,11 +96,62 @@ const cmd_name_t command_list[CMD_NUM] = {
 	{CMD_SET_LEP_CCI_S, CMD_SET_LEP_CCI},
 	{CMD_FW_UPD_REQ_S, CMD_FW_UPD_REQ},
 	{CMD_FW_UPD_SEG_S, CMD_FW_UPD_SEG},
-	{CMD_DUMP_SCREEN_S, CMD_DUMP_SCREEN}
+	{CMD_DUMP_SCREEN_S, CMD_DUMP_SCREEN},
+	{CMD_BURST_ON_S, CMD_BURST_ON},
+	{CMD_BURST_TRIG_S, CMD_BURST_TRIG},
+	{CMD_BURST_GET_S, CMD_BURST_GET},
+	{CMD_BURST_OFF_S, CMD_BURST_OFF},
+	{CMD_SET_FILTER_S, CMD_SET_FILTER},
+	{CMD_SET_ROI_S, CMD_SET_ROI},
+	{CMD_SET_ALARM_S, CMD_SET_ALARM},
+	{CMD_SET_AGC_PREVIEW_S, CMD_SET_AGC_PREVIEW}
 };
 
 
 
+//
+// JSON Utilities internal typedefs
+//
+
+// Adds the items specific to one kind of image response to its metadata object
+typedef void (*json_meta_items_fn)(cJSON* meta, const void* argP);
+
+// Image data (and telemetry) of an image response
+typedef struct {
+	const char* name;            // Image object name
+	uint8_t* dataP;
+	int len;                     // Bytes
+	uint16_t* telemP;            // Telemetry or NULL for none
+} json_image_data_t;
+
+// Metadata callback arguments
+typedef struct {
+	uint32_t frame_num;
+	int factor;
+	int mode;
+} json_decimate_meta_t;
+
+typedef struct {
+	uint32_t frame_num;
+	int r1, c1, r2, c2;
+} json_crop_meta_t;
+
+typedef struct {
+	uint32_t frame_num;
+	int32_t lo;
+	int32_t hi;
+	int pixels;
+	int encoding;
+} json_isotherm_meta_t;
+
+typedef struct {
+	uint32_t frame_num;
+	uint16_t lo;
+	uint16_t hi;
+} json_agc_meta_t;
+
+
+
 //
 // JSON Utilities variables
 //
@@ -104,18 +165,29 @@ static unsigned char* base64_cci_reg_data;
 
 static uint16_t* cci_buf;           // Used to hold Lepton CCI data from cmd or for rsp
 
+static roi_stats_t roi_stats[ROI_MAX_NUM];  // Used by rsp to hold region statistics
+
 
 
 //
 // JSON Utilities Forward Declarations for internal functions
 //
-static bool json_add_lep_image_object(cJSON* parent, lep_buffer_t* lep_buffer);
+static bool json_add_lep_image_object(cJSON* parent, const char* name, uint8_t* dataP, int len);
 static void json_free_lep_base64_image();
-static bool json_add_lep_telem_object(cJSON* parent, lep_buffer_t* lep_buffer);
+static bool json_add_lep_telem_object(cJSON* parent, uint16_t* lep_telemP);
 static void json_free_lep_base64_telem();
 static bool json_add_cci_reg_base64_data(cJSON* parent, int len, uint16_t* buf);
 static void json_free_cci_reg_base64_data();
 static bool json_add_metadata_object(cJSON* parent);
+static void json_add_roi_object(cJSON* parent, lep_buffer_t* lep_buffer);
+static void json_add_stage_time_items(cJSON* parent, const char* name, sys_stage_time_t* stP);
+static uint32_t json_finish_image_string(cJSON* root, char* json_image_text, bool metadata, json_meta_items_fn add_meta,
+	const void* argP, json_image_data_t* imgP, const char* desc);
+static void json_add_frame_meta(cJSON* meta, const void* argP);
+static void json_add_decimate_meta(cJSON* meta, const void* argP);
+static void json_add_crop_meta(cJSON* meta, const void* argP);
+static void json_add_isotherm_meta(cJSON* meta, const void* argP);
+static void json_add_agc_meta(cJSON* meta, const void* argP);
 static uint32_t json_generate_response_string(cJSON* root, char* json_string);
 static bool json_ip_string_to_array(uint8_t* ip_array, char* ip_string);
 
@@ -157,7 +229,7 @@ cJSON* json_get_cmd_object(char* json_string)
 	
 	ret = cJSON_Parse(json_string);
 	if (ret == NULL) {
-		ESP_LOGE(TAG, "Parse error at %d", cJSON_GetErrorPtr() - json_string);
+		ESP_LOGE(TAG, "Parse error at %d", (int) (cJSON_GetErrorPtr() - json_string));
 	}
 	return ret;
 }
@@ -175,39 +247,220 @@ cJSON* json_get_cmd_object(char* json_string)
  */
 uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buffer)
 {
-	bool success;
+	cJSON* root;
+	json_image_data_t img = {"radiometric", (uint8_t*) lep_buffer->lep_bufferP, LEP_NUM_PIXELS*2, lep_buffer->lep_telemP};
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	// Region statistics first so a host can use them without parsing the image
+	if (roi_get_num() != 0) {
+		json_add_roi_object(root, lep_buffer);
+	}
+	
+	// Frame sequence number so a host can detect frames lost when the frame ring overflows
+	return json_finish_image_string(root, json_image_text, true, json_add_frame_meta, &lep_buffer->frame_num, &img, "image");
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * json objects for a decimated lepton image.  Returns a non-zero length for a successful
+ * operation.
+ *   - Image meta-data (including the decimated image size)
+ *   - Base64 encoded decimated image
+ *   - Base64 encoded telemetry from the Lepton
+ *
+ * This function handles its own memory management.
+ */
+uint32_t json_get_decimated_image_string(char* json_image_text, lep_buffer_t* lep_buffer, int factor, int mode)
+{
+	cJSON* root;
+	json_decimate_meta_t meta = {lep_buffer->frame_num, factor, mode};
+	json_image_data_t img = {"radiometric", NULL, (LEP_NUM_PIXELS / (factor * factor)) * 2, lep_buffer->lep_telemP};
+	
+	img.dataP = (uint8_t*) decimate_process(lep_buffer->lep_bufferP, factor, mode, NULL, NULL);
+	if (img.dataP == NULL) return 0;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	if (roi_get_num() != 0) {
+		json_add_roi_object(root, lep_buffer);
+	}
+	
+	return json_finish_image_string(root, json_image_text, true, json_add_decimate_meta, &meta, &img, "decimated image");
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * json objects for a rectangle cropped from a lepton image.  Returns a non-zero length
+ * for a successful operation.
+ *   - Image meta-data (including the crop rectangle)
+ *   - Base64 encoded cropped image
+ *   - Base64 encoded telemetry from the Lepton
+ *
+ * This function handles its own memory management.
+ */
+uint32_t json_get_cropped_image_string(char* json_image_text, lep_buffer_t* lep_buffer, int r1, int c1, int r2, int c2)
+{
+	cJSON* root;
+	json_crop_meta_t meta = {lep_buffer->frame_num, r1, c1, r2, c2};
+	json_image_data_t img = {"radiometric", NULL, (c2 - c1 + 1) * (r2 - r1 + 1) * 2, lep_buffer->lep_telemP};
+	
+	img.dataP = (uint8_t*) crop_process(lep_buffer->lep_bufferP, r1, c1, r2, c2, NULL, NULL);
+	if (img.dataP == NULL) return 0;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	if (roi_get_num() != 0) {
+		json_add_roi_object(root, lep_buffer);
+	}
+	
+	return json_finish_image_string(root, json_image_text, true, json_add_crop_meta, &meta, &img, "cropped image");
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * json objects for the isotherm mask of a lepton image (pixels from lo to hi °C x 100)
+ * instead of the image.  Returns a non-zero length for a successful operation.
+ *   - Image meta-data (including the band and mask encoding)
+ *   - Base64 encoded mask
+ *
+ * This function handles its own memory management.
+ */
+uint32_t json_get_isotherm_string(char* json_image_text, lep_buffer_t* lep_buffer, int32_t lo, int32_t hi)
+{
+	cJSON* root;
+	int res;
+	json_isotherm_meta_t meta = {lep_buffer->frame_num, lo, hi, 0, 0};
+	json_image_data_t img = {"isotherm", NULL, 0, NULL};
+	
+	// The band is converted to counts for each image since the resolution follows the gain mode
+	res = temp_get_resolution(lep_buffer);
+	img.dataP = isotherm_process(lep_buffer->lep_bufferP, temp_c100_to_counts(lo, res), temp_c100_to_counts(hi, res),
+		&meta.encoding, &img.len, &meta.pixels);
+	if (img.dataP == NULL) return 0;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	return json_finish_image_string(root, json_image_text, true, json_add_isotherm_meta, &meta, &img, "isotherm");
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * json objects for an 8-bit AGC preview of a lepton image.  Returns a non-zero length
+ * for a successful operation.
+ *   - Image meta-data (including the scene range mapped to the preview)
+ *   - Base64 encoded 8-bit preview image
+ *   - Base64 encoded telemetry from the Lepton
+ *
+ * This function handles its own memory management.
+ */
+uint32_t json_get_agc_image_string(char* json_image_text, lep_buffer_t* lep_buffer)
+{
+	cJSON* root;
+	json_agc_meta_t meta = {lep_buffer->frame_num, 0, 0};
+	json_image_data_t img = {"agc", NULL, LEP_NUM_PIXELS, lep_buffer->lep_telemP};
+	
+	img.dataP = agc_process(lep_buffer, &meta.lo, &meta.hi);
+	if (img.dataP == NULL) return 0;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	if (roi_get_num() != 0) {
+		json_add_roi_object(root, lep_buffer);
+	}
+	
+	return json_finish_image_string(root, json_image_text, true, json_add_agc_meta, &meta, &img, "agc image");
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * the statistics of each region of interest for a lepton image instead of the image.
+ * Returns a non-zero length for a successful operation.
+ */
+uint32_t json_get_roi_string(char* json_image_text, lep_buffer_t* lep_buffer)
+{
 	int len = 0;
 	cJSON* root;
 	
 	root = cJSON_CreateObject();
 	if (root == NULL) return 0;
 	
-	// Construct the json object
-	success = json_add_metadata_object(root);
-	if (success) {
-		success = json_add_lep_image_object(root, lep_buffer);
-		if (success) {
-			success = json_add_lep_telem_object(root, lep_buffer);
-			if (!success) {
-				// Free lep_image that was already allocated
-				json_free_lep_base64_image();
-			}
-		}
+	json_add_roi_object(root, lep_buffer);
+	
+	// Tightly print the object to our buffer
+	if (cJSON_PrintPreallocated(root, json_image_text, JSON_MAX_IMAGE_TEXT_LEN, false) != 0) {
+		len = strlen(json_image_text);
 	}
 	
+	cJSON_Delete(root);
+	
+	return len;
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * json objects for one segment of a lepton image.  Returns a non-zero length for a
+ * successful operation.
+ *   - Segment information (frame number, segment number and pixel range)
+ *   - Image meta-data (first segment only)
+ *   - Base64 encoded raw segment image data from the Lepton
+ *   - Base64 encoded telemetry from the Lepton (only with the segment containing it)
+ *
+ * This function handles its own memory management.
+ */
+uint32_t json_get_image_segment_string(char* json_image_text, lep_segment_buffer_t* lep_segment, int seg)
+{
+	cJSON* root;
+	cJSON* segment;
+	json_image_data_t img = {"radiometric", (uint8_t*) lep_segment->lep_bufferP, lep_segment->pixel_len*2,
+	                         lep_segment->telem_valid ? lep_segment->lep_telemP : NULL};
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	cJSON_AddItemToObject(root, "segment", segment=cJSON_CreateObject());
+	cJSON_AddNumberToObject(segment, "frame", lep_segment->frame_num);
+	cJSON_AddNumberToObject(segment, "index", seg);
+	cJSON_AddNumberToObject(segment, "offset", lep_segment->pixel_offset);
+	cJSON_AddNumberToObject(segment, "length", lep_segment->pixel_len);
+	
+	return json_finish_image_string(root, json_image_text, (seg == 1), NULL, NULL, &img, "image segment");
+}
+
+
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * a segment object marking a frame, some of whose segments have been sent, as dropped
+ * in place of segment seg.  Returns a non-zero length for a successful operation.
+ */
+uint32_t json_get_image_segment_dropped_string(char* json_image_text, uint32_t frame_num, int seg)
+{
+	int len = 0;
+	cJSON* root;
+	cJSON* segment;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	cJSON_AddItemToObject(root, "segment", segment=cJSON_CreateObject());
+	cJSON_AddNumberToObject(segment, "frame", frame_num);
+	cJSON_AddNumberToObject(segment, "index", seg);
+	cJSON_AddNumberToObject(segment, "dropped", 1);
+	
 	// Tightly print the object to our buffer
-	if (success) {
-		if (cJSON_PrintPreallocated(root, json_image_text, JSON_MAX_IMAGE_TEXT_LEN, false) == 0) {
-			len = 0;
-		} else {
-			len = strlen(json_image_text);
-		}
-		
-		// Free the base-64 converted image strings
-		json_free_lep_base64_image();
-		json_free_lep_base64_telem();
-	} else {
-		ESP_LOGE(TAG, "failed to create json image text");
+	if (cJSON_PrintPreallocated(root, json_image_text, JSON_MAX_IMAGE_TEXT_LEN, false) != 0) {
+		len = strlen(json_image_text);
 	}
 	
 	cJSON_Delete(root);
@@ -216,6 +469,36 @@ uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buf
 }
 
 
+/**
+ * Update a formatted json string in a pre-allocated json text image buffer containing
+ * json objects for one frame from the burst capture ring.  Returns a non-zero length
+ * for a successful operation.
+ *   - Burst information (frame index, frame count, trigger frame index and capture time)
+ *   - Image meta-data
+ *   - Base64 encoded raw image from the Lepton
+ *   - Base64 encoded telemetry from the Lepton
+ *
+ * This function handles its own memory management.
+ */
+uint32_t json_get_burst_image_string(char* json_image_text, lep_buffer_t* lep_buffer, int index, int count, int trigger, int32_t msec)
+{
+	cJSON* root;
+	cJSON* burst;
+	json_image_data_t img = {"radiometric", (uint8_t*) lep_buffer->lep_bufferP, LEP_NUM_PIXELS*2, lep_buffer->lep_telemP};
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	cJSON_AddItemToObject(root, "burst", burst=cJSON_CreateObject());
+	cJSON_AddNumberToObject(burst, "index", index);
+	cJSON_AddNumberToObject(burst, "count", count);
+	cJSON_AddNumberToObject(burst, "trigger", trigger);
+	cJSON_AddNumberToObject(burst, "msec", msec);
+	
+	return json_finish_image_string(root, json_image_text, true, json_add_frame_meta, &lep_buffer->frame_num, &img, "burst image");
+}
+
+
 /**
  * Return a formatted json string containing the camera's operating parameters in
  * response to the get_config commmand.  Include the delimitors since this string
@@ -262,6 +545,14 @@ char* json_get_status(uint32_t* len)
 	int brd_type;
 	int if_type;
 	int model_field;
+	uint32_t crc_frame_errs;
+	uint32_t crc_total_errs;
+	cJSON* stats;
+	cJSON* perf;
+	lep_task_stats_t lep_stats;
+	vospi_stats_t vospi_stats;
+	rsp_perf_t rsp_perf;
+	sys_stage_time_t filter_time;
 	net_info_t* net_info;
 	uint8_t sys_mac_addr[6];
 	const esp_app_desc_t* app_desc;
@@ -328,6 +619,50 @@ char* json_get_status(uint32_t* len)
 	sprintf(buf, "%d/%d/%02d", te.Month, te.Day, te.Year-30); // Year starts at 1970
 	cJSON_AddStringToObject(status, "Date", buf);
 	
+	vospi_get_crc_errors(&crc_frame_errs, &crc_total_errs);
+	cJSON_AddNumberToObject(status, "CRC_Frame_Errors", crc_frame_errs);
+	cJSON_AddNumberToObject(status, "CRC_Total_Errors", crc_total_errs);
+	cJSON_AddNumberToObject(status, "Duplicate_Frames", vospi_get_duplicate_count());
+	cJSON_AddNumberToObject(status, "Frame_Overflows", system_lep_frame_overflow_count());
+	cJSON_AddNumberToObject(status, "Alarm_Overflows", alarm_get_overflow_count());
+	cJSON_AddStringToObject(status, "Burst_State", burst_get_state_name());
+	cJSON_AddNumberToObject(status, "Burst_Frames", burst_get_frame_count());
+	
+	// Lepton acquisition statistics
+	lep_get_stats(&lep_stats);
+	vospi_get_stats(&vospi_stats);
+	cJSON_AddItemToObject(status, "Stats", stats=cJSON_CreateObject());
+	cJSON_AddNumberToObject(stats, "Frames", lep_stats.frames);
+	cJSON_AddNumberToObject(stats, "Segments", vospi_stats.segments);
+	cJSON_AddNumberToObject(stats, "Discard_Packets", vospi_stats.read_errors[DISCARD]);
+	cJSON_AddNumberToObject(stats, "Segment_Timeouts", vospi_stats.read_errors[SEGMENT_ERROR]);
+	cJSON_AddNumberToObject(stats, "Row_Errors", vospi_stats.read_errors[ROW_ERROR]);
+	cJSON_AddNumberToObject(stats, "Invalid_Segments", vospi_stats.read_errors[SEGMENT_INVALID]);
+	cJSON_AddNumberToObject(stats, "Sequence_Errors", vospi_stats.read_errors[SEGMENT_SEQUENCE]);
+	cJSON_AddNumberToObject(stats, "Missed_VSYNC", lep_stats.missed_vsyncs);
+	cJSON_AddNumberToObject(stats, "Missed_Frames", lep_stats.missed_frames);
+	cJSON_AddNumberToObject(stats, "Fast_Resyncs", lep_stats.fast_resyncs);
+	cJSON_AddNumberToObject(stats, "Resyncs", lep_stats.resyncs);
+	cJSON_AddNumberToObject(stats, "FFC_Holds", lep_stats.ffc_holds);
+	cJSON_AddNumberToObject(stats, "Resets", lep_stats.resets);
+	cJSON_AddNumberToObject(stats, "Idle_Periods", lep_stats.idle_periods);
+	json_add_stage_time_items(stats, "Xfer", &vospi_stats.xfer);
+	
+	// Response pipeline performance and memory high-water marks
+	rsp_get_perf(&rsp_perf);
+	cJSON_AddItemToObject(status, "Perf", perf=cJSON_CreateObject());
+	cJSON_AddNumberToObject(perf, "Images_Sent", rsp_perf.images_sent);
+	cJSON_AddNumberToObject(perf, "Send_Rate", rsp_perf.send_rate_x10 / 10.0);
+	cJSON_AddNumberToObject(perf, "Images_Unchanged", rsp_perf.images_unchanged);
+	json_add_stage_time_items(perf, "Encode", &rsp_perf.encode);
+	json_add_stage_time_items(perf, "Send", &rsp_perf.send);
+	filter_get_stage_time(&filter_time);
+	json_add_stage_time_items(perf, "Filter", &filter_time);
+	cJSON_AddNumberToObject(perf, "Int_Heap_Min", heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+	cJSON_AddNumberToObject(perf, "SPIRAM_Heap_Min", heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+	cJSON_AddNumberToObject(perf, "Lep_Stack_Min", uxTaskGetStackHighWaterMark(task_handle_lep));
+	cJSON_AddNumberToObject(perf, "Rsp_Stack_Min", uxTaskGetStackHighWaterMark(task_handle_rsp));
+	
 	// Tightly print the object into our buffer with delimitors
 	*len = json_generate_response_string(root, json_response_text);
 	
@@ -493,6 +828,40 @@ int json_get_cam_info(char* json_string, uint32_t info_value, char* info_string)
 }
 
 
+/**
+ * Generate a formatted json string describing an alarm event.  Add delimiters for
+ * transmission over the network.  Returns string length.
+ *
+ * Note: Because this function is designed to be used by rsp_task, a valid buffer
+ *       must be passed in for json_string.
+ */
+int json_get_alarm_event(char* json_string, alarm_event_t* eventP)
+{
+	cJSON* root;
+	cJSON* alarm;
+	uint32_t len = 0;
+	
+	root=cJSON_CreateObject();
+	if (root != NULL) {
+		cJSON_AddItemToObject(root, "alarm", alarm=cJSON_CreateObject());
+		
+		cJSON_AddNumberToObject(alarm, "index", eventP->index);
+		cJSON_AddStringToObject(alarm, "type", alarm_get_type_name(eventP->type));
+		cJSON_AddNumberToObject(alarm, "active", eventP->active ? 1 : 0);
+		cJSON_AddNumberToObject(alarm, "frame", eventP->frame_num);
+		cJSON_AddNumberToObject(alarm, "value", eventP->value);
+		cJSON_AddNumberToObject(alarm, "image", eventP->image ? 1 : 0);
+		
+		// Tightly print the object into the buffer with delimiters
+		len = json_generate_response_string(root, json_string);
+		
+		cJSON_Delete(root);
+	}
+	
+	return (int) len;
+}
+
+
 /**
  * Parse a top level command object, returning the command number and a pointer to 
  * a json object containing "args".  The pointer is set to NULL if there are no args.
@@ -798,32 +1167,500 @@ bool json_parse_set_wifi(cJSON* cmd_args, net_info_t* new_net_info)
 /**
  * Get the stream_on arguments
  */
-bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames)
+bool json_parse_stream_on(cJSON* cmd_args, json_stream_on_t* stream_params)
 {
+	char* s;
+	cJSON* crop;
+	cJSON* isotherm;
+	double t;
 	int i;
 	
+	// Default is the fastest possible streaming of complete images
+	stream_params->delay_ms = 0;
+	stream_params->num_frames = 0;
+	stream_params->segments = false;
+	stream_params->roi = false;
+	stream_params->agc = false;
+	stream_params->decimate = DECIMATE_NONE;
+	stream_params->decimate_mode = DECIMATE_MODE_AVG;
+	stream_params->crop = false;
+	stream_params->isotherm = false;
+	stream_params->isotherm_lo = 0;
+	stream_params->isotherm_hi = ISOTHERM_MAX_TEMP;
+	stream_params->change_threshold = 0;
+	stream_params->change_pixels = CHANGE_DEF_PIXELS;
+	stream_params->heartbeat_sec = CHANGE_DEF_HEARTBEAT;
+	stream_params->binary = false;
+	
+	// Old-style commands do not include arguments
 	if (cmd_args != NULL) {
 		if (cJSON_HasObjectItem(cmd_args, "delay_msec")) {
 			i = cJSON_GetObjectItem(cmd_args, "delay_msec")->valueint;
 			if (i < 0) i = 0;
-			*delay_ms = i;
-		} else {
-			*delay_ms = 0;
+			stream_params->delay_ms = i;
 		}
 		
 		if (cJSON_HasObjectItem(cmd_args, "num_frames")) {
 			i = cJSON_GetObjectItem(cmd_args, "num_frames")->valueint;
 			if (i < 0) i = 0;
-			*num_frames = i;
+			stream_params->num_frames = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "segments")) {
+			i = cJSON_GetObjectItem(cmd_args, "segments")->valueint;
+			stream_params->segments = (i != 0);
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "roi")) {
+			i = cJSON_GetObjectItem(cmd_args, "roi")->valueint;
+			stream_params->roi = (i != 0);
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "agc")) {
+			i = cJSON_GetObjectItem(cmd_args, "agc")->valueint;
+			stream_params->agc = (i != 0);
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "decimate")) {
+			i = cJSON_GetObjectItem(cmd_args, "decimate")->valueint;
+			if ((i != DECIMATE_NONE) && (i != DECIMATE_2) && (i != DECIMATE_4)) {
+				ESP_LOGE(TAG, "Illegal stream_on decimate: %d", i);
+				return false;
+			}
+			stream_params->decimate = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "decimate_mode")) {
+			s = cJSON_GetObjectItem(cmd_args, "decimate_mode")->valuestring;
+			i = (s != NULL) ? decimate_mode_from_name(s) : -1;
+			if (i < 0) {
+				ESP_LOGE(TAG, "Illegal stream_on decimate_mode");
+				return false;
+			}
+			stream_params->decimate_mode = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "crop")) {
+			crop = cJSON_GetObjectItem(cmd_args, "crop");
+			if (!cJSON_HasObjectItem(crop, "r1") || !cJSON_HasObjectItem(crop, "c1") ||
+			    !cJSON_HasObjectItem(crop, "r2") || !cJSON_HasObjectItem(crop, "c2")) {
+				ESP_LOGE(TAG, "Illegal stream_on crop");
+				return false;
+			}
+			
+			i = cJSON_GetObjectItem(crop, "r1")->valueint;
+			if (i < 0) i = 0;
+			if (i > (LEP_HEIGHT-1)) i = LEP_HEIGHT - 1;
+			stream_params->crop_r1 = i;
+			
+			i = cJSON_GetObjectItem(crop, "c1")->valueint;
+			if (i < 0) i = 0;
+			if (i > (LEP_WIDTH-1)) i = LEP_WIDTH - 1;
+			stream_params->crop_c1 = i;
+			
+			i = cJSON_GetObjectItem(crop, "r2")->valueint;
+			if (i < stream_params->crop_r1) i = stream_params->crop_r1;
+			if (i > (LEP_HEIGHT-1)) i = LEP_HEIGHT - 1;
+			stream_params->crop_r2 = i;
+			
+			i = cJSON_GetObjectItem(crop, "c2")->valueint;
+			if (i < stream_params->crop_c1) i = stream_params->crop_c1;
+			if (i > (LEP_WIDTH-1)) i = LEP_WIDTH - 1;
+			stream_params->crop_c2 = i;
+			
+			stream_params->crop = true;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "isotherm")) {
+			isotherm = cJSON_GetObjectItem(cmd_args, "isotherm");
+			if (!cJSON_HasObjectItem(isotherm, "lo")) {
+				ESP_LOGE(TAG, "Illegal stream_on isotherm");
+				return false;
+			}
+			
+			t = cJSON_GetObjectItem(isotherm, "lo")->valuedouble;
+			stream_params->isotherm_lo = (int32_t) round(t * 100.0);
+			if (stream_params->isotherm_lo < -TEMP_ZERO_C_K100) stream_params->isotherm_lo = -TEMP_ZERO_C_K100;
+			if (stream_params->isotherm_lo > ISOTHERM_MAX_TEMP) stream_params->isotherm_lo = ISOTHERM_MAX_TEMP;
+			
+			if (cJSON_HasObjectItem(isotherm, "hi")) {
+				t = cJSON_GetObjectItem(isotherm, "hi")->valuedouble;
+				stream_params->isotherm_hi = (int32_t) round(t * 100.0);
+				if (stream_params->isotherm_hi < stream_params->isotherm_lo) stream_params->isotherm_hi = stream_params->isotherm_lo;
+				if (stream_params->isotherm_hi > ISOTHERM_MAX_TEMP) stream_params->isotherm_hi = ISOTHERM_MAX_TEMP;
+			}
+			
+			stream_params->isotherm = true;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "change_threshold")) {
+			i = cJSON_GetObjectItem(cmd_args, "change_threshold")->valueint;
+			if (i < 0) i = 0;
+			stream_params->change_threshold = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "change_pixels")) {
+			i = cJSON_GetObjectItem(cmd_args, "change_pixels")->valueint;
+			if (i < 1) i = 1;
+			if (i > LEP_NUM_PIXELS) i = LEP_NUM_PIXELS;
+			stream_params->change_pixels = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "heartbeat_sec")) {
+			i = cJSON_GetObjectItem(cmd_args, "heartbeat_sec")->valueint;
+			if (i < 0) i = 0;
+			stream_params->heartbeat_sec = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "binary")) {
+			i = cJSON_GetObjectItem(cmd_args, "binary")->valueint;
+			stream_params->binary = (i != 0);
+		}
+		
+		// Only one kind of response may be streamed
+		i = (stream_params->segments ? 1 : 0) + (stream_params->roi ? 1 : 0) + (stream_params->agc ? 1 : 0) +
+		    ((stream_params->decimate != DECIMATE_NONE) ? 1 : 0) + (stream_params->crop ? 1 : 0) +
+		    (stream_params->isotherm ? 1 : 0);
+		if (i > 1) {
+			ESP_LOGE(TAG, "Illegal stream_on - segments, roi, agc, decimate, crop and isotherm are mutually exclusive");
+			return false;
+		}
+		if (stream_params->segments && (stream_params->change_threshold != 0)) {
+			ESP_LOGE(TAG, "Illegal stream_on - change detection is not supported with segments");
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the get_image arguments
+ */
+bool json_parse_get_image(cJSON* cmd_args, bool* binary)
+{
+	// Default is a json image response
+	*binary = false;
+	
+	// Old-style commands do not include arguments
+	if (cmd_args != NULL) {
+		if (cJSON_HasObjectItem(cmd_args, "binary")) {
+			*binary = (cJSON_GetObjectItem(cmd_args, "binary")->valueint != 0);
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the burst_on arguments
+ */
+bool json_parse_burst_on(cJSON* cmd_args, int* post_frames)
+{
+	int i;
+	
+	// Default is to freeze the ring with the frame following the trigger
+	*post_frames = 0;
+	
+	if (cmd_args != NULL) {
+		if (cJSON_HasObjectItem(cmd_args, "post_frames")) {
+			i = cJSON_GetObjectItem(cmd_args, "post_frames")->valueint;
+			if (i < 0) i = 0;
+			if (i > (BURST_NUM_FRAMES-1)) i = BURST_NUM_FRAMES - 1;
+			*post_frames = i;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the set_filter arguments, preserving the current value of unspecified items
+ */
+bool json_parse_set_filter(cJSON* cmd_args, int* mode, int* strength, int* motion)
+{
+	int item_count = 0;
+	
+	filter_get_config(mode, strength, motion);
+	
+	if (cmd_args != NULL) {
+		if (cJSON_HasObjectItem(cmd_args, "mode")) {
+			*mode = cJSON_GetObjectItem(cmd_args, "mode")->valueint;
+			if (*mode != FILTER_MODE_IIR) *mode = FILTER_MODE_OFF;
+			item_count++;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "strength")) {
+			*strength = cJSON_GetObjectItem(cmd_args, "strength")->valueint;
+			if (*strength < FILTER_MIN_STRENGTH) *strength = FILTER_MIN_STRENGTH;
+			if (*strength > FILTER_MAX_STRENGTH) *strength = FILTER_MAX_STRENGTH;
+			item_count++;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "motion")) {
+			*motion = cJSON_GetObjectItem(cmd_args, "motion")->valueint;
+			if (*motion < 0) *motion = 0;
+			if (*motion > 0xFFFF) *motion = 0xFFFF;
+			item_count++;
+		}
+		
+		return (item_count > 0);
+	}
+	
+	return false;
+}
+
+
+/**
+ * Get the set_agc_preview arguments, preserving the current value of unspecified items
+ */
+bool json_parse_set_agc_preview(cJSON* cmd_args, agc_config_t* config)
+{
+	int i;
+	int item_count = 0;
+	
+	agc_get_config(config);
+	
+	if (cmd_args != NULL) {
+		if (cJSON_HasObjectItem(cmd_args, "damping")) {
+			i = cJSON_GetObjectItem(cmd_args, "damping")->valueint;
+			if (i < 0) i = 0;
+			if (i > 100) i = 100;
+			config->damping = i;
+			item_count++;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "clip_high")) {
+			i = cJSON_GetObjectItem(cmd_args, "clip_high")->valueint;
+			if (i < 1) i = 1;
+			if (i > LEP_NUM_PIXELS) i = LEP_NUM_PIXELS;
+			config->clip_high = i;
+			item_count++;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "clip_low")) {
+			i = cJSON_GetObjectItem(cmd_args, "clip_low")->valueint;
+			if (i < 0) i = 0;
+			if (i > LEP_NUM_PIXELS) i = LEP_NUM_PIXELS;
+			config->clip_low = i;
+			item_count++;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "empty_counts")) {
+			i = cJSON_GetObjectItem(cmd_args, "empty_counts")->valueint;
+			if (i < 0) i = 0;
+			if (i > LEP_NUM_PIXELS) i = LEP_NUM_PIXELS;
+			config->empty_counts = i;
+			item_count++;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "linear_percent")) {
+			i = cJSON_GetObjectItem(cmd_args, "linear_percent")->valueint;
+			if (i < 0) i = 0;
+			if (i > 100) i = 100;
+			config->linear_percent = i;
+			item_count++;
+		}
+		
+		return (item_count > 0);
+	}
+	
+	return false;
+}
+
+
+/**
+ * Get the set_roi region definitions.  Masks are allocated for regions that include
+ * one (and freed if the command is invalid).
+ */
+bool json_parse_set_roi(cJSON* cmd_args, roi_def_t* defs, int* num)
+{
+	bool success = true;
+	char* data;
+	cJSON* regions;
+	cJSON* region;
+	int i, n;
+	int mask_len;
+	size_t dec_len;
+	
+	*num = 0;
+	
+	// No regions clears all regions
+	if (cmd_args == NULL) return true;
+	regions = cJSON_GetObjectItem(cmd_args, "regions");
+	if (regions == NULL) return true;
+	if (!cJSON_IsArray(regions)) return false;
+	
+	n = cJSON_GetArraySize(regions);
+	if (n > ROI_MAX_NUM) {
+		ESP_LOGE(TAG, "Too many regions - %d", n);
+		return false;
+	}
+	
+	while (success && (*num < n)) {
+		region = cJSON_GetArrayItem(regions, *num);
+		if (!cJSON_HasObjectItem(region, "r1") || !cJSON_HasObjectItem(region, "c1") ||
+		    !cJSON_HasObjectItem(region, "r2") || !cJSON_HasObjectItem(region, "c2")) {
+			success = false;
+			break;
+		}
+		
+		i = cJSON_GetObjectItem(region, "r1")->valueint;
+		if (i < 0) i = 0;
+		if (i > (LEP_HEIGHT-1)) i = LEP_HEIGHT - 1;
+		defs[*num].r1 = i;
+		
+		i = cJSON_GetObjectItem(region, "c1")->valueint;
+		if (i < 0) i = 0;
+		if (i > (LEP_WIDTH-1)) i = LEP_WIDTH - 1;
+		defs[*num].c1 = i;
+		
+		i = cJSON_GetObjectItem(region, "r2")->valueint;
+		if (i < defs[*num].r1) i = defs[*num].r1;
+		if (i > (LEP_HEIGHT-1)) i = LEP_HEIGHT - 1;
+		defs[*num].r2 = i;
+		
+		i = cJSON_GetObjectItem(region, "c2")->valueint;
+		if (i < defs[*num].c1) i = defs[*num].c1;
+		if (i > (LEP_WIDTH-1)) i = LEP_WIDTH - 1;
+		defs[*num].c2 = i;
+		
+		defs[*num].maskP = NULL;
+		if (cJSON_HasObjectItem(region, "mask")) {
+			if (!cJSON_IsString(cJSON_GetObjectItem(region, "mask"))) {
+				ESP_LOGE(TAG, "Region mask must be a base64 string");
+				success = false;
+				break;
+			}
+			
+			mask_len = ROI_MASK_LEN(defs[*num].c2 - defs[*num].c1 + 1, defs[*num].r2 - defs[*num].r1 + 1);
+			defs[*num].maskP = heap_caps_malloc(mask_len, MALLOC_CAP_SPIRAM);
+			if (defs[*num].maskP == NULL) {
+				ESP_LOGE(TAG, "Could not allocate region mask");
+				success = false;
+				break;
+			}
+			
+			// Decode (the mask must cover the region exactly)
+			data = cJSON_GetObjectItem(region, "mask")->valuestring;
+			i = mbedtls_base64_decode(defs[*num].maskP, mask_len, &dec_len, (const unsigned char*) data, strlen(data));
+			if ((i != 0) || (dec_len != mask_len)) {
+				ESP_LOGE(TAG, "Base 64 region mask decode failed - %d (%d bytes decoded)", i, (int) dec_len);
+				heap_caps_free(defs[*num].maskP);
+				success = false;
+				break;
+			}
+		}
+		
+		(*num)++;
+	}
+	
+	if (!success) {
+		// Free masks for the regions already parsed
+		for (i=0; i<*num; i++) {
+			if (defs[i].maskP != NULL) {
+				heap_caps_free(defs[i].maskP);
+			}
+		}
+		*num = 0;
+	}
+	
+	return success;
+}
+
+
+/**
+ * Get the set_alarm rules
+ */
+bool json_parse_set_alarm(cJSON* cmd_args, alarm_rule_t* rules, int* num)
+{
+	char* type;
+	cJSON* alarms;
+	cJSON* alarm;
+	double t;
+	int i, n;
+	
+	*num = 0;
+	
+	// No rules clears all rules
+	if (cmd_args == NULL) return true;
+	alarms = cJSON_GetObjectItem(cmd_args, "alarms");
+	if (alarms == NULL) return true;
+	if (!cJSON_IsArray(alarms)) return false;
+	
+	n = cJSON_GetArraySize(alarms);
+	if (n > ALARM_MAX_NUM) {
+		ESP_LOGE(TAG, "Too many alarms - %d", n);
+		return false;
+	}
+	
+	for (i=0; i<n; i++) {
+		alarm = cJSON_GetArrayItem(alarms, i);
+		if (!cJSON_HasObjectItem(alarm, "type")) return false;
+		if (!cJSON_HasObjectItem(alarm, "threshold") && !cJSON_HasObjectItem(alarm, "temperature")) {
+			return false;
+		}
+		
+		type = cJSON_GetObjectItem(alarm, "type")->valuestring;
+		if (type == NULL) return false;
+		rules[i].type = 0;
+		while ((rules[i].type < ALARM_NUM_TYPES) && (strcmp(type, alarm_get_type_name(rules[i].type)) != 0)) {
+			rules[i].type++;
+		}
+		if (rules[i].type == ALARM_NUM_TYPES) {
+			ESP_LOGE(TAG, "Unknown alarm type %s", type);
+			return false;
+		}
+		
+		// A temperature (°C) takes precedence over a threshold (counts)
+		rules[i].threshold = 0;
+		rules[i].use_temp = false;
+		rules[i].temp = 0;
+		if (cJSON_HasObjectItem(alarm, "temperature")) {
+			t = cJSON_GetObjectItem(alarm, "temperature")->valuedouble;
+			rules[i].use_temp = true;
+			rules[i].temp = (int32_t) round(t * 100.0);
 		} else {
-			*num_frames = 0;
+			rules[i].threshold = cJSON_GetObjectItem(alarm, "threshold")->valueint;
+		}
+		
+		rules[i].emissivity = 0;
+		if (cJSON_HasObjectItem(alarm, "emissivity")) {
+			rules[i].emissivity = cJSON_GetObjectItem(alarm, "emissivity")->valueint;
+			if (rules[i].emissivity < 1) rules[i].emissivity = 1;
+			if (rules[i].emissivity > 100) rules[i].emissivity = 100;
+		}
+		
+		rules[i].roi = ROI_FULL_FRAME;
+		if (cJSON_HasObjectItem(alarm, "roi")) {
+			rules[i].roi = cJSON_GetObjectItem(alarm, "roi")->valueint;
+			if ((rules[i].roi < ROI_FULL_FRAME) || (rules[i].roi >= ROI_MAX_NUM)) return false;
+		}
+		
+		rules[i].count = 0;
+		if (cJSON_HasObjectItem(alarm, "count")) {
+			rules[i].count = cJSON_GetObjectItem(alarm, "count")->valueint;
+			if (rules[i].count < 0) rules[i].count = 0;
+		}
+		
+		rules[i].frames = (rules[i].type == ALARM_TYPE_RISE) ? ALARM_DEF_RISE_FRAMES : 1;
+		if (cJSON_HasObjectItem(alarm, "frames")) {
+			rules[i].frames = cJSON_GetObjectItem(alarm, "frames")->valueint;
+			if (rules[i].frames < 1) rules[i].frames = 1;
+			if (rules[i].frames > ALARM_MAX_FRAMES) rules[i].frames = ALARM_MAX_FRAMES;
+		}
+		
+		rules[i].image = false;
+		if (cJSON_HasObjectItem(alarm, "image")) {
+			rules[i].image = (cJSON_GetObjectItem(alarm, "image")->valueint != 0);
 		}
-	} else {
-		// Assume old-style command and setup fastest possible streaming
-		*delay_ms = 0;
-		*num_frames = 0;
 	}
 	
+	*num = n;
+	
 	return true;
 }
 
@@ -890,7 +1727,7 @@ bool json_parse_set_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t**
 				// Decode
 				i = mbedtls_base64_decode((unsigned char*) cci_buf, CCI_BUF_LEN, &dec_len, (const unsigned char*) data, strlen(data));
 				if (i != 0) {
-					ESP_LOGE(TAG, "Base 64 CCI Register data decode failed - %d (%d bytes decoded)", i, dec_len);
+					ESP_LOGE(TAG, "Base 64 CCI Register data decode failed - %d (%d bytes decoded)", i, (int) dec_len);
 					return false;
 				}
 			}
@@ -960,7 +1797,7 @@ bool json_parse_fw_segment(cJSON* cmd_args, uint32_t* start, uint32_t* len, uint
 				enc_len = strlen(data);
 				i = mbedtls_base64_decode(buf, FM_UPD_CHUNK_MAX_LEN, &dec_len, (const unsigned char*) data, enc_len);
 				if (i != 0) {
-					ESP_LOGE(TAG, "Base 64 FW segment data decode failed - %d (%d bytes decoded)", i, dec_len);
+					ESP_LOGE(TAG, "Base 64 FW segment data decode failed - %d (%d bytes decoded)", i, (int) dec_len);
 					return false;
 				}
 				
@@ -1009,37 +1846,38 @@ const char* json_get_cmd_name(int cmd)
 //
 
 /**
- * Add a child object containing base64 encoded lepton image from the shared buffer
+ * Add a child object with the specified name containing len bytes of base64 encoded
+ * lepton image data
  *
  * Note: The encoded image string is held in an array that must be freed with
  * json_free_lep_base64_image() after the json object is converted to a string.
  */
-static bool json_add_lep_image_object(cJSON* parent, lep_buffer_t* lep_buffer)
+static bool json_add_lep_image_object(cJSON* parent, const char* name, uint8_t* dataP, int len)
 {
 	size_t base64_obj_len;
 	
 	// Get the necessary length and allocate a buffer
 	(void) mbedtls_base64_encode(base64_lep_data, 0, &base64_obj_len, 
-								 (const unsigned char *) lep_buffer->lep_bufferP, LEP_NUM_PIXELS*2);
+								 (const unsigned char *) dataP, len);
 	base64_lep_data = heap_caps_malloc(base64_obj_len, MALLOC_CAP_SPIRAM);
 	
 	if (base64_lep_data != NULL) {
 		// Base-64 encode the camera data
 		if (mbedtls_base64_encode(base64_lep_data, base64_obj_len, &base64_obj_len, 
-							      (const unsigned char *) lep_buffer->lep_bufferP,
-	    	                       LEP_NUM_PIXELS*2) != 0) {
+							      (const unsigned char *) dataP,
+	    	                       len) != 0) {
 	                           
 			ESP_LOGE(TAG, "failed to encode lepton image base64 text");
-			free(base64_lep_data);
+			heap_caps_free(base64_lep_data);
 			return false;
 		}
 	} else {
-		ESP_LOGE(TAG, "failed to allocate %d bytes for lepton image base64 text", base64_obj_len);
+		ESP_LOGE(TAG, "failed to allocate %d bytes for lepton image base64 text", (int) base64_obj_len);
 		return false;
 	}
 	
 	// Add the encoded data as a reference since we're managing the buffer
-	cJSON_AddItemToObject(parent, "radiometric", cJSON_CreateStringReference((char*) base64_lep_data));
+	cJSON_AddItemToObject(parent, name, cJSON_CreateStringReference((char*) base64_lep_data));
 	
 	return true;
 }
@@ -1051,7 +1889,7 @@ static bool json_add_lep_image_object(cJSON* parent, lep_buffer_t* lep_buffer)
  */
 static void json_free_lep_base64_image()
 {
-	free(base64_lep_data);
+	heap_caps_free(base64_lep_data);
 }
 
 
@@ -1061,28 +1899,28 @@ static void json_free_lep_base64_image()
  * Note: The encoded telemetry string is held in an array that must be freed with
  * json_free_lep_base64_telem() after the json object is converted to a string.
  */
-static bool json_add_lep_telem_object(cJSON* parent, lep_buffer_t* lep_buffer)
+static bool json_add_lep_telem_object(cJSON* parent, uint16_t* lep_telemP)
 {
 	size_t base64_obj_len;
 	
 	// Get the necessary length and allocate a buffer
 	(void) mbedtls_base64_encode(base64_lep_telem_data, 0, &base64_obj_len, 
-								 (const unsigned char *) lep_buffer->lep_telemP, LEP_TEL_WORDS*2);
+								 (const unsigned char *) lep_telemP, LEP_TEL_WORDS*2);
 	base64_lep_telem_data = heap_caps_malloc(base64_obj_len, MALLOC_CAP_SPIRAM);
 	
 	
 	if (base64_lep_data != NULL) {
 		// Base-64 encode the telemetry array
 		if (mbedtls_base64_encode(base64_lep_telem_data, base64_obj_len, &base64_obj_len, 
-							      (const unsigned char *) lep_buffer->lep_telemP,
+							      (const unsigned char *) lep_telemP,
 	    	                       LEP_TEL_WORDS*2) != 0) {
 	                           
 			ESP_LOGE(TAG, "failed to encode lepton telemetry base64 text");
-			free(base64_lep_telem_data);
+			heap_caps_free(base64_lep_telem_data);
 			return false;
 		}
 	} else {
-		ESP_LOGE(TAG, "failed to allocate %d bytes for lepton telemetry base64 text", base64_obj_len);
+		ESP_LOGE(TAG, "failed to allocate %d bytes for lepton telemetry base64 text", (int) base64_obj_len);
 		return false;
 	}
 	
@@ -1099,7 +1937,7 @@ static bool json_add_lep_telem_object(cJSON* parent, lep_buffer_t* lep_buffer)
  */
 static void json_free_lep_base64_telem()
 {
-	free(base64_lep_telem_data);
+	heap_caps_free(base64_lep_telem_data);
 }
 
 
@@ -1125,11 +1963,11 @@ static bool json_add_cci_reg_base64_data(cJSON* parent, int len, uint16_t* buf)
 							      (const unsigned char *) buf, len*2) != 0) {
 	                           
 			ESP_LOGE(TAG, "failed to encode CCI Register data base64 text");
-			free(base64_cci_reg_data);
+			heap_caps_free(base64_cci_reg_data);
 			return false;
 		}
 	} else {
-		ESP_LOGE(TAG, "failed to allocate %d bytes for CCI Register base64 text", base64_obj_len);
+		ESP_LOGE(TAG, "failed to allocate %d bytes for CCI Register base64 text", (int) base64_obj_len);
 		return false;
 	}
 	
@@ -1146,7 +1984,180 @@ static bool json_add_cci_reg_base64_data(cJSON* parent, int len, uint16_t* buf)
  */
 static void json_free_cci_reg_base64_data()
 {
-	free(base64_cci_reg_data);
+	heap_caps_free(base64_cci_reg_data);
+}
+
+
+/**
+ * Add last, maximum and average duration items for a pipeline stage to the parent
+ */
+static void json_add_stage_time_items(cJSON* parent, const char* name, sys_stage_time_t* stP)
+{
+	char buf[32];
+	
+	sprintf(buf, "%s_Last_Usec", name);
+	cJSON_AddNumberToObject(parent, buf, stP->last_usec);
+	sprintf(buf, "%s_Max_Usec", name);
+	cJSON_AddNumberToObject(parent, buf, stP->max_usec);
+	sprintf(buf, "%s_Avg_Usec", name);
+	cJSON_AddNumberToObject(parent, buf, (stP->count == 0) ? 0 : (uint32_t) (stP->total_usec / stP->count));
+}
+
+
+/**
+ * Complete an image response whose leading objects (if any) have already been added to
+ * root and tightly print it into json_image_text.  Adds the metadata object if metadata
+ * is set (with the items add_meta adds if it is not NULL), the base64 encoded image data
+ * and the base64 encoded telemetry if imgP->telemP is not NULL.  Deletes root and frees
+ * the base64 strings.  Returns a non-zero length for a successful operation.
+ */
+static uint32_t json_finish_image_string(cJSON* root, char* json_image_text, bool metadata, json_meta_items_fn add_meta,
+	const void* argP, json_image_data_t* imgP, const char* desc)
+{
+	bool success = true;
+	bool telem = false;
+	int len = 0;
+	
+	if (metadata) {
+		success = json_add_metadata_object(root);
+		if (success && (add_meta != NULL)) {
+			add_meta(cJSON_GetObjectItem(root, "metadata"), argP);
+		}
+	}
+	if (success) {
+		success = json_add_lep_image_object(root, imgP->name, imgP->dataP, imgP->len);
+		if (success && (imgP->telemP != NULL)) {
+			telem = json_add_lep_telem_object(root, imgP->telemP);
+			if (!telem) {
+				// Free lep_image that was already allocated
+				json_free_lep_base64_image();
+				success = false;
+			}
+		}
+	}
+	
+	// Tightly print the object to our buffer
+	if (success) {
+		if (cJSON_PrintPreallocated(root, json_image_text, JSON_MAX_IMAGE_TEXT_LEN, false) != 0) {
+			len = strlen(json_image_text);
+		}
+		
+		// Free the base-64 converted image strings
+		json_free_lep_base64_image();
+		if (telem) {
+			json_free_lep_base64_telem();
+		}
+	} else {
+		ESP_LOGE(TAG, "failed to create json %s text", desc);
+	}
+	
+	cJSON_Delete(root);
+	
+	return len;
+}
+
+
+/**
+ * Metadata callback adding the frame sequence number (argP points to it)
+ */
+static void json_add_frame_meta(cJSON* meta, const void* argP)
+{
+	cJSON_AddNumberToObject(meta, "Frame", *((const uint32_t*) argP));
+}
+
+
+/**
+ * Metadata callback adding the decimated image size and mode (argP points to a
+ * json_decimate_meta_t)
+ */
+static void json_add_decimate_meta(cJSON* meta, const void* argP)
+{
+	const json_decimate_meta_t* mP = (const json_decimate_meta_t*) argP;
+	
+	cJSON_AddNumberToObject(meta, "Frame", mP->frame_num);
+	cJSON_AddNumberToObject(meta, "Width", LEP_WIDTH / mP->factor);
+	cJSON_AddNumberToObject(meta, "Height", LEP_HEIGHT / mP->factor);
+	cJSON_AddStringToObject(meta, "Decimate_Mode", decimate_get_mode_name(mP->mode));
+}
+
+
+/**
+ * Metadata callback adding the cropped image size and rectangle (argP points to a
+ * json_crop_meta_t)
+ */
+static void json_add_crop_meta(cJSON* meta, const void* argP)
+{
+	const json_crop_meta_t* mP = (const json_crop_meta_t*) argP;
+	
+	cJSON_AddNumberToObject(meta, "Frame", mP->frame_num);
+	cJSON_AddNumberToObject(meta, "Width", mP->c2 - mP->c1 + 1);
+	cJSON_AddNumberToObject(meta, "Height", mP->r2 - mP->r1 + 1);
+	cJSON_AddNumberToObject(meta, "Crop_R1", mP->r1);
+	cJSON_AddNumberToObject(meta, "Crop_C1", mP->c1);
+	cJSON_AddNumberToObject(meta, "Crop_R2", mP->r2);
+	cJSON_AddNumberToObject(meta, "Crop_C2", mP->c2);
+}
+
+
+/**
+ * Metadata callback adding the isotherm band and mask encoding (argP points to a
+ * json_isotherm_meta_t)
+ */
+static void json_add_isotherm_meta(cJSON* meta, const void* argP)
+{
+	const json_isotherm_meta_t* mP = (const json_isotherm_meta_t*) argP;
+	
+	cJSON_AddNumberToObject(meta, "Frame", mP->frame_num);
+	cJSON_AddNumberToObject(meta, "Width", LEP_WIDTH);
+	cJSON_AddNumberToObject(meta, "Height", LEP_HEIGHT);
+	cJSON_AddNumberToObject(meta, "Isotherm_Lo", (const double) mP->lo / 100.0);
+	if (mP->hi != ISOTHERM_MAX_TEMP) {
+		cJSON_AddNumberToObject(meta, "Isotherm_Hi", (const double) mP->hi / 100.0);
+	}
+	cJSON_AddNumberToObject(meta, "Isotherm_Pixels", mP->pixels);
+	cJSON_AddStringToObject(meta, "Isotherm_Encoding", isotherm_get_encoding_name(mP->encoding));
+}
+
+
+/**
+ * Metadata callback adding the scene range mapped to an AGC preview (argP points to a
+ * json_agc_meta_t)
+ */
+static void json_add_agc_meta(cJSON* meta, const void* argP)
+{
+	const json_agc_meta_t* mP = (const json_agc_meta_t*) argP;
+	
+	cJSON_AddNumberToObject(meta, "Frame", mP->frame_num);
+	cJSON_AddNumberToObject(meta, "AGC_Min", mP->lo);
+	cJSON_AddNumberToObject(meta, "AGC_Max", mP->hi);
+}
+
+
+/**
+ * Add a child object containing the region of interest statistics for an image
+ * to the parent.
+ */
+static void json_add_roi_object(cJSON* parent, lep_buffer_t* lep_buffer)
+{
+	cJSON* roi;
+	cJSON* regions;
+	cJSON* region;
+	int i, n;
+	
+	n = roi_compute(lep_buffer->lep_bufferP, roi_stats);
+	
+	cJSON_AddItemToObject(parent, "roi", roi=cJSON_CreateObject());
+	cJSON_AddNumberToObject(roi, "frame", lep_buffer->frame_num);
+	cJSON_AddItemToObject(roi, "regions", regions=cJSON_CreateArray());
+	for (i=0; i<n; i++) {
+		region = cJSON_CreateObject();
+		cJSON_AddNumberToObject(region, "count", roi_stats[i].count);
+		cJSON_AddNumberToObject(region, "min", roi_stats[i].min);
+		cJSON_AddNumberToObject(region, "max", roi_stats[i].max);
+		cJSON_AddNumberToObject(region, "mean", round(roi_stats[i].mean * 100.0) / 100.0);
+		cJSON_AddNumberToObject(region, "stddev", round(roi_stats[i].stddev * 100.0) / 100.0);
+		cJSON_AddItemToArray(regions, region);
+	}
 }
 
 
@@ -33,9 +33,12 @@
 #ifndef JSON_UTILITIES_H
 #define JSON_UTILITIES_H
 
+#include "agc_utilities.h"
+#include "alarm_utilities.h"
 #include "ds3232.h"
 #include "net_utilities.h"
 #include "sys_utilities.h"
+#include "roi_utilities.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include "cJSON.h"
@@ -48,18 +51,33 @@
 bool json_init();
 cJSON* json_get_cmd_object(char* json_string);
 uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buffer);
+uint32_t json_get_image_segment_string(char* json_image_text, lep_segment_buffer_t* lep_segment, int seg);
+uint32_t json_get_image_segment_dropped_string(char* json_image_text, uint32_t frame_num, int seg);
+uint32_t json_get_decimated_image_string(char* json_image_text, lep_buffer_t* lep_buffer, int factor, int mode);
+uint32_t json_get_cropped_image_string(char* json_image_text, lep_buffer_t* lep_buffer, int r1, int c1, int r2, int c2);
+uint32_t json_get_isotherm_string(char* json_image_text, lep_buffer_t* lep_buffer, int32_t lo, int32_t hi);
+uint32_t json_get_agc_image_string(char* json_image_text, lep_buffer_t* lep_buffer);
+uint32_t json_get_roi_string(char* json_image_text, lep_buffer_t* lep_buffer);
+uint32_t json_get_burst_image_string(char* json_image_text, lep_buffer_t* lep_buffer, int index, int count, int trigger, int32_t msec);
 char* json_get_config(uint32_t* len);
 char* json_get_status(uint32_t* len);
 char* json_get_wifi(uint32_t* len);
 char* json_get_cci_response(uint16_t cmd, int cci_len, uint16_t status, uint16_t* buf, uint32_t* len);
 char* json_get_get_fw(uint32_t fw_start, uint32_t fw_len, uint32_t* len);
 int json_get_cam_info(char* json_string, uint32_t info_value, char* info_string);
+int json_get_alarm_event(char* json_string, alarm_event_t* eventP);
 bool json_parse_cmd(cJSON* cmd_obj, int* cmd, cJSON** cmd_args);
 bool json_parse_set_config(cJSON* cmd_args, json_config_t* new_st);
 bool json_parse_set_spotmeter(cJSON* cmd_args, uint16_t* r1, uint16_t* c1, uint16_t* r2, uint16_t* c2);
 bool json_parse_set_time(cJSON* cmd_args, tmElements_t* te);
 bool json_parse_set_wifi(cJSON* cmd_args, net_info_t* new_net_info);
-bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames);
+bool json_parse_stream_on(cJSON* cmd_args, json_stream_on_t* stream_params);
+bool json_parse_get_image(cJSON* cmd_args, bool* binary);
+bool json_parse_burst_on(cJSON* cmd_args, int* post_frames);
+bool json_parse_set_filter(cJSON* cmd_args, int* mode, int* strength, int* motion);
+bool json_parse_set_agc_preview(cJSON* cmd_args, agc_config_t* config);
+bool json_parse_set_roi(cJSON* cmd_args, roi_def_t* defs, int* num);
+bool json_parse_set_alarm(cJSON* cmd_args, alarm_rule_t* rules, int* num);
 bool json_parse_get_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t** buf);
 bool json_parse_set_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t** buf);
 bool json_parse_fw_upd_request(cJSON* cmd_args, uint32_t* len, char* ver);
@@ -0,0 +1,316 @@
+/*
+ * AGC preview utilities
+ *
+ * Generates an 8-bit histogram equalized (HEQ) preview of a radiometric Lepton frame
+ * so display-only clients can be sent a small image while the camera keeps the
+ * radiometric data.  The algorithm and its settings are modeled on the Lepton's own
+ * HEQ AGC.
+ *
+ *   1. A histogram of AGC_HIST_BINS bins is computed across the scene range (the
+ *      frame minimum to maximum, damped between frames).  It is re-binned from the
+ *      histogram vospi computed as the frame was read when there is one so only the
+ *      final mapping visits every pixel.
+ *   2. Bins with fewer than empty_counts pixels are considered empty.  The population
+ *      of the other bins is limited to clip_high and then increased by clip_low so
+ *      large uniform areas don't take the whole output range and small features are
+ *      still visible.
+ *   3. The cumulative histogram maps each bin to an output level, blended with a linear
+ *      mapping by linear_percent, and damped against the previous mapping.
+ *
+ * Only rsp_task generates previews (for each image it sends) so the damping is applied
+ * between sent images.  Frames generated by the Lepton's own AGC are already 8-bit and
+ * are copied.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "agc_utilities.h"
+#include "lepton_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "vospi.h"
+#include <string.h>
+
+
+
+//
+// AGC Utilities variables
+//
+static const char* TAG = "agc_utilities";
+
+static SemaphoreHandle_t agc_mutex;
+
+// Settings (written by the command task)
+static agc_config_t agc_config = {
+	AGC_DEF_DAMPING,
+	AGC_DEF_CLIP_HIGH,
+	AGC_DEF_CLIP_LOW,
+	AGC_DEF_EMPTY_COUNTS,
+	AGC_DEF_LINEAR_PERCENT
+};
+static bool agc_config_changed = false;
+
+// Preview state (only used by rsp_task)
+static uint8_t* agc_imageP = NULL;
+static uint32_t agc_hist[AGC_HIST_BINS];
+static uint32_t agc_lut[AGC_HIST_BINS];        // Output level << 8 for each bin
+static uint32_t agc_lo;                        // Damped scene range << 8
+static uint32_t agc_hi;
+static bool agc_state_valid = false;
+static uint32_t agc_last_frame_num;
+
+
+
+//
+// AGC Utilities Forward Declarations for internal functions
+//
+static uint32_t agc_bin(uint32_t p, uint16_t lo16, uint16_t hi16, uint32_t scale);
+#ifdef LEP_HISTOGRAM_BINS
+static void agc_hist_from_frame(lep_buffer_t* lep_bufP, uint16_t lo16, uint16_t hi16, uint32_t scale);
+#endif
+static void agc_hist_from_pixels(uint16_t* pixP, uint16_t lo16, uint16_t hi16, uint32_t scale);
+
+
+
+//
+// AGC Utilities API
+//
+
+/**
+ * Allocate the preview image and initialize the module (before any other task uses it)
+ */
+bool agc_init()
+{
+	agc_mutex = xSemaphoreCreateMutex();
+	if (agc_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create agc mutex");
+		return false;
+	}
+	
+	agc_imageP = heap_caps_malloc(LEP_NUM_PIXELS, MALLOC_CAP_SPIRAM);
+	if (agc_imageP == NULL) {
+		ESP_LOGE(TAG, "malloc agc preview image failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Set the preview settings.  Takes effect, restarting the damping, with the next preview.
+ */
+void agc_set_config(agc_config_t* configP)
+{
+	xSemaphoreTake(agc_mutex, portMAX_DELAY);
+	agc_config = *configP;
+	agc_config_changed = true;
+	xSemaphoreGive(agc_mutex);
+}
+
+
+/**
+ * Get the current preview settings
+ */
+void agc_get_config(agc_config_t* configP)
+{
+	xSemaphoreTake(agc_mutex, portMAX_DELAY);
+	*configP = agc_config;
+	xSemaphoreGive(agc_mutex);
+}
+
+
+/**
+ * Generate the preview of a frame.  Returns a pointer to LEP_NUM_PIXELS 8-bit pixels
+ * (valid until the next call) and the scene range mapped to the output in lo and hi,
+ * or NULL if the preview image could not be allocated.
+ */
+uint8_t* agc_process(lep_buffer_t* lep_bufP, uint16_t* lo, uint16_t* hi)
+{
+	agc_config_t config;
+	uint16_t* pixP = lep_bufP->lep_bufferP;
+	uint8_t* outP = agc_imageP;
+	uint16_t lo16, hi16;
+	uint32_t cum, total;
+	uint32_t heq, lin, lut;
+	uint32_t scale;
+	uint32_t w;
+	int i;
+	
+	if (agc_imageP == NULL) return NULL;
+	
+	// Lepton AGC images are already 8 bits
+	if ((lepton_get_tel_status(lep_bufP->lep_telemP) & LEP_STATUS_AGC_STATE) != 0) {
+		for (i=0; i<LEP_NUM_PIXELS; i++) {
+			*outP++ = (uint8_t) *pixP++;
+		}
+		*lo = 0;
+		*hi = 255;
+		agc_state_valid = false;
+		return agc_imageP;
+	}
+	
+	// Get the current settings, restarting the damping when they change or after a gap
+	xSemaphoreTake(agc_mutex, portMAX_DELAY);
+	config = agc_config;
+	if (agc_config_changed) {
+		agc_config_changed = false;
+		agc_state_valid = false;
+	}
+	xSemaphoreGive(agc_mutex);
+	
+	if (agc_state_valid && ((lep_bufP->frame_num - agc_last_frame_num) > AGC_MAX_GAP_FRAMES)) {
+		agc_state_valid = false;
+	}
+	agc_last_frame_num = lep_bufP->frame_num;
+	
+	// Weight (out of 256) of the new frame when damping
+	w = agc_state_valid ? ((100 - config.damping) * 256) / 100 : 256;
+	if (w == 0) w = 1;
+	
+	// Damped scene range
+	if (agc_state_valid) {
+		agc_lo = (agc_lo * (256 - w) + ((uint32_t) lep_bufP->lep_min_val << 8) * w) >> 8;
+		agc_hi = (agc_hi * (256 - w) + ((uint32_t) lep_bufP->lep_max_val << 8) * w) >> 8;
+	} else {
+		agc_lo = (uint32_t) lep_bufP->lep_min_val << 8;
+		agc_hi = (uint32_t) lep_bufP->lep_max_val << 8;
+	}
+	lo16 = (uint16_t) (agc_lo >> 8);
+	hi16 = (uint16_t) (agc_hi >> 8);
+	if (hi16 <= lo16) hi16 = lo16 + 1;
+	scale = ((AGC_HIST_BINS - 1) << 16) / (hi16 - lo16);
+	
+	// Histogram
+#ifdef LEP_HISTOGRAM_BINS
+	if (lep_bufP->lep_histP != NULL) {
+		agc_hist_from_frame(lep_bufP, lo16, hi16, scale);
+	} else {
+		agc_hist_from_pixels(pixP, lo16, hi16, scale);
+	}
+#else
+	agc_hist_from_pixels(pixP, lo16, hi16, scale);
+#endif
+	
+	// Clip the histogram
+	total = 0;
+	for (i=0; i<AGC_HIST_BINS; i++) {
+		if (agc_hist[i] < config.empty_counts) {
+			agc_hist[i] = 0;
+		} else {
+			if (agc_hist[i] > config.clip_high) agc_hist[i] = config.clip_high;
+			agc_hist[i] += config.clip_low;
+		}
+		total += agc_hist[i];
+	}
+	if (total == 0) total = 1;
+	
+	// Transfer function (each bin maps to the middle of its cumulative population)
+	cum = 0;
+	for (i=0; i<AGC_HIST_BINS; i++) {
+		heq = (uint32_t) (((uint64_t) (2*cum + agc_hist[i]) * (255 << 8)) / (2 * total));
+		lin = (i * (255 << 8)) / (AGC_HIST_BINS - 1);
+		lut = (lin * config.linear_percent + heq * (100 - config.linear_percent)) / 100;
+		cum += agc_hist[i];
+		
+		if (agc_state_valid) {
+			agc_lut[i] = (agc_lut[i] * (256 - w) + lut * w) >> 8;
+		} else {
+			agc_lut[i] = lut;
+		}
+	}
+	agc_state_valid = true;
+	
+	// Map the image
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		*outP++ = (uint8_t) ((agc_lut[agc_bin(*pixP++, lo16, hi16, scale)] + 0x80) >> 8);
+	}
+	
+	*lo = lo16;
+	*hi = hi16;
+	
+	return agc_imageP;
+}
+
+
+
+//
+// AGC Utilities internal functions
+//
+
+/**
+ * Return the bin for a pixel value in the histogram spanning lo16 - hi16
+ */
+static uint32_t agc_bin(uint32_t p, uint16_t lo16, uint16_t hi16, uint32_t scale)
+{
+	if (p <= lo16) {
+		return 0;
+	} else if (p >= hi16) {
+		return AGC_HIST_BINS - 1;
+	} else {
+		return ((p - lo16) * scale) >> 16;
+	}
+}
+
+
+#ifdef LEP_HISTOGRAM_BINS
+/**
+ * Compute the histogram from the frame's histogram.  The pixels in each frame bin are
+ * spread evenly across the AGC bins it covers.
+ */
+static void agc_hist_from_frame(lep_buffer_t* lep_bufP, uint16_t lo16, uint16_t hi16, uint32_t scale)
+{
+	uint16_t* histP = lep_bufP->lep_histP;
+	uint32_t width = 1 << lep_bufP->lep_hist_shift;
+	uint32_t v = lep_bufP->lep_hist_base;
+	uint32_t b, b1, n, per_bin;
+	int i;
+	
+	memset(agc_hist, 0, sizeof(agc_hist));
+	for (i=0; i<LEP_HISTOGRAM_BINS; i++) {
+		n = *histP++;
+		if (n != 0) {
+			b = agc_bin(v, lo16, hi16, scale);
+			b1 = agc_bin(v + width - 1, lo16, hi16, scale);
+			per_bin = n / (b1 - b + 1);
+			agc_hist[b] += n - per_bin * (b1 - b);
+			while (b < b1) {
+				agc_hist[++b] += per_bin;
+			}
+		}
+		v += width;
+	}
+}
+#endif
+
+
+/**
+ * Compute the histogram from the pixels of a frame without one
+ */
+static void agc_hist_from_pixels(uint16_t* pixP, uint16_t lo16, uint16_t hi16, uint32_t scale)
+{
+	int i;
+	
+	memset(agc_hist, 0, sizeof(agc_hist));
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		agc_hist[agc_bin(*pixP++, lo16, hi16, scale)]++;
+	}
+}
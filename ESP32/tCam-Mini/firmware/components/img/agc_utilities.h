@@ -0,0 +1,75 @@
+/*
+ * AGC preview utilities
+ *
+ * Generates an 8-bit histogram equalized (HEQ) preview of a radiometric Lepton frame
+ * so display-only clients can be sent a small image while the camera keeps the
+ * radiometric data.  The algorithm and its settings are modeled on the Lepton's own
+ * HEQ AGC.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef AGC_UTILITIES_H
+#define AGC_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// AGC Utilities constants
+//
+
+// Number of histogram bins spread across the scene range
+#define AGC_HIST_BINS          512
+
+// Default settings
+#define AGC_DEF_DAMPING        64
+#define AGC_DEF_CLIP_HIGH      LEP_NUM_PIXELS
+#define AGC_DEF_CLIP_LOW       (LEP_NUM_PIXELS / AGC_HIST_BINS / 4)
+#define AGC_DEF_EMPTY_COUNTS   2
+#define AGC_DEF_LINEAR_PERCENT 20
+
+// Frame number gap (about 1 second) after which the damping restarts from the new frame
+#define AGC_MAX_GAP_FRAMES     9
+
+
+
+//
+// AGC Utilities typedefs
+//
+typedef struct {
+	int damping;                 // Temporal damping of the transfer function (0 - 100 %)
+	int clip_high;               // Maximum population of a histogram bin (pixels)
+	int clip_low;                // Population added to each non-empty histogram bin (pixels)
+	int empty_counts;            // Bins with fewer pixels are considered empty
+	int linear_percent;          // Portion of the output allocated linearly instead of by HEQ (0 - 100 %)
+} agc_config_t;
+
+
+
+//
+// AGC Utilities API
+//
+bool agc_init();
+void agc_set_config(agc_config_t* configP);
+void agc_get_config(agc_config_t* configP);
+uint8_t* agc_process(lep_buffer_t* lep_bufP, uint16_t* lo, uint16_t* hi);
+
+#endif /* AGC_UTILITIES_H */
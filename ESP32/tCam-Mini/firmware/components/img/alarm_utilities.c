@@ -0,0 +1,349 @@
+/*
+ * Alarm utilities
+ *
+ * Evaluates a set of host-defined temperature alarm rules against every Lepton frame
+ * and queues an event each time a rule becomes active or inactive.
+ *
+ * rsp_task evaluates the rules for each frame it takes from the frame ring (even while
+ * no images are being sent) so the work stays out of lep_task's acquisition loop.
+ * Events are queued in a small FIFO that rsp_task empties after each evaluation.  Rules
+ * are replaced by the command task under a mutex that is only held while they are
+ * copied.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "alarm_utilities.h"
+#include "roi_utilities.h"
+#include "temp_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+
+
+//
+// Alarm Utilities variables
+//
+static const char* TAG = "alarm_utilities";
+
+static const char* alarm_type_names[ALARM_NUM_TYPES] = {"max_above", "count_above", "rise"};
+
+static SemaphoreHandle_t alarm_mutex;
+
+// Rules (written by the command task)
+static alarm_rule_t alarm_rule[ALARM_MAX_NUM];
+static volatile int alarm_num = 0;
+static volatile bool alarm_rules_changed = false;
+
+// Rule evaluation state (only used by rsp_task)
+typedef struct {
+	bool active;
+	uint32_t temp_k100;                        // use_temp threshold as measured with the camera emissivity
+	int true_frames;                           // Consecutive frames the condition held
+	int hist_count;                            // Valid entries in the history
+	int hist_index;                            // Next history entry to write
+	uint16_t hist_val[ALARM_MAX_FRAMES];       // Region maximum history (ALARM_TYPE_RISE)
+	int64_t hist_usec[ALARM_MAX_FRAMES];
+} alarm_state_t;
+
+static alarm_rule_t alarm_cur_rule[ALARM_MAX_NUM];
+static int alarm_cur_num = 0;
+static alarm_state_t alarm_state[ALARM_MAX_NUM];
+static int alarm_cur_emissivity;               // Camera emissivity the temp_k100 values were computed for
+static temp_emis_table_t alarm_emis_table;
+
+// Event FIFO (free-running indices, only used by rsp_task)
+static alarm_event_t alarm_event[ALARM_EVENT_FIFO_LEN];
+static uint32_t alarm_event_push = 0;
+static uint32_t alarm_event_pop = 0;
+static uint32_t alarm_event_overflows = 0;
+
+
+
+//
+// Alarm Utilities Forward Declarations for internal functions
+//
+static void alarm_update_temps(int emissivity);
+static bool alarm_eval_rule(alarm_rule_t* ruleP, alarm_state_t* stP, lep_buffer_t* lep_bufP, int32_t* value);
+static bool alarm_push_event(int index, alarm_rule_t* ruleP, bool active, uint32_t frame_num, int32_t value);
+
+
+
+//
+// Alarm Utilities API
+//
+
+/**
+ * Initialize the module (before any other task uses it)
+ */
+bool alarm_init()
+{
+	alarm_mutex = xSemaphoreCreateMutex();
+	if (alarm_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create alarm mutex");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Replace the current rules with num (0 - ALARM_MAX_NUM) new rules.  All rules start
+ * inactive.
+ */
+void alarm_set_rules(alarm_rule_t* rules, int num)
+{
+	if (num > ALARM_MAX_NUM) num = ALARM_MAX_NUM;
+	
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	memcpy(alarm_rule, rules, num * sizeof(alarm_rule_t));
+	alarm_num = num;
+	alarm_rules_changed = true;
+	xSemaphoreGive(alarm_mutex);
+}
+
+
+/**
+ * Return true if any rules are defined (frames must be read to evaluate them)
+ */
+bool alarm_enabled()
+{
+	return (alarm_num != 0);
+}
+
+
+/**
+ * Evaluate the rules for a frame.  Called by rsp_task for each frame it takes from the
+ * frame ring.  Returns true if any events were queued.
+ */
+bool alarm_process(lep_buffer_t* lep_bufP)
+{
+	bool active;
+	bool queued = false;
+	int e;
+	int i;
+	int32_t value;
+	
+	// Pick up new rules
+	if (alarm_rules_changed) {
+		xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+		memcpy(alarm_cur_rule, alarm_rule, sizeof(alarm_rule));
+		alarm_cur_num = alarm_num;
+		alarm_rules_changed = false;
+		xSemaphoreGive(alarm_mutex);
+		
+		memset(alarm_state, 0, sizeof(alarm_state));
+		alarm_cur_emissivity = 0;
+	}
+	
+	// Temperature thresholds only change with the rules or the camera emissivity
+	e = system_get_lep_st()->emissivity;
+	if (e != alarm_cur_emissivity) {
+		alarm_update_temps(e);
+	}
+	
+	for (i=0; i<alarm_cur_num; i++) {
+		active = alarm_eval_rule(&alarm_cur_rule[i], &alarm_state[i], lep_bufP, &value);
+		if (active != alarm_state[i].active) {
+			alarm_state[i].active = active;
+			queued |= alarm_push_event(i, &alarm_cur_rule[i], active, lep_bufP->frame_num, value);
+		}
+	}
+	
+	return queued;
+}
+
+
+/**
+ * Get the oldest queued event.  Returns false if there are none.
+ */
+bool alarm_get_event(alarm_event_t* eventP)
+{
+	if (alarm_event_pop == alarm_event_push) {
+		return false;
+	}
+	
+	*eventP = alarm_event[alarm_event_pop & (ALARM_EVENT_FIFO_LEN - 1)];
+	alarm_event_pop++;
+	
+	return true;
+}
+
+
+/**
+ * Return the number of events discarded because the FIFO was full
+ */
+uint32_t alarm_get_overflow_count()
+{
+	return alarm_event_overflows;
+}
+
+
+/**
+ * Return the name of a rule type
+ */
+const char* alarm_get_type_name(int type)
+{
+	if ((type < 0) || (type >= ALARM_NUM_TYPES)) return "unknown";
+	
+	return alarm_type_names[type];
+}
+
+
+
+//
+// Alarm Utilities internal functions
+//
+
+/**
+ * Compute the temperature threshold of each rule that has one as it will be measured
+ * by the camera using emissivity.  Rules with their own emissivity are compensated for
+ * the difference.  Rate of rise thresholds are not compensated.
+ */
+static void alarm_update_temps(int emissivity)
+{
+	int i;
+	int32_t t;
+	alarm_rule_t* ruleP;
+	
+	for (i=0; i<alarm_cur_num; i++) {
+		ruleP = &alarm_cur_rule[i];
+		if (!ruleP->use_temp) continue;
+		
+		if (ruleP->type == ALARM_TYPE_RISE) {
+			alarm_state[i].temp_k100 = (ruleP->temp < 0) ? 0 : ruleP->temp;
+			continue;
+		}
+		
+		t = ruleP->temp + TEMP_ZERO_C_K100;
+		alarm_state[i].temp_k100 = (t < 0) ? 0 : t;
+		if ((ruleP->emissivity != 0) && (ruleP->emissivity != emissivity)) {
+			if ((alarm_emis_table.from_e != ruleP->emissivity) || (alarm_emis_table.to_e != emissivity)) {
+				temp_emis_build(&alarm_emis_table, ruleP->emissivity, emissivity);
+			}
+			alarm_state[i].temp_k100 = temp_emis_lookup(&alarm_emis_table, alarm_state[i].temp_k100);
+		}
+	}
+	
+	alarm_cur_emissivity = emissivity;
+}
+
+
+/**
+ * Evaluate one rule for a frame.  Returns true if the rule is active with the value
+ * that was compared to the threshold.
+ */
+static bool alarm_eval_rule(alarm_rule_t* ruleP, alarm_state_t* stP, lep_buffer_t* lep_bufP, int32_t* value)
+{
+	bool cond;
+	int n;
+	int old_index;
+	int threshold;
+	int64_t dt;
+	roi_stats_t stats;
+	
+	// Temperature thresholds are converted to counts for each frame since the resolution
+	// follows the gain mode
+	if (ruleP->use_temp) {
+		threshold = temp_k100_to_counts(stP->temp_k100, temp_get_resolution(lep_bufP));
+	} else {
+		threshold = ruleP->threshold;
+	}
+	
+	if (!roi_compute_region(lep_bufP->lep_bufferP, ruleP->roi, (uint16_t) threshold, &stats)) {
+		// Region no longer exists
+		*value = 0;
+		return false;
+	}
+	
+	switch (ruleP->type) {
+		case ALARM_TYPE_MAX_ABOVE:
+			*value = stats.max;
+			cond = (stats.max > threshold);
+			break;
+		
+		case ALARM_TYPE_COUNT_ABOVE:
+			*value = stats.above;
+			cond = (stats.above > ruleP->count);
+			break;
+		
+		case ALARM_TYPE_RISE:
+			// Compare the region maximum to its value ruleP->frames evaluated frames ago
+			// (using the time the frames were read so evaluation delays do not matter)
+			n = ruleP->frames;
+			cond = false;
+			*value = 0;
+			if (stP->hist_count >= n) {
+				old_index = (stP->hist_index - n + ALARM_MAX_FRAMES) % ALARM_MAX_FRAMES;
+				dt = lep_bufP->acq_usec - stP->hist_usec[old_index];
+				if (dt > 0) {
+					*value = (int32_t) (((int64_t) stats.max - stP->hist_val[old_index]) * 1000000 / dt);
+					cond = (*value > threshold);
+				}
+			}
+			stP->hist_val[stP->hist_index] = stats.max;
+			stP->hist_usec[stP->hist_index] = lep_bufP->acq_usec;
+			stP->hist_index = (stP->hist_index + 1) % ALARM_MAX_FRAMES;
+			if (stP->hist_count < ALARM_MAX_FRAMES) stP->hist_count++;
+			
+			// The window provides the debounce
+			return cond;
+		
+		default:
+			*value = 0;
+			return false;
+	}
+	
+	// Require the condition for the specified number of consecutive frames to become active
+	if (cond) {
+		if (stP->true_frames < ruleP->frames) stP->true_frames++;
+	} else {
+		stP->true_frames = 0;
+	}
+	
+	return (stP->true_frames >= ruleP->frames);
+}
+
+
+/**
+ * Queue an event for rsp_task.  Returns false if the FIFO was full.
+ */
+static bool alarm_push_event(int index, alarm_rule_t* ruleP, bool active, uint32_t frame_num, int32_t value)
+{
+	alarm_event_t* eventP;
+	
+	if ((alarm_event_push - alarm_event_pop) >= ALARM_EVENT_FIFO_LEN) {
+		alarm_event_overflows++;
+		return false;
+	}
+	
+	eventP = &alarm_event[alarm_event_push & (ALARM_EVENT_FIFO_LEN - 1)];
+	eventP->index = index;
+	eventP->type = ruleP->type;
+	eventP->active = active;
+	eventP->image = ruleP->image && active;
+	eventP->frame_num = frame_num;
+	eventP->value = value;
+	alarm_event_push++;
+	
+	return true;
+}
@@ -0,0 +1,97 @@
+/*
+ * Alarm utilities
+ *
+ * Evaluates a set of host-defined temperature alarm rules against every Lepton frame
+ * and queues an event each time a rule becomes active or inactive.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ALARM_UTILITIES_H
+#define ALARM_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Alarm Utilities constants
+//
+
+// Maximum number of rules
+#define ALARM_MAX_NUM          4
+
+// Rule types
+//   ALARM_TYPE_MAX_ABOVE   - region maximum above threshold
+//   ALARM_TYPE_COUNT_ABOVE - more than count region pixels above threshold
+//   ALARM_TYPE_RISE        - region maximum rising faster than threshold counts/second
+#define ALARM_TYPE_MAX_ABOVE   0
+#define ALARM_TYPE_COUNT_ABOVE 1
+#define ALARM_TYPE_RISE        2
+#define ALARM_NUM_TYPES        3
+
+// Maximum number of frames a rule may require (and the rate of rise window)
+#define ALARM_MAX_FRAMES       32
+
+// Default rate of rise window (about 1 second)
+#define ALARM_DEF_RISE_FRAMES  9
+
+// Number of events that may be waiting for rsp_task (must be a power of 2)
+#define ALARM_EVENT_FIFO_LEN   8
+
+
+
+//
+// Alarm Utilities typedefs
+//
+typedef struct {
+	int type;                    // ALARM_TYPE_xxx
+	int roi;                     // Region index or ROI_FULL_FRAME
+	int threshold;               // Image counts (counts/second for ALARM_TYPE_RISE)
+	bool use_temp;               // Set to use temp instead of threshold
+	int32_t temp;                // °C x 100 (°C x 100/second for ALARM_TYPE_RISE)
+	int emissivity;              // Target emissivity percent for temp (0 for the camera emissivity)
+	int count;                   // Pixel count for ALARM_TYPE_COUNT_ABOVE
+	int frames;                  // Consecutive frames the condition must hold (window for ALARM_TYPE_RISE)
+	bool image;                  // Set to send the image with the event
+} alarm_rule_t;
+
+typedef struct {
+	int index;                   // Rule index
+	int type;
+	bool active;                 // Set when the rule became active, clear when it became inactive
+	bool image;
+	uint32_t frame_num;          // Frame that caused the event
+	int32_t value;               // Region maximum, pixel count or rate of rise
+} alarm_event_t;
+
+
+
+//
+// Alarm Utilities API
+//
+bool alarm_init();
+void alarm_set_rules(alarm_rule_t* rules, int num);
+bool alarm_enabled();
+bool alarm_process(lep_buffer_t* lep_bufP);
+bool alarm_get_event(alarm_event_t* eventP);
+uint32_t alarm_get_overflow_count();
+const char* alarm_get_type_name(int type);
+
+#endif /* ALARM_UTILITIES_H */
@@ -0,0 +1,108 @@
+/*
+ * Change detection utilities
+ *
+ * Compares Lepton frames to the last frame sent so streaming can skip frames that
+ * have not changed.  A frame has changed when at least a specified number of pixels
+ * differ from the reference frame by more than a threshold (in image counts).  Only
+ * rsp_task uses this module.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "change_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "vospi.h"
+#include <string.h>
+
+
+
+//
+// Change Utilities variables
+//
+static const char* TAG = "change_utilities";
+
+// Last frame sent
+static uint16_t* change_refP = NULL;
+static bool change_ref_valid = false;
+
+
+
+//
+// Change Utilities API
+//
+
+/**
+ * Allocate the reference frame
+ */
+bool change_init()
+{
+	change_refP = heap_caps_malloc(LEP_NUM_PIXELS * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+	if (change_refP == NULL) {
+		ESP_LOGE(TAG, "malloc reference frame failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Forget the reference frame so the next frame is considered changed
+ */
+void change_reset()
+{
+	change_ref_valid = false;
+}
+
+
+/**
+ * Return true if at least pixels pixels of the image differ from the reference frame by
+ * more than threshold counts (or there is no reference frame).
+ */
+bool change_detect(uint16_t* imgP, int threshold, int pixels)
+{
+	int32_t d;
+	int i;
+	int n = 0;
+	uint16_t* refP = change_refP;
+	
+	if (!change_ref_valid) return true;
+	
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		d = (int32_t) *imgP++ - (int32_t) *refP++;
+		if ((d > threshold) || (d < -threshold)) {
+			if (++n >= pixels) return true;
+		}
+	}
+	
+	return false;
+}
+
+
+/**
+ * Make the image the reference frame subsequent frames are compared to
+ */
+void change_set_reference(uint16_t* imgP)
+{
+	if (change_refP == NULL) return;
+	
+	memcpy(change_refP, imgP, LEP_NUM_PIXELS * sizeof(uint16_t));
+	change_ref_valid = true;
+}
@@ -0,0 +1,52 @@
+/*
+ * Change detection utilities
+ *
+ * Compares Lepton frames to the last frame sent so streaming can skip frames that
+ * have not changed.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef CHANGE_UTILITIES_H
+#define CHANGE_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Change Utilities constants
+//
+
+// Default number of pixels that must change (1 = any pixel changing by more than the threshold)
+#define CHANGE_DEF_PIXELS      1
+
+// Default maximum time between frames when nothing changes (seconds)
+#define CHANGE_DEF_HEARTBEAT   60
+
+
+
+//
+// Change Utilities API
+//
+bool change_init();
+void change_reset();
+bool change_detect(uint16_t* imgP, int threshold, int pixels);
+void change_set_reference(uint16_t* imgP);
+
+#endif /* CHANGE_UTILITIES_H */
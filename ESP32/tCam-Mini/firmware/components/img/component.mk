@@ -0,0 +1,2 @@
+COMPONENT_SRCDIRS := . 
+COMPONENT_ADD_INCLUDEDIRS := . ../../main
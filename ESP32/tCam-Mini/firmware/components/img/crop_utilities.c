@@ -0,0 +1,97 @@
+/*
+ * Image crop utilities
+ *
+ * Copies a rectangle from a Lepton frame so only that part of the image is sent.  Only
+ * rsp_task crops images (while encoding an image to send) so the crop buffer is not
+ * shared.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "crop_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "vospi.h"
+#include <string.h>
+
+
+
+//
+// Crop Utilities variables
+//
+static const char* TAG = "crop_utilities";
+
+// Crop (large enough for the entire image)
+static uint16_t* crop_imageP = NULL;
+
+
+
+//
+// Crop Utilities API
+//
+
+/**
+ * Allocate the crop buffer
+ */
+bool crop_init()
+{
+	crop_imageP = heap_caps_malloc(LEP_NUM_PIXELS * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+	if (crop_imageP == NULL) {
+		ESP_LOGE(TAG, "malloc crop image failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Copy the rectangle from row r1, column c1 to row r2, column c2 (inclusive) of a
+ * LEP_WIDTH x LEP_HEIGHT image.  The coordinates must be valid.  Returns a pointer to
+ * the (c2-c1+1) x (r2-r1+1) crop (valid until the next call) or NULL if the buffer could
+ * not be allocated.  The minimum and maximum cropped pixel values are loaded into
+ * min_val and max_val if they are not NULL.
+ */
+uint16_t* crop_process(uint16_t* imgP, int r1, int c1, int r2, int c2, uint16_t* min_val, uint16_t* max_val)
+{
+	int r, c;
+	int w = c2 - c1 + 1;
+	uint16_t* inP;
+	uint16_t* outP = crop_imageP;
+	uint16_t p;
+	uint16_t out_min = 0xFFFF;
+	uint16_t out_max = 0;
+	
+	if (crop_imageP == NULL) return NULL;
+	
+	for (r=r1; r<=r2; r++) {
+		inP = imgP + (r * LEP_WIDTH) + c1;
+		for (c=0; c<w; c++) {
+			p = *inP++;
+			if (p < out_min) out_min = p;
+			if (p > out_max) out_max = p;
+			*outP++ = p;
+		}
+	}
+	
+	if (min_val != NULL) *min_val = out_min;
+	if (max_val != NULL) *max_val = out_max;
+	
+	return crop_imageP;
+}
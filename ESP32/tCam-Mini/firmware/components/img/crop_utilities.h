@@ -0,0 +1,37 @@
+/*
+ * Image crop utilities
+ *
+ * Copies a rectangle from a Lepton frame so only that part of the image is sent.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef CROP_UTILITIES_H
+#define CROP_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Crop Utilities API
+//
+bool crop_init();
+uint16_t* crop_process(uint16_t* imgP, int r1, int c1, int r2, int c2, uint16_t* min_val, uint16_t* max_val);
+
+#endif /* CROP_UTILITIES_H */
@@ -0,0 +1,150 @@
+/*
+ * Image decimation utilities
+ *
+ * Reduces a Lepton frame to a thumbnail by combining square blocks of pixels.  Only
+ * rsp_task decimates images (while encoding an image to send) so the thumbnail buffer
+ * is not shared.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "decimate_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "vospi.h"
+#include <string.h>
+
+
+
+//
+// Decimate Utilities variables
+//
+static const char* TAG = "decimate_utilities";
+
+static const char* decimate_mode_names[DECIMATE_NUM_MODES] = {"avg", "max", "min"};
+
+// Thumbnail (large enough for the smallest decimation factor)
+static uint16_t* decimate_imageP = NULL;
+
+
+
+//
+// Decimate Utilities API
+//
+
+/**
+ * Allocate the thumbnail buffer
+ */
+bool decimate_init()
+{
+	decimate_imageP = heap_caps_malloc((LEP_NUM_PIXELS / (DECIMATE_2 * DECIMATE_2)) * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+	if (decimate_imageP == NULL) {
+		ESP_LOGE(TAG, "malloc decimated image failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Decimate a LEP_WIDTH x LEP_HEIGHT image by factor (DECIMATE_2 or DECIMATE_4) using
+ * the specified DECIMATE_MODE_xxx.  Returns a pointer to the (LEP_WIDTH/factor) x
+ * (LEP_HEIGHT/factor) thumbnail (valid until the next call) or NULL if the factor is
+ * not supported or the buffer could not be allocated.  The minimum and maximum thumbnail
+ * pixel values are loaded into min_val and max_val if they are not NULL.
+ */
+uint16_t* decimate_process(uint16_t* imgP, int factor, int mode, uint16_t* min_val, uint16_t* max_val)
+{
+	int r, c, br, bc;
+	int out_w = LEP_WIDTH / factor;
+	int out_h = LEP_HEIGHT / factor;
+	int shift = (factor == DECIMATE_4) ? 4 : 2;         // log2(factor * factor)
+	uint16_t* outP = decimate_imageP;
+	uint16_t* blkP;
+	uint16_t* pixP;
+	uint16_t p;
+	uint16_t v;
+	uint16_t out_min = 0xFFFF;
+	uint16_t out_max = 0;
+	uint32_t sum;
+	
+	if ((decimate_imageP == NULL) || ((factor != DECIMATE_2) && (factor != DECIMATE_4))) {
+		return NULL;
+	}
+	
+	for (r=0; r<out_h; r++) {
+		blkP = imgP + (r * factor * LEP_WIDTH);
+		for (c=0; c<out_w; c++) {
+			sum = 0;
+			v = (mode == DECIMATE_MODE_MIN) ? 0xFFFF : 0;
+			for (br=0; br<factor; br++) {
+				pixP = blkP + (br * LEP_WIDTH);
+				for (bc=0; bc<factor; bc++) {
+					p = *pixP++;
+					sum += p;
+					if (mode == DECIMATE_MODE_MAX) {
+						if (p > v) v = p;
+					} else if (mode == DECIMATE_MODE_MIN) {
+						if (p < v) v = p;
+					}
+				}
+			}
+			
+			if (mode == DECIMATE_MODE_AVG) {
+				v = (uint16_t) ((sum + (1 << (shift - 1))) >> shift);
+			}
+			if (v < out_min) out_min = v;
+			if (v > out_max) out_max = v;
+			*outP++ = v;
+			blkP += factor;
+		}
+	}
+	
+	if (min_val != NULL) *min_val = out_min;
+	if (max_val != NULL) *max_val = out_max;
+	
+	return decimate_imageP;
+}
+
+
+/**
+ * Return the DECIMATE_MODE_xxx for a mode name or -1 if it is not known
+ */
+int decimate_mode_from_name(const char* name)
+{
+	int i;
+	
+	for (i=0; i<DECIMATE_NUM_MODES; i++) {
+		if (strcmp(name, decimate_mode_names[i]) == 0) return i;
+	}
+	
+	return -1;
+}
+
+
+/**
+ * Return the name of a decimation mode
+ */
+const char* decimate_get_mode_name(int mode)
+{
+	if ((mode < 0) || (mode >= DECIMATE_NUM_MODES)) return "unknown";
+	
+	return decimate_mode_names[mode];
+}
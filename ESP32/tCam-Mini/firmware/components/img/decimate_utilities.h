@@ -0,0 +1,59 @@
+/*
+ * Image decimation utilities
+ *
+ * Reduces a Lepton frame to a thumbnail by combining square blocks of pixels.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef DECIMATE_UTILITIES_H
+#define DECIMATE_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Decimate Utilities constants
+//
+
+// Supported decimation factors (output is 1/factor the width and height)
+#define DECIMATE_NONE          1
+#define DECIMATE_2             2
+#define DECIMATE_4             4
+
+// Decimation modes - how each block of pixels is combined
+//   DECIMATE_MODE_AVG - average (binned)
+//   DECIMATE_MODE_MAX - maximum (preserves hot spots)
+//   DECIMATE_MODE_MIN - minimum (preserves cold spots)
+#define DECIMATE_MODE_AVG      0
+#define DECIMATE_MODE_MAX      1
+#define DECIMATE_MODE_MIN      2
+#define DECIMATE_NUM_MODES     3
+
+
+
+//
+// Decimate Utilities API
+//
+bool decimate_init();
+uint16_t* decimate_process(uint16_t* imgP, int factor, int mode, uint16_t* min_val, uint16_t* max_val);
+int decimate_mode_from_name(const char* name);
+const char* decimate_get_mode_name(int mode);
+
+#endif /* DECIMATE_UTILITIES_H */
@@ -0,0 +1,228 @@
+/*
+ * Temporal noise filter utilities
+ *
+ * Implements an optional per-pixel recursive (IIR) filter applied by lep_task to
+ * each Lepton frame before it is published.  Pixels that change by more than a
+ * motion threshold bypass the filter so moving objects do not leave trails.
+ *
+ * The filter state is kept in PSRAM as one 32-bit fixed-point value per pixel
+ * (FILTER_FRAC_BITS fractional bits) and updated as
+ *
+ *   state += ((pixel << FILTER_FRAC_BITS) - state) >> strength
+ *
+ * so the noise of a stationary scene is reduced like averaging 2^(strength+1)-1
+ * frames.  The settings are packed into one word that other tasks write atomically.
+ * lep_task notices a change the next time it filters a frame and restarts the filter
+ * so the acquisition path never waits.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "filter_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "vospi.h"
+#include <string.h>
+
+
+
+//
+// Filter Utilities constants
+//
+
+// Packed settings word
+#define FILTER_CFG(m, s, t)   (((uint32_t) (m) << 24) | ((uint32_t) (s) << 16) | ((uint32_t) (t) & 0xFFFF))
+#define FILTER_CFG_MODE(c)    ((int) ((c) >> 24))
+#define FILTER_CFG_STR(c)     ((int) (((c) >> 16) & 0xFF))
+#define FILTER_CFG_MOTION(c)  ((int) ((c) & 0xFFFF))
+
+
+
+//
+// Filter Utilities variables
+//
+static const char* TAG = "filter_utilities";
+
+// Settings requested by any task
+static volatile uint32_t filter_req_config = FILTER_CFG(FILTER_MODE_OFF, FILTER_DEF_STRENGTH, FILTER_DEF_MOTION);
+
+// Filter state (only used by lep_task)
+static uint32_t filter_cur_config = FILTER_CFG(FILTER_MODE_OFF, FILTER_DEF_STRENGTH, FILTER_DEF_MOTION);
+static uint32_t* filter_stateP = NULL;
+static bool filter_state_valid = false;
+static int64_t filter_last_usec;
+
+// Time spent filtering each frame
+static sys_stage_time_t filter_time;
+
+
+
+//
+// Filter Utilities API
+//
+
+/**
+ * Allocate the filter state.  The filter is unavailable (frames pass through
+ * unmodified) if this fails.
+ */
+bool filter_init()
+{
+	filter_stateP = heap_caps_malloc(LEP_NUM_PIXELS*sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+	if (filter_stateP == NULL) {
+		ESP_LOGE(TAG, "malloc filter state failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Set the filter mode (FILTER_MODE_xxx), strength (FILTER_MIN_STRENGTH - FILTER_MAX_STRENGTH)
+ * and motion threshold (pixel counts, 0 to disable the bypass).  Takes effect, restarting
+ * the filter, with the next frame.
+ */
+void filter_set_config(int mode, int strength, int motion)
+{
+	if (strength < FILTER_MIN_STRENGTH) strength = FILTER_MIN_STRENGTH;
+	if (strength > FILTER_MAX_STRENGTH) strength = FILTER_MAX_STRENGTH;
+	if (motion < 0) motion = 0;
+	if (motion > 0xFFFF) motion = 0xFFFF;
+	
+	__atomic_store_n(&filter_req_config, FILTER_CFG(mode, strength, motion), __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Get the current filter settings
+ */
+void filter_get_config(int* mode, int* strength, int* motion)
+{
+	uint32_t config = __atomic_load_n(&filter_req_config, __ATOMIC_ACQUIRE);
+	
+	*mode = FILTER_CFG_MODE(config);
+	*strength = FILTER_CFG_STR(config);
+	*motion = FILTER_CFG_MOTION(config);
+}
+
+
+/**
+ * Filter a frame in place and update its image statistics.  Called by lep_task for
+ * each frame before it is published.
+ */
+void filter_process(lep_buffer_t* lep_bufP)
+{
+	uint16_t* pixP = lep_bufP->lep_bufferP;
+	uint32_t* stP = filter_stateP;
+	uint32_t config;
+	uint32_t x, s;
+	int32_t d, motion;
+	int strength;
+	uint16_t p;
+	uint16_t min = 0xFFFF;
+	uint16_t max = 0x0000;
+#ifdef LEP_HISTOGRAM_BINS
+	uint16_t* histP;
+	uint16_t base, top, shift;
+#endif
+	int64_t start_usec;
+	int i;
+	
+	start_usec = esp_timer_get_time();
+	
+	// Restart the filter when its settings change
+	config = __atomic_load_n(&filter_req_config, __ATOMIC_ACQUIRE);
+	if (config != filter_cur_config) {
+		filter_cur_config = config;
+		filter_state_valid = false;
+	}
+	
+	if ((FILTER_CFG_MODE(config) == FILTER_MODE_OFF) || (filter_stateP == NULL)) {
+		filter_state_valid = false;
+		return;
+	}
+	
+	// Restart the filter after a gap in frames (for example while the Lepton was idle)
+	if (filter_state_valid && ((start_usec - filter_last_usec) > FILTER_MAX_GAP_USEC)) {
+		filter_state_valid = false;
+	}
+	filter_last_usec = start_usec;
+	
+	if (!filter_state_valid) {
+		// Start from this frame
+		for (i=0; i<LEP_NUM_PIXELS; i++) {
+			*stP++ = (uint32_t) *pixP++ << FILTER_FRAC_BITS;
+		}
+		filter_state_valid = true;
+		return;
+	}
+	
+	strength = FILTER_CFG_STR(config);
+	motion = FILTER_CFG_MOTION(config) << FILTER_FRAC_BITS;
+	
+#ifdef LEP_HISTOGRAM_BINS
+	histP = lep_bufP->lep_histP;
+	base = lep_bufP->lep_hist_base;
+	shift = lep_bufP->lep_hist_shift;
+	top = LEP_HIST_TOP(base, shift);
+	if (histP != NULL) {
+		memset(histP, 0, LEP_HISTOGRAM_BINS*sizeof(uint16_t));
+	}
+#endif
+	
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		x = (uint32_t) *pixP << FILTER_FRAC_BITS;
+		s = *stP;
+		d = (int32_t) x - (int32_t) s;
+		
+		if ((motion != 0) && ((d > motion) || (d < -motion))) {
+			// Pixel changed too much to be noise - bypass the filter
+			s = x;
+		} else {
+			s += d >> strength;
+		}
+		*stP++ = s;
+		
+		p = (uint16_t) ((s + (1 << (FILTER_FRAC_BITS-1))) >> FILTER_FRAC_BITS);
+		*pixP++ = p;
+		
+		if (p < min) min = p;
+		if (p > max) max = p;
+#ifdef LEP_HISTOGRAM_BINS
+		if (histP != NULL) {
+			histP[LEP_HIST_BIN(p, base, top, shift)]++;
+		}
+#endif
+	}
+	
+	lep_bufP->lep_min_val = min;
+	lep_bufP->lep_max_val = max;
+	
+	system_stage_time_add(&filter_time, start_usec);
+}
+
+
+/**
+ * Return a copy of the time spent filtering frames
+ */
+void filter_get_stage_time(sys_stage_time_t* stP)
+{
+	*stP = filter_time;
+}
@@ -0,0 +1,67 @@
+/*
+ * Temporal noise filter utilities
+ *
+ * Implements an optional per-pixel recursive (IIR) filter applied by lep_task to
+ * each Lepton frame before it is published.  Pixels that change by more than a
+ * motion threshold bypass the filter so moving objects do not leave trails.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FILTER_UTILITIES_H
+#define FILTER_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Filter Utilities constants
+//
+
+// Filter modes
+#define FILTER_MODE_OFF        0
+#define FILTER_MODE_IIR        1
+
+// Filter strength: each output pixel moves 1/(2^strength) of the way to the new pixel
+#define FILTER_MIN_STRENGTH    1
+#define FILTER_MAX_STRENGTH    4
+
+// Default settings
+#define FILTER_DEF_STRENGTH    2
+#define FILTER_DEF_MOTION      200
+
+// Number of fractional bits in the per-pixel filter state
+#define FILTER_FRAC_BITS       8
+
+// Time between frames after which the filter restarts from the new frame
+#define FILTER_MAX_GAP_USEC    1000000
+
+
+
+//
+// Filter Utilities API
+//
+bool filter_init();
+void filter_set_config(int mode, int strength, int motion);
+void filter_get_config(int* mode, int* strength, int* motion);
+void filter_process(lep_buffer_t* lep_bufP);
+void filter_get_stage_time(sys_stage_time_t* stP);
+
+#endif /* FILTER_UTILITIES_H */
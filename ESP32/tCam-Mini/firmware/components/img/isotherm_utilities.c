@@ -0,0 +1,139 @@
+/*
+ * Isotherm mask utilities
+ *
+ * Computes a mask of the pixels inside a temperature band (lo - hi image counts,
+ * inclusive) and encodes it compactly for streaming.  The mask is run-length encoded
+ * when the runs are no larger than a bit mask (the usual case for a few hot or cold
+ * objects) and sent as a bit mask otherwise so the encoded mask is never larger than
+ * ISOTHERM_MASK_LEN bytes.  Only rsp_task computes masks (while encoding an image to
+ * send) so the mask buffer is not shared.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "isotherm_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+
+
+//
+// Isotherm Utilities variables
+//
+static const char* TAG = "isotherm_utilities";
+
+static const char* isotherm_encoding_names[] = {"rle", "bits"};
+
+// Encoded mask
+static uint8_t* isotherm_maskP = NULL;
+
+
+
+//
+// Isotherm Utilities API
+//
+
+/**
+ * Allocate the mask buffer
+ */
+bool isotherm_init()
+{
+	isotherm_maskP = heap_caps_malloc(ISOTHERM_MASK_LEN, MALLOC_CAP_SPIRAM);
+	if (isotherm_maskP == NULL) {
+		ESP_LOGE(TAG, "malloc isotherm mask failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Compute the encoded mask of the pixels in a LEP_WIDTH x LEP_HEIGHT image with values
+ * from lo to hi.  Returns a pointer to the mask (valid until the next call) with its
+ * ISOTHERM_ENC_xxx encoding, its length in bytes and the number of pixels inside the
+ * band, or NULL if the buffer could not be allocated.
+ */
+uint8_t* isotherm_process(uint16_t* imgP, uint16_t lo, uint16_t hi, int* encoding, int* len, int* pixels)
+{
+	bool in;
+	bool run_in = false;
+	int i;
+	int n = 0;
+	int runs = 0;
+	uint16_t p;
+	uint16_t run_len = 0;
+	uint16_t* runP = (uint16_t*) isotherm_maskP;
+	uint8_t b = 0;
+	uint8_t* outP;
+	
+	if (isotherm_maskP == NULL) return NULL;
+	
+	// Run lengths (the first run is pixels outside the band and may be empty)
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		p = imgP[i];
+		in = (p >= lo) && (p <= hi);
+		if (in) n++;
+		if (in != run_in) {
+			if (runs < ISOTHERM_MAX_RUNS) {
+				*runP++ = run_len;
+			}
+			runs++;
+			run_len = 0;
+			run_in = in;
+		}
+		run_len++;
+	}
+	if (runs < ISOTHERM_MAX_RUNS) {
+		*runP = run_len;
+	}
+	runs++;
+	*pixels = n;
+	
+	if (runs <= ISOTHERM_MAX_RUNS) {
+		*encoding = ISOTHERM_ENC_RLE;
+		*len = runs * sizeof(uint16_t);
+		return isotherm_maskP;
+	}
+	
+	// Too many runs - bit mask
+	outP = isotherm_maskP;
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		p = imgP[i];
+		b = (b << 1) | (((p >= lo) && (p <= hi)) ? 1 : 0);
+		if ((i & 0x7) == 0x7) {
+			*outP++ = b;
+		}
+	}
+	*encoding = ISOTHERM_ENC_BITS;
+	*len = ISOTHERM_MASK_LEN;
+	
+	return isotherm_maskP;
+}
+
+
+/**
+ * Return the name of a mask encoding
+ */
+const char* isotherm_get_encoding_name(int encoding)
+{
+	if ((encoding < ISOTHERM_ENC_RLE) || (encoding > ISOTHERM_ENC_BITS)) return "unknown";
+	
+	return isotherm_encoding_names[encoding];
+}
@@ -0,0 +1,61 @@
+/*
+ * Isotherm mask utilities
+ *
+ * Computes a mask of the pixels inside a temperature band and encodes it compactly for
+ * streaming.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ISOTHERM_UTILITIES_H
+#define ISOTHERM_UTILITIES_H
+
+#include "temp_utilities.h"
+#include "vospi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Isotherm Utilities constants
+//
+
+// Mask encodings
+//   ISOTHERM_ENC_RLE  - 16-bit run lengths alternating between pixels outside and inside
+//                       the band, starting with outside
+//   ISOTHERM_ENC_BITS - one bit per pixel (MSB first, 1 = inside the band)
+#define ISOTHERM_ENC_RLE       0
+#define ISOTHERM_ENC_BITS      1
+
+// Size of the bit mask (bytes) - run lengths are only used when they are no larger
+#define ISOTHERM_MASK_LEN      (LEP_NUM_PIXELS / 8)
+#define ISOTHERM_MAX_RUNS      (ISOTHERM_MASK_LEN / 2)
+
+// Upper band temperature (°C x 100) that includes every pixel at either resolution
+#define ISOTHERM_MAX_TEMP      (655350 - TEMP_ZERO_C_K100)
+
+
+
+//
+// Isotherm Utilities API
+//
+bool isotherm_init();
+uint8_t* isotherm_process(uint16_t* imgP, uint16_t lo, uint16_t hi, int* encoding, int* len, int* pixels);
+const char* isotherm_get_encoding_name(int encoding);
+
+#endif /* ISOTHERM_UTILITIES_H */
@@ -0,0 +1,275 @@
+/*
+ * Region of interest statistics utilities
+ *
+ * Maintains a set of host-defined rectangular regions of interest, each optionally
+ * restricted to the pixels selected by a bit mask, and computes radiometric
+ * statistics for each region from an image.
+ *
+ * Regions are set by the command task and used by rsp_task as it converts each image
+ * for transmission and evaluates alarm rules.  They are passed between the tasks
+ * without a lock using three region sets: the command task fills its back set and
+ * publishes it with a new sequence number by exchanging it with the shared middle set,
+ * and rsp_task swaps its front set for the middle set when it sees a new sequence
+ * number.  Each task only touches the set it owns so masks are freed only in sets
+ * rsp_task is no longer using.  Statistics are computed with integer sums so the
+ * standard deviation is exact for a full frame region.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "roi_utilities.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "vospi.h"
+#include <string.h>
+#include <math.h>
+
+
+
+//
+// ROI Utilities internal constants
+//
+
+// Region sets (back, middle and front)
+#define ROI_NUM_SETS   3
+
+// Shared word: middle set index in the low bits and the sequence number above them
+#define ROI_SET_MASK   0x3
+#define ROI_SEQ_SHIFT  2
+#define ROI_SHARED(set, seq) (((seq) << ROI_SEQ_SHIFT) | (set))
+
+
+
+//
+// ROI Utilities typedefs
+//
+typedef struct {
+	int num;
+	roi_def_t def[ROI_MAX_NUM];
+} roi_set_t;
+
+
+
+//
+// ROI Utilities variables
+//
+static roi_set_t roi_set[ROI_NUM_SETS];
+
+// Middle set and the sequence number of the regions it holds (exchanged by both tasks)
+static uint32_t roi_shared;
+
+// Command task state
+static int roi_back;
+static uint32_t roi_seq;
+
+// rsp_task state
+static int roi_front;
+static uint32_t roi_front_seq;
+
+
+
+//
+// ROI Utilities Forward Declarations for internal functions
+//
+static roi_set_t* roi_get_set();
+static void roi_compute_one(uint16_t* imgP, roi_def_t* defP, uint16_t threshold, roi_stats_t* statsP);
+
+
+
+//
+// ROI Utilities API
+//
+
+/**
+ * Initialize the module (before any other task uses it)
+ */
+bool roi_init()
+{
+	memset(roi_set, 0, sizeof(roi_set));
+	roi_front = 0;
+	roi_front_seq = 0;
+	roi_back = 2;
+	roi_seq = 0;
+	__atomic_store_n(&roi_shared, ROI_SHARED(1, 0), __ATOMIC_RELEASE);
+	
+	return true;
+}
+
+
+/**
+ * Replace the current regions with num (0 - ROI_MAX_NUM) new regions.  Ownership of
+ * any masks in defs passes to this module.  Called by the command task.
+ */
+void roi_set_regions(roi_def_t* defs, int num)
+{
+	int i;
+	uint32_t shared;
+	roi_set_t* setP = &roi_set[roi_back];
+	
+	if (num > ROI_MAX_NUM) num = ROI_MAX_NUM;
+	
+	// Our back set holds regions rsp_task has finished with (or never took)
+	for (i=0; i<setP->num; i++) {
+		if (setP->def[i].maskP != NULL) {
+			heap_caps_free(setP->def[i].maskP);
+		}
+	}
+	
+	for (i=0; i<num; i++) {
+		setP->def[i] = defs[i];
+	}
+	setP->num = num;
+	
+	// Publish the set and take the middle set as our new back set
+	roi_seq++;
+	shared = __atomic_exchange_n(&roi_shared, ROI_SHARED(roi_back, roi_seq), __ATOMIC_ACQ_REL);
+	roi_back = shared & ROI_SET_MASK;
+}
+
+
+/**
+ * Return the number of regions currently defined.  Called by rsp_task.
+ */
+int roi_get_num()
+{
+	return roi_get_set()->num;
+}
+
+
+/**
+ * Compute the statistics of each region for the image in imgP, loading statsP which
+ * must hold ROI_MAX_NUM entries.  Returns the number of regions.  Called by rsp_task.
+ */
+int roi_compute(uint16_t* imgP, roi_stats_t* statsP)
+{
+	int i;
+	roi_set_t* setP = roi_get_set();
+	
+	for (i=0; i<setP->num; i++) {
+		roi_compute_one(imgP, &setP->def[i], 0xFFFF, statsP++);
+	}
+	
+	return setP->num;
+}
+
+
+/**
+ * Compute the statistics of one region (or the entire image for ROI_FULL_FRAME) for
+ * the image in imgP including the number of pixels above threshold.  Returns false
+ * if the region is not defined.
+ */
+bool roi_compute_region(uint16_t* imgP, int index, uint16_t threshold, roi_stats_t* statsP)
+{
+	roi_def_t full_frame = {0, 0, LEP_HEIGHT-1, LEP_WIDTH-1, NULL};
+	roi_set_t* setP;
+	
+	if (index == ROI_FULL_FRAME) {
+		roi_compute_one(imgP, &full_frame, threshold, statsP);
+		return true;
+	}
+	
+	setP = roi_get_set();
+	if ((index < 0) || (index >= setP->num)) {
+		return false;
+	}
+	
+	roi_compute_one(imgP, &setP->def[index], threshold, statsP);
+	
+	return true;
+}
+
+
+
+//
+// ROI Utilities internal functions
+//
+
+/**
+ * Return rsp_task's current region set, first swapping it for the middle set if the
+ * command task has published new regions.  Our old set (marked with the sequence
+ * number we took so we don't take it back) becomes the middle set.
+ */
+static roi_set_t* roi_get_set()
+{
+	uint32_t shared;
+	uint32_t seq;
+	
+	shared = __atomic_load_n(&roi_shared, __ATOMIC_ACQUIRE);
+	while ((seq = (shared >> ROI_SEQ_SHIFT)) != roi_front_seq) {
+		// Fails (updating shared) if the command task published another set in the meantime
+		if (__atomic_compare_exchange_n(&roi_shared, &shared, ROI_SHARED(roi_front, seq),
+		                                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			roi_front = shared & ROI_SET_MASK;
+			roi_front_seq = seq;
+		}
+	}
+	
+	return &roi_set[roi_front];
+}
+
+
+/**
+ * Compute the statistics for one region, counting pixels above threshold
+ */
+static void roi_compute_one(uint16_t* imgP, roi_def_t* defP, uint16_t threshold, roi_stats_t* statsP)
+{
+	uint16_t* rowP;
+	uint16_t p;
+	uint16_t min = 0xFFFF;
+	uint16_t max = 0x0000;
+	uint32_t n = 0;
+	uint32_t above = 0;
+	uint32_t sum = 0;
+	uint64_t sum_sq = 0;
+	uint64_t var_num;
+	int bit = 0;
+	int r, c;
+	
+	for (r=defP->r1; r<=defP->r2; r++) {
+		rowP = imgP + (r * LEP_WIDTH);
+		for (c=defP->c1; c<=defP->c2; c++) {
+			if ((defP->maskP == NULL) || ((defP->maskP[bit >> 3] & (1 << (bit & 0x7))) != 0)) {
+				p = rowP[c];
+				if (p < min) min = p;
+				if (p > max) max = p;
+				if (p > threshold) above++;
+				sum += p;
+				sum_sq += (uint32_t) p * p;
+				n++;
+			}
+			bit++;
+		}
+	}
+	
+	statsP->count = n;
+	statsP->above = above;
+	if (n == 0) {
+		statsP->min = 0;
+		statsP->max = 0;
+		statsP->mean = 0;
+		statsP->stddev = 0;
+	} else {
+		statsP->min = min;
+		statsP->max = max;
+		statsP->mean = (float) sum / (float) n;
+		
+		// n * sum(p^2) - sum(p)^2 fits in 64 bits for a full frame of 16-bit pixels
+		var_num = ((uint64_t) n * sum_sq) - ((uint64_t) sum * sum);
+		statsP->stddev = sqrtf((float) var_num / ((float) n * (float) n));
+	}
+}
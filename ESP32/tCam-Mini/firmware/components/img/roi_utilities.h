@@ -0,0 +1,84 @@
+/*
+ * Region of interest statistics utilities
+ *
+ * Maintains a set of host-defined rectangular regions of interest, each optionally
+ * restricted to the pixels selected by a bit mask, and computes radiometric
+ * statistics for each region from an image.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ROI_UTILITIES_H
+#define ROI_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// ROI Utilities constants
+//
+
+// Maximum number of regions
+#define ROI_MAX_NUM 8
+
+// Region index used to specify the entire image
+#define ROI_FULL_FRAME -1
+
+// Mask length (bytes) for a region w pixels wide and h pixels high
+#define ROI_MASK_LEN(w, h) ((((w) * (h)) + 7) / 8)
+
+
+
+//
+// ROI Utilities typedefs
+//
+
+// Region definition.  Coordinates are inclusive.  maskP, if not NULL, points to
+// ROI_MASK_LEN bytes with one bit per pixel of the rectangle in row order (bit 0 of
+// byte 0 is the upper left pixel) set for pixels included in the region.
+typedef struct {
+	uint16_t r1;
+	uint16_t c1;
+	uint16_t r2;
+	uint16_t c2;
+	uint8_t* maskP;              // Allocated with heap_caps_malloc
+} roi_def_t;
+
+// Region statistics (in image counts)
+typedef struct {
+	uint32_t count;              // Pixels in the region
+	uint32_t above;              // Pixels above a threshold (roi_compute_region only)
+	uint16_t min;
+	uint16_t max;
+	float mean;
+	float stddev;
+} roi_stats_t;
+
+
+
+//
+// ROI Utilities API
+//
+bool roi_init();
+void roi_set_regions(roi_def_t* defs, int num);
+int roi_get_num();
+int roi_compute(uint16_t* imgP, roi_stats_t* statsP);
+bool roi_compute_region(uint16_t* imgP, int index, uint16_t threshold, roi_stats_t* statsP);
+
+#endif /* ROI_UTILITIES_H */
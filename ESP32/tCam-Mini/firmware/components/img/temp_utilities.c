@@ -0,0 +1,167 @@
+/*
+ * Radiometric temperature utilities
+ *
+ * Integer conversions between Lepton TLinear pixel values and temperatures and an
+ * emissivity compensation table so on-camera features can work in image counts.
+ * Per-pixel code should convert its temperatures to counts once (for each frame, since
+ * the resolution follows the Lepton's gain mode) and then compare pixels directly.
+ *
+ * Temperatures are integers scaled by 100 (K x 100, °C x 100 or °F x 100).  A pixel
+ * is K x 100 at TEMP_RES_HIGH and K x 10 at TEMP_RES_LOW.
+ *
+ * The emissivity table converts a temperature measured with one emissivity into the
+ * temperature that would have been measured with another.  It uses a total radiance
+ * (T^4) model with the same background temperature the Lepton is configured with.
+ * The table is computed once (with floating point) and looked up with linear
+ * interpolation.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "temp_utilities.h"
+#include "lepton_utilities.h"
+#include <math.h>
+
+
+
+//
+// Temp Utilities API
+//
+
+/**
+ * Return the TLinear resolution (TEMP_RES_xxx) of a frame.  Uses the telemetry when it
+ * is valid or the configured gain mode when it is not.
+ */
+int temp_get_resolution(lep_buffer_t* lep_bufP)
+{
+	if (lep_bufP->telem_valid) {
+		return (lep_bufP->lep_telemP[LEP_TEL_TLIN_RES] != 0) ? TEMP_RES_HIGH : TEMP_RES_LOW;
+	}
+	
+	return (system_get_lep_st()->gain_mode == SYS_GAIN_LOW) ? TEMP_RES_LOW : TEMP_RES_HIGH;
+}
+
+
+/**
+ * Convert a pixel value to K x 100
+ */
+uint32_t temp_counts_to_k100(uint16_t counts, int res)
+{
+	return (res == TEMP_RES_HIGH) ? (uint32_t) counts : (uint32_t) counts * 10;
+}
+
+
+/**
+ * Convert a pixel value to °C x 100
+ */
+int32_t temp_counts_to_c100(uint16_t counts, int res)
+{
+	return (int32_t) temp_counts_to_k100(counts, res) - TEMP_ZERO_C_K100;
+}
+
+
+/**
+ * Convert a pixel value to °F x 100 (°F = K x 9/5 - 459.67)
+ */
+int32_t temp_counts_to_f100(uint16_t counts, int res)
+{
+	if (res == TEMP_RES_HIGH) {
+		return (int32_t) ((counts * 9 + 2) / 5) - 45967;
+	} else {
+		return (int32_t) (counts * 18) - 45967;
+	}
+}
+
+
+/**
+ * Convert K x 100 to the nearest pixel value, limited to the 16-bit pixel range
+ */
+uint16_t temp_k100_to_counts(uint32_t k100, int res)
+{
+	if (res != TEMP_RES_HIGH) {
+		k100 = (k100 + 5) / 10;
+	}
+	
+	return (k100 > 0xFFFF) ? 0xFFFF : (uint16_t) k100;
+}
+
+
+/**
+ * Convert °C x 100 to the nearest pixel value, limited to the 16-bit pixel range
+ */
+uint16_t temp_c100_to_counts(int32_t c100, int res)
+{
+	c100 += TEMP_ZERO_C_K100;
+	
+	return temp_k100_to_counts((c100 < 0) ? 0 : (uint32_t) c100, res);
+}
+
+
+/**
+ * Compute the table converting temperatures measured with emissivity from_e into
+ * temperatures compensated for emissivity to_e (both integer percent 1 - 100).  The
+ * radiance is the same for both:
+ *
+ *   from_e * T_from^4 + (1 - from_e) * T_bkg^4 = to_e * T_to^4 + (1 - to_e) * T_bkg^4
+ */
+void temp_emis_build(temp_emis_table_t* tblP, int from_e, int to_e)
+{
+	float bkg4;
+	float t;
+	float w;
+	int i;
+	
+	if (from_e < 1) from_e = 1;
+	if (from_e > 100) from_e = 100;
+	if (to_e < 1) to_e = 1;
+	if (to_e > 100) to_e = 100;
+	tblP->from_e = from_e;
+	tblP->to_e = to_e;
+	
+	t = TEMP_BKG_K100 / 100.0;
+	bkg4 = t * t * t * t;
+	
+	for (i=0; i<TEMP_EMIS_LEN; i++) {
+		t = (i << TEMP_EMIS_SHIFT) / 100.0;
+		w = (from_e * t * t * t * t + (to_e - from_e) * bkg4) / to_e;
+		if (w <= 0) {
+			tblP->k100[i] = 0;
+		} else {
+			t = sqrtf(sqrtf(w)) * 100.0 + 0.5;
+			tblP->k100[i] = (t > 65535.0) ? 0xFFFF : (uint16_t) t;
+		}
+	}
+}
+
+
+/**
+ * Convert a temperature (K x 100) using an emissivity table
+ */
+uint16_t temp_emis_lookup(temp_emis_table_t* tblP, uint32_t k100)
+{
+	int32_t v0, v1;
+	uint32_t i;
+	
+	if (k100 > 0xFFFF) k100 = 0xFFFF;
+	
+	i = k100 >> TEMP_EMIS_SHIFT;
+	v0 = tblP->k100[i];
+	v1 = tblP->k100[i+1];
+	
+	return (uint16_t) (v0 + (((v1 - v0) * (int32_t) (k100 & ((1 << TEMP_EMIS_SHIFT) - 1))) >> TEMP_EMIS_SHIFT));
+}
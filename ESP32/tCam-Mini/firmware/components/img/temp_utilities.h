@@ -0,0 +1,79 @@
+/*
+ * Radiometric temperature utilities
+ *
+ * Integer conversions between Lepton TLinear pixel values and temperatures and an
+ * emissivity compensation table so on-camera features can work in image counts.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TEMP_UTILITIES_H
+#define TEMP_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Temp Utilities constants
+//
+
+// TLinear resolution (matches the telemetry TLinear Resolution Flag)
+//   TEMP_RES_LOW  - pixel is K x 10 (Low gain)
+//   TEMP_RES_HIGH - pixel is K x 100 (High gain)
+#define TEMP_RES_LOW           0
+#define TEMP_RES_HIGH          1
+
+// 0°C in K x 100
+#define TEMP_ZERO_C_K100       27315
+
+// Background temperature (K x 100) used for emissivity compensation (matches the
+// TBkgK value lepton_emissivity() sets in the Lepton)
+#define TEMP_BKG_K100          29515
+
+// Emissivity table - one entry every (1 << TEMP_EMIS_SHIFT) K x 100 across the 16-bit range
+#define TEMP_EMIS_SHIFT        8
+#define TEMP_EMIS_LEN          ((65536 >> TEMP_EMIS_SHIFT) + 1)
+
+
+
+//
+// Temp Utilities typedefs
+//
+typedef struct {
+	int from_e;                  // Emissivity (percent) the input temperatures were measured with
+	int to_e;                    // Emissivity (percent) the output temperatures are compensated for
+	uint16_t k100[TEMP_EMIS_LEN];
+} temp_emis_table_t;
+
+
+
+//
+// Temp Utilities API
+//
+int temp_get_resolution(lep_buffer_t* lep_bufP);
+uint32_t temp_counts_to_k100(uint16_t counts, int res);
+int32_t temp_counts_to_c100(uint16_t counts, int res);
+int32_t temp_counts_to_f100(uint16_t counts, int res);
+uint16_t temp_k100_to_counts(uint32_t k100, int res);
+uint16_t temp_c100_to_counts(int32_t c100, int res);
+void temp_emis_build(temp_emis_table_t* tblP, int from_e, int to_e);
+uint16_t temp_emis_lookup(temp_emis_table_t* tblP, uint32_t k100);
+
+#endif /* TEMP_UTILITIES_H */
@@ -150,7 +150,21 @@ bool lepton_init()
 		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
   		return false;
 	}
-	vospi_include_telem(true);
+	
+	// Telemetry location
+#ifdef LEP_TELEM_LOCATION_HEADER
+	val = CCI_TELEMETRY_LOCATION_HEADER;
+#else
+	val = CCI_TELEMETRY_LOCATION_FOOTER;
+#endif
+	cci_set_telemetry_location(val);
+	rsp = cci_get_telemetry_location();
+	ESP_LOGI(TAG, "Lepton Telemetry Location = %d", rsp);
+	if (rsp != val) {
+		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
+  		return false;
+	}
+	vospi_include_telem(true, val == CCI_TELEMETRY_LOCATION_HEADER);
 	
 	// GAIN
 	switch (lep_stP->gain_mode) {
@@ -2,8 +2,9 @@
  * Lepton VoSPI Module
  *
  * Contains the functions to get frames from a Lepton 3.5 via its SPI port.
- * Optionally supports collecting telemetry when enabled as a footer (does not
- * support telemetry enabled as a header).
+ * Optionally supports collecting telemetry when enabled as either a header or
+ * a footer.  Header telemetry is available as soon as the first segment of a
+ * frame has been identified, before the image data has been read.
  *
  * Copyright 2020-2022 Dan Julio
  *
@@ -35,6 +36,7 @@
 #include "freertos/task.h"
 #include "driver/spi_master.h"
 #include "system_config.h"
+#include "lepton_utilities.h"
 #include "vospi.h"
 
 
@@ -53,11 +55,17 @@ static spi_transaction_t lep_spi_trans;
 // Pointer to allocated array to store one Lepton packet (DMA capable)
 static uint8_t* lepPacketP;
 
-// Lepton Frame buffer (16-bit values)
-static uint16_t lepBuffer[LEP_NUM_PIXELS];
+#ifdef LEP_SPI_SEG_DMA
+// Pointer to allocated array to store one Lepton segment (DMA capable) and the
+// set of transactions queued to fill it
+static uint8_t* lepSegmentP;
+static spi_transaction_t lep_seg_trans[LEP_TEL_PKTS_PER_SEG];
+#endif
 
-// Lepton Telemetry buffer (16-bit values)
-static uint16_t lepTelem[LEP_TEL_WORDS];
+// Lepton Frame and Telemetry buffers (16-bit values) in the shared frame buffer
+// currently owned by the acquisition task.  Frames are assembled directly into them.
+static uint16_t* lepBufferP;
+static uint16_t* lepTelemP;
 
 // Processing State
 static int curSegment = 1;
@@ -65,6 +73,75 @@ static int curLinesPerSeg = LEP_NOTEL_PKTS_PER_SEG;
 static int curWordsPerSeg = LEP_NOTEL_WORDS_PER_SEG;
 static bool validSegmentRegion = false;
 static bool includeTelemetry = false;
+static bool telemetryHeader = false;
+
+// Set when a segment of the frame being read arrived out of sequence (cleared when read)
+static bool sequenceLost = false;
+
+// Set when the header telemetry for the frame currently being read is complete
+static bool headerTelemValid = false;
+
+// Set when the last transfer discarded a partially read new frame
+static bool frameDiscarded;
+
+// FFC state (LEP_FFC_STATE_xxx) from the most recently read telemetry, including the
+// telemetry of duplicate frames since the Lepton repeats frames while it runs a FFC
+static uint32_t telemFfcState = LEP_FFC_STATE_IDLE;
+
+// Per-segment packet processing state
+static uint8_t prevLine;
+static bool beforeValidData;
+static bool segmentSuccess;
+static int completedSegment;      // Valid segment (1-4) read by the last transfer, 0 if none
+
+// Image statistics accumulated as packets are unpacked for the segment being read
+// and then merged into the statistics for the frame being read when the segment
+// is known to be good
+static uint16_t segMin, segMax;
+static uint16_t frameMin, frameMax;
+static uint32_t segHash, frameHash;
+#ifdef LEP_HISTOGRAM_BINS
+static uint16_t segHist[LEP_HISTOGRAM_BINS];
+static uint16_t frameHist[LEP_HISTOGRAM_BINS];
+
+// Range of the histogram of the frame being read (the full 16-bit range until a
+// frame has been read)
+static uint16_t histBase = 0;
+static uint16_t histShift = 16 - LEP_HISTOGRAM_BITS;
+#endif
+
+// Duplicate frame detection
+//   Frames are identified by the telemetry frame counter when telemetry is included
+//   or a hash of the image data otherwise.  A frame with the same identification as
+//   the previous frame is not returned.  With header telemetry the frame being read
+//   is identified when its first segment has been read, otherwise when its last
+//   segment has been read.
+static bool lastFrameIdValid = false;
+static uint32_t lastFrameId;
+static uint32_t curFrameId;
+static bool curFrameDup = false;
+static uint32_t dupFrameCount = 0;
+
+// CRC error counts
+//   crcCurFrameErrors  - errors since the last successfully read frame
+//   crcLastFrameErrors - errors seen between the last two successfully read frames
+//   crcTotalErrors     - errors since boot
+static uint32_t crcCurFrameErrors = 0;
+static uint32_t crcLastFrameErrors = 0;
+static uint32_t crcTotalErrors = 0;
+
+// Statistics
+//   read_errors[DISCARD]         - discard packets read
+//   read_errors[SEGMENT_ERROR]   - segment not complete when the segment interval expired
+//   read_errors[ROW_ERROR]       - packet line number out of sequence
+//   read_errors[SEGMENT_INVALID] - illegal segment number while reading a frame
+//   read_errors[SEGMENT_SEQUENCE] - legal segment number out of sequence while reading a frame
+static vospi_stats_t stats;
+
+#ifdef LEP_SPI_CHECK_CRC
+// CRC16 lookup table (one entry per byte value)
+static uint16_t crc16Table[256];
+#endif
 
 
 
@@ -73,8 +150,23 @@ static bool includeTelemetry = false;
 // VoSPI Forward Declarations for internal functions
 //
 static bool transfer_packet(uint8_t* line, uint8_t* seg);
-static void copy_packet_to_lepton_buffer(uint8_t line);
-static void copy_packet_to_telem_buffer(uint8_t line);
+#ifdef LEP_SPI_SEG_DMA
+static int transfer_segment_dma();
+#endif
+static bool parse_packet(uint8_t* pktP, uint8_t* line, uint8_t* seg);
+static bool process_packet(uint8_t* pktP, uint8_t line, uint8_t seg);
+static void copy_packet_to_lepton_buffer(uint8_t* pktP, uint8_t line);
+static void copy_packet_to_telem_buffer(uint8_t* pktP, uint8_t line);
+static void merge_segment_stats(bool first);
+#ifdef LEP_HISTOGRAM_BINS
+static void set_hist_range(uint16_t min, uint16_t max);
+#endif
+static void restart_frame(int reason);
+static void identify_frame();
+#ifdef LEP_SPI_CHECK_CRC
+static void init_crc16_table();
+static bool packet_crc_valid(uint8_t* pktP);
+#endif
 
 
 
@@ -88,6 +180,9 @@ static void copy_packet_to_telem_buffer(uint8_t line);
 int vospi_init(int csn_pin)
 {
 	esp_err_t ret;
+#ifdef LEP_SPI_SEG_DMA
+	int i;
+#endif
   
 	spi_device_interface_config_t devcfg = {
 		.command_bits = 0,
@@ -95,7 +190,11 @@ int vospi_init(int csn_pin)
 		.clock_speed_hz = LEP_SPI_FREQ_HZ,
 		.mode = 3,
 		.spics_io_num = csn_pin,
+#ifdef LEP_SPI_SEG_DMA
+		.queue_size = LEP_TEL_PKTS_PER_SEG,
+#else
 		.queue_size = 1,
+#endif
 		.flags = SPI_DEVICE_HALFDUPLEX,
 		.cs_ena_pretrans = 10
 	};
@@ -111,6 +210,16 @@ int vospi_init(int csn_pin)
 			ESP_LOGE(TAG, "failed to allocate lepton DMA packet buffer");
 			ret = ESP_FAIL;
 		}
+#ifdef LEP_SPI_SEG_DMA
+		if (ret == ESP_OK) {
+			// Allocate DMA capable memory for a full segment (with telemetry)
+			lepSegmentP = (uint8_t*) heap_caps_malloc(LEP_TEL_PKTS_PER_SEG*LEP_PKT_LENGTH, MALLOC_CAP_DMA);
+			if (lepSegmentP == NULL) {
+				ESP_LOGE(TAG, "failed to allocate lepton DMA segment buffer");
+				ret = ESP_FAIL;
+			}
+		}
+#endif
 	}
 	
 	// Setup our SPI transaction
@@ -118,6 +227,20 @@ int vospi_init(int csn_pin)
 	lep_spi_trans.tx_buffer = NULL;
 	lep_spi_trans.rx_buffer = lepPacketP;
 	lep_spi_trans.rxlength = LEP_PKT_LENGTH*8;
+	
+#ifdef LEP_SPI_SEG_DMA
+	// Setup the segment transactions, one per packet in the segment buffer
+	for (i=0; i<LEP_TEL_PKTS_PER_SEG; i++) {
+		memset(&lep_seg_trans[i], 0, sizeof(spi_transaction_t));
+		lep_seg_trans[i].tx_buffer = NULL;
+		lep_seg_trans[i].rx_buffer = (ret == ESP_OK) ? lepSegmentP + (i * LEP_PKT_LENGTH) : NULL;
+		lep_seg_trans[i].rxlength = LEP_PKT_LENGTH*8;
+	}
+#endif
+
+#ifdef LEP_SPI_CHECK_CRC
+	init_crc16_table();
+#endif
 
 	return ret;
 }
@@ -125,126 +248,277 @@ int vospi_init(int csn_pin)
 
 /**
  * Attempt to read a complete segment from the Lepton
- *  - Data loaded into lepBuffer
- *  - Returns true when last successful segment read, false otherwise
+ *  - Data loaded into the buffer set by vospi_set_frame_buffer()
+ *  - Returns true when the last segment of a new frame was read, false otherwise
+ *    (including when the frame read was a repeat of the previous frame)
+ *
+ * When LEP_SPI_SEG_DMA is defined the expected number of packets for a segment are
+ * first read using queued DMA transactions and then processed in bulk.  Any packets
+ * still required (for example because the Lepton sent discard packets) are then read
+ * one at a time until the segment is complete or the segment interval expires.
  */
 bool vospi_transfer_segment(uint64_t vsyncDetectedUsec)
 {
-	uint8_t line, prevLine;
+	uint8_t line;
 	uint8_t segment;
 	bool done = false;
-	bool beforeValidData = true;
-	bool success = false;
+	int64_t startUsec;
+#ifdef LEP_SPI_SEG_DMA
+	int i, n;
+	uint8_t* pktP;
+#endif
 
+	startUsec = esp_timer_get_time();
+	
 	prevLine = 255;
+	beforeValidData = true;
+	segmentSuccess = false;
+	completedSegment = 0;
+	frameDiscarded = false;
+	
+	segMin = 0xFFFF;
+	segMax = 0x0000;
+	segHash = LEP_HASH_OFFSET;
+#ifdef LEP_HISTOGRAM_BINS
+	memset(segHist, 0, sizeof(segHist));
+#endif
+
+#ifdef LEP_SPI_SEG_DMA
+	// Bulk read and process the segment
+	n = transfer_segment_dma();
+	for (i=0; i<n; i++) {
+		pktP = lepSegmentP + (i * LEP_PKT_LENGTH);
+		if (parse_packet(pktP, &line, &segment)) {
+			if (process_packet(pktP, line, segment)) {
+				done = true;
+				break;
+			}
+		} else {
+			stats.read_errors[DISCARD]++;
+		}
+	}
+#endif
 
+	// Read individual packets as necessary to complete the segment
 	while (!done) {
 		if (transfer_packet(&line, &segment)) {
-			// Saw a valid packet
-			if (line == prevLine) {
-			// This is garbage data since line numbers should always increment
-			done = true;
-			} else {
-				// Check for termination or completion conditions
-				if (line == 20) {
-					// Check segment
-					if (!validSegmentRegion) {
-						// Look for start of valid segment data
-						if (segment == 1) {
-							beforeValidData = false;
-							validSegmentRegion = true;
-						}
-					} else if ((segment < 2) || (segment > 4)) {
-						// Hold/Reset in starting position (always collecting in segment 1 buffer locations)
-						validSegmentRegion = false;  // In case it was set
-						curSegment = 1;
-					}
-				}
-        
-				// Copy the data to the lepton frame buffer or telemetry buffer
-				//  - beforeValidData is used to collect data before we know if the current segment (1) is valid
-				//  - then we use validSegmentRegion for remaining data once we know we're seeing valid data
-				if (includeTelemetry && validSegmentRegion && (curSegment == 4) && (line >= 57)) {
-					copy_packet_to_telem_buffer(line - 57);
-				}
-				else if ((beforeValidData || validSegmentRegion) && (line < curLinesPerSeg)) {
-					copy_packet_to_lepton_buffer(line);
-				}
-	
-				if (line == (curLinesPerSeg-1)) {
-					// Saw a complete segment, move to next segment or complete frame aquisition if possible
-					if (validSegmentRegion) {
-						if (curSegment < 4) {
-							// Setup to get next segment
-							curSegment++;
-						} else {
-							// Got frame
-							success = true;
-
-							// Setup to get the next frame
-							curSegment = 1;
-							validSegmentRegion = false;
-						}
-					}
-					done = true;
-				}
+			done = process_packet(lepPacketP, line, segment);
+		} else {
+			stats.read_errors[DISCARD]++;
+			if ((esp_timer_get_time() - vsyncDetectedUsec) > LEP_MAX_FRAME_XFER_WAIT_USEC) {
+				// Did not see a valid packet within this segment interval
+				stats.read_errors[SEGMENT_ERROR]++;
+				done = true;
 			}
-			prevLine = line;
-		} else if ((esp_timer_get_time() - vsyncDetectedUsec) > LEP_MAX_FRAME_XFER_WAIT_USEC) {
-			// Did not see a valid packet within this segment interval
-      		done = true;
-    	}
+		}
 	}
 	
-  	return success;
+	system_stage_time_add(&stats.xfer, startUsec);
+	
+  	return segmentSuccess;
+}
+
+
+/**
+ * Set the shared buffer frames are assembled into.  Must be called before the first
+ * call to vospi_transfer_segment() and should only be changed after a complete frame
+ * has been read.
+ */
+void vospi_set_frame_buffer(lep_buffer_t* sys_bufP)
+{
+	lepBufferP = sys_bufP->lep_bufferP;
+	lepTelemP = sys_bufP->lep_telemP;
 }
 
 
 /**
- * Load the a system buffer from our buffers for another task
+ * Finish the frame just assembled in the current shared buffer so it is ready to
+ * be published to another task (image statistics were computed as it was read)
  */
 void vospi_get_frame(lep_buffer_t* sys_bufP)
 {
-	uint16_t* sptr = sys_bufP->lep_bufferP;
-	uint16_t* lptr = &lepBuffer[0];
-	uint16_t min = 0xFFFF;
-	uint16_t max = 0x0000;
-	uint16_t t16;
-
-	// Load lepton image data
-	while (lptr < &lepBuffer[LEP_NUM_PIXELS]) {
-		t16 = *lptr++;
-		if (t16 < min) min = t16;
-		if (t16 > max) max = t16;
-		*sptr++ = t16;
+	sys_bufP->lep_min_val = frameMin;
+	sys_bufP->lep_max_val = frameMax;
+#ifdef LEP_HISTOGRAM_BINS
+	if (sys_bufP->lep_histP != NULL) {
+		memcpy(sys_bufP->lep_histP, frameHist, sizeof(frameHist));
 	}
-	sys_bufP->lep_min_val = min;
-	sys_bufP->lep_max_val = max;
+	sys_bufP->lep_hist_base = histBase;
+	sys_bufP->lep_hist_shift = histShift;
+	
+	set_hist_range(frameMin, frameMax);
+#endif
 	
-	// Optionally load telemetry
 	sys_bufP->telem_valid = includeTelemetry;
-	if (includeTelemetry) {
-		sptr = sys_bufP->lep_telemP;
-		lptr = &lepTelem[0];
-		while (lptr < &lepTelem[LEP_TEL_WORDS]) {
-			*sptr++ = *lptr++;
-		}
-	}
 }
 
 
 /**
- * Configure the pipeline to include telemetry or not.
+ * Discard any partially read frame so the next frame starts with segment 1.  Called
+ * when VoSPI reading resumes after being stopped.  Returns true if a partially read
+ * new frame was discarded.
+ */
+bool vospi_resync()
+{
+	bool discarded = validSegmentRegion && !curFrameDup;
+	
+	curSegment = 1;
+	validSegmentRegion = false;
+	headerTelemValid = false;
+	
+	return discarded;
+}
+
+
+/**
+ * Configure the pipeline to include telemetry or not and where the Lepton has been
+ * configured to put it (header is true for a header, false for a footer).
  * This should be done during initialization
  */
-void vospi_include_telem(bool en)
+void vospi_include_telem(bool en, bool header)
 {
 	includeTelemetry = en;
+	telemetryHeader = header;
+	headerTelemValid = false;
+	telemFfcState = LEP_FFC_STATE_IDLE;
 	curLinesPerSeg = (en) ? LEP_TEL_PKTS_PER_SEG : LEP_NOTEL_PKTS_PER_SEG;
 	curWordsPerSeg = (en) ? LEP_TEL_WORDS_PER_SEG : LEP_NOTEL_WORDS_PER_SEG;
 }
 
 
+/**
+ * Return the number of duplicate frames discarded since boot
+ */
+uint32_t vospi_get_duplicate_count()
+{
+	return dupFrameCount;
+}
+
+
+/**
+ * Return the segment number (1-4) of a valid segment completed by the last call to
+ * vospi_transfer_segment() or 0 if none.  The segment's image data is located at
+ * pixel_offset for pixel_len pixels in the frame buffer.  telem_valid is set if the
+ * frame's telemetry has also been read (with the first segment for header telemetry
+ * and the last segment for footer telemetry).
+ */
+int vospi_get_completed_segment(int* pixel_offset, int* pixel_len, bool* telem_valid)
+{
+	int hdr_lines;
+	int start_line, end_line;
+	
+	if (completedSegment == 0) return 0;
+	
+	// Determine the range of image lines contained in this segment
+	hdr_lines = (includeTelemetry && telemetryHeader) ? LEP_TEL_LINES : 0;
+	start_line = ((completedSegment-1) * curLinesPerSeg) - hdr_lines;
+	end_line = (completedSegment * curLinesPerSeg) - hdr_lines;
+	if (start_line < 0) start_line = 0;
+	if (end_line > LEP_IMG_LINES) end_line = LEP_IMG_LINES;
+	
+	*pixel_offset = start_line * (LEP_WIDTH/2);
+	*pixel_len = (end_line - start_line) * (LEP_WIDTH/2);
+	*telem_valid = includeTelemetry && (completedSegment == (telemetryHeader ? 1 : 4));
+	
+	return completedSegment;
+}
+
+
+/**
+ * Copy the telemetry for the frame currently being read if it was sent as a header
+ * and has been read (segment 1 has been identified).  This allows processing that
+ * only depends on the telemetry (frame counter, FPA temperature, etc) to start
+ * before the rest of the frame has arrived.
+ *  - Returns true when the telemetry was copied, false otherwise
+ */
+bool vospi_get_header_telem(uint16_t* telemP)
+{
+	if (!headerTelemValid) return false;
+	
+	memcpy(telemP, lepTelemP, LEP_TEL_WORDS * sizeof(uint16_t));
+	return true;
+}
+
+
+/**
+ * Return true if the frame the segment completed by the last call to
+ * vospi_transfer_segment() is part of has been identified as a repeat of the previous
+ * frame.  Known from the first segment with header telemetry and only from the last
+ * segment otherwise.
+ */
+bool vospi_frame_duplicate()
+{
+	return curFrameDup;
+}
+
+
+/**
+ * Return the number of packet CRC errors seen while acquiring the most recent frame
+ * and since boot.  Always 0 when LEP_SPI_CHECK_CRC is not defined.
+ */
+void vospi_get_crc_errors(uint32_t* frame_errs, uint32_t* total_errs)
+{
+	*frame_errs = crcLastFrameErrors;
+	*total_errs = crcTotalErrors;
+}
+
+
+/**
+ * Return a copy of the VoSPI statistics.  Counts are updated by lep_task so a copy
+ * may be slightly inconsistent.
+ */
+void vospi_get_stats(vospi_stats_t* statsP)
+{
+	*statsP = stats;
+}
+
+
+/**
+ * Return true if the last call to vospi_transfer_segment() discarded a partially read
+ * frame (because of a segment sequence or packet CRC error).  Frames already known to
+ * be repeats of the previous frame are not included.
+ */
+bool vospi_frame_discarded()
+{
+	return frameDiscarded;
+}
+
+
+/**
+ * Return true while a frame is being read (its first segment has been read and the
+ * frame has not yet been completed or discarded)
+ */
+bool vospi_frame_in_progress()
+{
+	return validSegmentRegion;
+}
+
+
+/**
+ * Return true if a segment has arrived out of sequence (for example segment 3 following
+ * segment 1) since the last call.  This indicates a loss of synchronization with the
+ * Lepton's segment sequence that is detected within one frame instead of waiting for
+ * frames to stop arriving.  The partially read frame has already been discarded.
+ */
+bool vospi_sequence_lost()
+{
+	bool lost = sequenceLost;
+	
+	sequenceLost = false;
+	return lost;
+}
+
+
+/**
+ * Return the FFC state (LEP_FFC_STATE_xxx) from the most recently read telemetry.
+ * Always LEP_FFC_STATE_IDLE when telemetry is not included.
+ */
+uint32_t vospi_get_ffc_state()
+{
+	return telemFfcState;
+}
+
+
 
 //
 // VoSPI Forward Declarations for internal functions
@@ -259,32 +533,201 @@ void vospi_include_telem(bool en)
  */
 static bool transfer_packet(uint8_t* line, uint8_t* seg)
 {
-	bool valid = false;
 	esp_err_t ret;
 
-	// *seg will be set if possible
-	*seg = 0;
-
 	// Get a packet
 	ret = spi_device_polling_transmit(spi, &lep_spi_trans);
 	//ret = spi_device_transmit(spi, &lep_spi_trans);
 	ESP_ERROR_CHECK(ret);
   
-	// Repeat as long as the frame is not valid, equals sync
-	if ((*lepPacketP & 0x0F) == 0x0F) {
-		valid = false;
-	} else {
-		*line = *(lepPacketP + 1);
+	return parse_packet(lepPacketP, line, seg);
+}
+
+
+#ifdef LEP_SPI_SEG_DMA
+/**
+ * Queue DMA transactions to read one segment's worth of packets from the lepton
+ * into lepSegmentP and block (without spinning) until they have all completed.
+ *  - Returns the number of packets read
+ */
+static int transfer_segment_dma()
+{
+	int i, n;
+	spi_transaction_t* rtrans;
+	
+	// Queue a transaction for each packet in the segment
+	for (n=0; n<curLinesPerSeg; n++) {
+		if (spi_device_queue_trans(spi, &lep_seg_trans[n], 0) != ESP_OK) {
+			break;
+		}
+	}
+	
+	// Wait for all queued transactions to complete (the driver must be idle
+	// before any subsequent polled transactions)
+	for (i=0; i<n; i++) {
+		ESP_ERROR_CHECK(spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY));
+	}
+	
+	return n;
+}
+#endif
+
 
-		// Get segment when possible
-		if (*line == 20) {
-			*seg = (*lepPacketP >> 4);
+/**
+ * Decode the header of a packet
+ *  - Return false for discard packets
+ *  - Return true otherwise
+ *    - line contains the packet line number for all valid packets
+ *    - seg contains the packet segment number if the line number is 20
+ */
+static bool parse_packet(uint8_t* pktP, uint8_t* line, uint8_t* seg)
+{
+	// *seg will be set if possible
+	*seg = 0;
+	
+	// Discard packets are not valid
+	if ((*pktP & 0x0F) == 0x0F) {
+		return false;
+	}
+	
+	*line = *(pktP + 1);
+
+	// Get segment when possible
+	if (*line == 20) {
+		*seg = (*pktP >> 4);
+	}
+
+	return true;
+}
+
+
+/**
+ * Process a valid packet as part of the current segment
+ *  - Returns true when processing of the segment is done (either because it is
+ *    complete or because garbage data was seen), false otherwise
+ *  - Sets segmentSuccess when the last segment of a frame has been processed
+ */
+static bool process_packet(uint8_t* pktP, uint8_t line, uint8_t segment)
+{
+	bool done = false;
+	
+#ifdef LEP_SPI_CHECK_CRC
+	if (!packet_crc_valid(pktP)) {
+		// Discard the frame being assembled and resynchronize at the next segment 1
+		crcCurFrameErrors++;
+		crcTotalErrors++;
+		frameDiscarded = validSegmentRegion && !curFrameDup;
+		validSegmentRegion = false;
+		headerTelemValid = false;
+		curSegment = 1;
+		return true;
+	}
+#endif
+	
+	if (line == prevLine) {
+		// This is garbage data since line numbers should always increment
+		stats.read_errors[ROW_ERROR]++;
+		return true;
+	}
+	
+	// Check for termination or completion conditions
+	if (line == 20) {
+		// Check segment
+		if (!validSegmentRegion) {
+			// Look for start of valid segment data
+			if (segment == 1) {
+				beforeValidData = false;
+				validSegmentRegion = true;
+				// Header telemetry for this frame (segment 1 lines 0-2) has been read
+				headerTelemValid = includeTelemetry && telemetryHeader;
+				if (headerTelemValid) {
+					telemFfcState = lepton_get_tel_status(lepTelemP) & LEP_STATUS_FFC_STATE;
+				}
+			}
+		} else if ((segment < 2) || (segment > 4)) {
+			restart_frame(SEGMENT_INVALID);
+		} else if (segment != curSegment) {
+			// A segment of this frame was missed
+			restart_frame(SEGMENT_SEQUENCE);
 		}
+	}
 
-		valid = true;
+	// Copy the data to the lepton frame buffer or telemetry buffer
+	//  - beforeValidData is used to collect data before we know if the current segment (1) is valid
+	//  - then we use validSegmentRegion for remaining data once we know we're seeing valid data
+	if (beforeValidData || validSegmentRegion) {
+		if (includeTelemetry) {
+			if (telemetryHeader) {
+				if ((curSegment == 1) && (line < LEP_TEL_LINES)) {
+					copy_packet_to_telem_buffer(pktP, line);
+				} else if (line < curLinesPerSeg) {
+					copy_packet_to_lepton_buffer(pktP, line);
+				}
+			} else {
+				if ((curSegment == 4) && (line >= (curLinesPerSeg - LEP_TEL_LINES))) {
+					if (validSegmentRegion) {
+						copy_packet_to_telem_buffer(pktP, line - (curLinesPerSeg - LEP_TEL_LINES));
+					}
+				} else if (line < curLinesPerSeg) {
+					copy_packet_to_lepton_buffer(pktP, line);
+				}
+			}
+		} else if (line < curLinesPerSeg) {
+			copy_packet_to_lepton_buffer(pktP, line);
+		}
 	}
 
-	return(valid);
+	if (line == (curLinesPerSeg-1)) {
+		// Saw a complete segment, move to next segment or complete frame aquisition if possible
+		if (validSegmentRegion) {
+			stats.segments++;
+			merge_segment_stats(curSegment == 1);
+			
+			if (curSegment < 4) {
+				// Identify the frame as soon as its identification is available
+				if (curSegment == 1) {
+					curFrameDup = false;
+					if (includeTelemetry && telemetryHeader) {
+						identify_frame();
+					}
+				}
+				
+				// Setup to get next segment
+				completedSegment = curSegment;
+				curSegment++;
+			} else {
+				if (!(includeTelemetry && telemetryHeader)) {
+					if (includeTelemetry) {
+						telemFfcState = lepton_get_tel_status(lepTelemP) & LEP_STATUS_FFC_STATE;
+					}
+					identify_frame();
+				}
+				lastFrameId = curFrameId;
+				lastFrameIdValid = true;
+				
+				// Got frame (ignoring repeats of the previous frame).  A repeated frame
+				// still shows we are synchronized so its last segment is reported.
+				completedSegment = 4;
+				if (curFrameDup) {
+					dupFrameCount++;
+				} else {
+					segmentSuccess = true;
+					crcLastFrameErrors = crcCurFrameErrors;
+					crcCurFrameErrors = 0;
+				}
+
+				// Setup to get the next frame
+				curSegment = 1;
+				validSegmentRegion = false;
+				headerTelemValid = false;
+			}
+		}
+		done = true;
+	}
+	
+	prevLine = line;
+	
+	return done;
 }
 
 
@@ -292,17 +735,53 @@ static bool transfer_packet(uint8_t* line, uint8_t* seg)
  * Copy the lepton packet to the raw lepton frame
  *   - line specifies packet line number
  */
-static void copy_packet_to_lepton_buffer(uint8_t line)
+static void copy_packet_to_lepton_buffer(uint8_t* pktP, uint8_t line)
 {
-	uint8_t* lepPopPtr = lepPacketP + 4;
-	uint16_t* acqPushPtr = &lepBuffer[((curSegment-1) * curWordsPerSeg) + (line * (LEP_WIDTH/2))];
-	uint16_t t;
+	uint32_t* lepPopPtr = (uint32_t*) (pktP + 4);
+	uint32_t* lepEndPtr = (uint32_t*) (pktP + LEP_PKT_LENGTH);
+	uint32_t* acqPushPtr;
+	uint32_t t;
+	uint16_t p0, p1;
+	uint16_t min = segMin;
+	uint16_t max = segMax;
+	uint32_t hash = segHash;
+#ifdef LEP_HISTOGRAM_BINS
+	uint16_t base = histBase;
+	uint16_t top = LEP_HIST_TOP(histBase, histShift);
+	uint16_t shift = histShift;
+#endif
+	int offset;
+	
+	// Header telemetry lines precede the image in the frame
+	offset = ((curSegment-1) * curWordsPerSeg) + (line * (LEP_WIDTH/2));
+	if (includeTelemetry && telemetryHeader) {
+		offset -= LEP_TEL_LINES * (LEP_WIDTH/2);
+	}
+	acqPushPtr = (uint32_t*) (lepBufferP + offset);
 
-	while (lepPopPtr <= (lepPacketP + (LEP_PKT_LENGTH-1))) {
-		t = *lepPopPtr++ << 8;
-		t |= *lepPopPtr++;
+	// Byte-swap two big-endian pixels at a time, updating the segment statistics and
+	// hash (packet and buffer rows are both 32-bit aligned)
+	while (lepPopPtr < lepEndPtr) {
+		t = *lepPopPtr++;
+		t = ((t & 0x00FF00FF) << 8) | ((t >> 8) & 0x00FF00FF);
 		*acqPushPtr++ = t;
+		hash = (hash ^ t) * LEP_HASH_PRIME;
+		
+		p0 = t & 0xFFFF;
+		p1 = t >> 16;
+		if (p0 < min) min = p0;
+		if (p0 > max) max = p0;
+		if (p1 < min) min = p1;
+		if (p1 > max) max = p1;
+#ifdef LEP_HISTOGRAM_BINS
+		segHist[LEP_HIST_BIN(p0, base, top, shift)]++;
+		segHist[LEP_HIST_BIN(p1, base, top, shift)]++;
+#endif
 	}
+	
+	segMin = min;
+	segMax = max;
+	segHash = hash;
 }
 
 
@@ -310,19 +789,153 @@ static void copy_packet_to_lepton_buffer(uint8_t line)
  * Copy the lepton packet to the telemetry buffer
  *   - line specifies packet line number (only 0-2 are valid, do not call with line 3)
  */
-static void copy_packet_to_telem_buffer(uint8_t line)
+static void copy_packet_to_telem_buffer(uint8_t* pktP, uint8_t line)
 {
-	uint8_t* lepPopPtr = lepPacketP + 4;
-	uint16_t* telPushPtr = &lepTelem[line * (LEP_WIDTH/2)];
-	uint16_t t;
+	uint32_t* lepPopPtr = (uint32_t*) (pktP + 4);
+	uint32_t* lepEndPtr = (uint32_t*) (pktP + LEP_PKT_LENGTH);
+	uint32_t* telPushPtr = (uint32_t*) (lepTelemP + (line * (LEP_WIDTH/2)));
+	uint32_t t;
 	
 	if (line > 2) return;
 	
-	while (lepPopPtr <= (lepPacketP + (LEP_PKT_LENGTH-1))) {
-		t = *lepPopPtr++ << 8;
-		t |= *lepPopPtr++;
-		*telPushPtr++ = t;
+	while (lepPopPtr < lepEndPtr) {
+		t = *lepPopPtr++;
+		*telPushPtr++ = ((t & 0x00FF00FF) << 8) | ((t >> 8) & 0x00FF00FF);
+	}
+}
+
+
+/**
+ * Merge the statistics for a good segment into the statistics for the frame
+ *   - first is set for the first segment of a frame
+ */
+static void merge_segment_stats(bool first)
+{
+#ifdef LEP_HISTOGRAM_BINS
+	int i;
+#endif
+	
+	if (first) {
+		frameMin = segMin;
+		frameMax = segMax;
+		frameHash = segHash;
+#ifdef LEP_HISTOGRAM_BINS
+		memcpy(frameHist, segHist, sizeof(frameHist));
+#endif
+	} else {
+		if (segMin < frameMin) frameMin = segMin;
+		if (segMax > frameMax) frameMax = segMax;
+		frameHash = (frameHash ^ segHash) * LEP_HASH_PRIME;
+#ifdef LEP_HISTOGRAM_BINS
+		for (i=0; i<LEP_HISTOGRAM_BINS; i++) {
+			frameHist[i] += segHist[i];
+		}
+#endif
+	}
+}
+
+
+#ifdef LEP_HISTOGRAM_BINS
+/**
+ * Set the histogram range for the next frame from the range of a frame just read.  The
+ * range, plus a quarter for scene changes, is centered in the smallest power of 2 bin
+ * width that holds it.
+ */
+static void set_hist_range(uint16_t min, uint16_t max)
+{
+	uint32_t range;
+	uint32_t shift = 0;
+	int32_t base;
+	
+	range = (uint32_t) max - min + 1;
+	while ((((uint32_t) LEP_HISTOGRAM_BINS << shift) < (range + range/4)) && (shift < (16 - LEP_HISTOGRAM_BITS))) {
+		shift++;
+	}
+	
+	base = (int32_t) min - (int32_t) (((LEP_HISTOGRAM_BINS << shift) - range) / 2);
+	if (base < 0) base = 0;
+	if ((base + (LEP_HISTOGRAM_BINS << shift)) > 0x10000) base = 0x10000 - (LEP_HISTOGRAM_BINS << shift);
+	
+	histBase = (uint16_t) base;
+	histShift = (uint16_t) shift;
+}
+#endif
+
+
+/**
+ * Discard the frame being read because of a segment number error (reason) and hold
+ * in the starting position (always collecting in segment 1 buffer locations) until
+ * the next segment 1
+ */
+static void restart_frame(int reason)
+{
+	stats.read_errors[reason]++;
+	sequenceLost = true;
+	frameDiscarded = !curFrameDup;
+	validSegmentRegion = false;
+	curSegment = 1;
+	headerTelemValid = false;
+}
+
+
+/**
+ * Identify the frame being read and determine if it is a repeat of the last frame read
+ */
+static void identify_frame()
+{
+	if (includeTelemetry) {
+		curFrameId = ((uint32_t) lepTelemP[LEP_TEL_FC_HIGH] << 16) | lepTelemP[LEP_TEL_FC_LOW];
+	} else {
+		curFrameId = frameHash;
+	}
+	
+	curFrameDup = lastFrameIdValid && (curFrameId == lastFrameId);
+}
+
+
+#ifdef LEP_SPI_CHECK_CRC
+/**
+ * Compute the lookup table for a byte-wise CRC16 calculation
+ */
+static void init_crc16_table()
+{
+	int i, j;
+	uint16_t crc;
+	
+	for (i=0; i<256; i++) {
+		crc = i << 8;
+		for (j=0; j<8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ LEP_CRC16_POLY : (crc << 1);
+		}
+		crc16Table[i] = crc;
 	}
 }
 
 
+/**
+ * Check a packet's CRC.  The Lepton computes the CRC over the entire packet (starting
+ * with an initial value of 0) with the four TTT bits of the ID field and the CRC field
+ * set to zero.
+ */
+static bool packet_crc_valid(uint8_t* pktP)
+{
+	uint8_t* p = pktP + 4;
+	uint16_t crc = 0;
+	uint16_t pkt_crc = (*(pktP + 2) << 8) | *(pktP + 3);
+	
+	// ID field
+	crc = (crc << 8) ^ crc16Table[(crc >> 8) ^ (*pktP & 0x0F)];
+	crc = (crc << 8) ^ crc16Table[(crc >> 8) ^ *(pktP + 1)];
+	
+	// Zero'd CRC field
+	crc = (crc << 8) ^ crc16Table[crc >> 8];
+	crc = (crc << 8) ^ crc16Table[crc >> 8];
+	
+	// Payload
+	while (p < (pktP + LEP_PKT_LENGTH)) {
+		crc = (crc << 8) ^ crc16Table[(crc >> 8) ^ *p++];
+	}
+	
+	return (crc == pkt_crc);
+}
+#endif
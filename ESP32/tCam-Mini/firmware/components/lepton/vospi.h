@@ -2,8 +2,9 @@
  * Lepton VoSPI Module
  *
  * Contains the functions to get frames from a Lepton 3.5 via its SPI port.
- * Optionally supports collecting telemetry when enabled as a footer (does not
- * support telemetry enabled as a header). 
+ * Optionally supports collecting telemetry when enabled as either a header or
+ * a footer.  Header telemetry is available as soon as the first segment of a
+ * frame has been identified, before the image data has been read.
  *
  * Copyright 2020-2022 Dan Julio
  *
@@ -53,16 +54,60 @@
 #define LEP_TEL_PKT_LEN (LEP_PKT_LENGTH - 4)
 #define LEP_TEL_WORDS   (LEP_TEL_PACKETS * LEP_TEL_PKT_LEN / 2)
 
+// Number of packets (lines) in a frame taken by telemetry (only LEP_TEL_PACKETS are used)
+#define LEP_TEL_LINES   4
+
+// Number of image packets (lines) in a frame
+#define LEP_IMG_LINES   (LEP_NUM_PIXELS / (LEP_WIDTH/2))
+
 // Dynamic values depending if telemetry is included or not
 #define LEP_TEL_PKTS_PER_SEG     61
 #define LEP_NOTEL_PKTS_PER_SEG   60
 #define LEP_TEL_WORDS_PER_SEG    (LEP_TEL_PKTS_PER_SEG * LEP_WIDTH / 2)
 #define LEP_NOTEL_WORDS_PER_SEG  (LEP_NOTEL_PKTS_PER_SEG * LEP_WIDTH / 2)
 
+// CRC16 polynomial (x^16 + x^12 + x^5 + x^0)
+#define LEP_CRC16_POLY 0x1021
+
+// FNV-1a constants for the frame content hash used to detect duplicate frames
+#define LEP_HASH_OFFSET 0x811C9DC5
+#define LEP_HASH_PRIME  0x01000193
+
+// Frame histogram
+//   The histogram of each frame starts at a base pixel value with bins (1 << shift)
+//   pixel values wide, chosen from the previous frame's range.  Pixels outside the
+//   histogram are counted in the first or last bin.
+#ifdef LEP_HISTOGRAM_BINS
+#if LEP_HISTOGRAM_BINS == 64
+#define LEP_HISTOGRAM_BITS 6
+#elif LEP_HISTOGRAM_BINS == 128
+#define LEP_HISTOGRAM_BITS 7
+#elif LEP_HISTOGRAM_BINS == 256
+#define LEP_HISTOGRAM_BITS 8
+#elif LEP_HISTOGRAM_BINS == 512
+#define LEP_HISTOGRAM_BITS 9
+#elif LEP_HISTOGRAM_BINS == 1024
+#define LEP_HISTOGRAM_BITS 10
+#else
+#error "LEP_HISTOGRAM_BINS must be a power of 2 from 64 to 1024"
+#endif
+
+#define LEP_HIST_TOP(base, shift)         ((base) + (LEP_HISTOGRAM_BINS << (shift)) - 1)
+#define LEP_HIST_BIN(p, base, top, shift) (((((p) < (base)) ? (base) : (((p) > (top)) ? (top) : (p))) - (base)) >> (shift))
+#endif
+
 /* Lepton frame error return */
 enum LeptonReadError {
-  NONE, DISCARD, SEGMENT_ERROR, ROW_ERROR, SEGMENT_INVALID
+  NONE, DISCARD, SEGMENT_ERROR, ROW_ERROR, SEGMENT_INVALID, SEGMENT_SEQUENCE
 };
+#define LEP_NUM_READ_ERRORS (SEGMENT_SEQUENCE + 1)
+
+/* VoSPI statistics since boot */
+typedef struct {
+	uint32_t segments;                          // Valid segments read
+	uint32_t read_errors[LEP_NUM_READ_ERRORS];  // Indexed by LeptonReadError (NONE is unused)
+	sys_stage_time_t xfer;                      // Time spent in vospi_transfer_segment()
+} vospi_stats_t;
 
 
 
@@ -71,7 +116,19 @@ enum LeptonReadError {
 //
 int vospi_init(int csn_pin);
 bool vospi_transfer_segment(uint64_t vsyncDetectedUsec);
+void vospi_set_frame_buffer(lep_buffer_t* sys_bufP);
 void vospi_get_frame(lep_buffer_t* sys_bufP);
-void vospi_include_telem(bool en);
+bool vospi_resync();
+void vospi_include_telem(bool en, bool header);
+bool vospi_get_header_telem(uint16_t* telemP);
+void vospi_get_crc_errors(uint32_t* frame_errs, uint32_t* total_errs);
+uint32_t vospi_get_duplicate_count();
+void vospi_get_stats(vospi_stats_t* statsP);
+bool vospi_sequence_lost();
+bool vospi_frame_in_progress();
+bool vospi_frame_discarded();
+uint32_t vospi_get_ffc_state();
+int vospi_get_completed_segment(int* pixel_offset, int* pixel_len, bool* telem_valid);
+bool vospi_frame_duplicate();
 
 #endif /* VOSPI_H */
@@ -0,0 +1,360 @@
+/*
+ * Burst capture utilities
+ *
+ * Maintains a ring of the most recent Lepton frames (image and telemetry) in PSRAM
+ * that can be frozen around a trigger event and then read out at whatever rate the
+ * host link allows.
+ *
+ * lep_task adds every frame it publishes while the ring is armed or triggered.  Other
+ * tasks change the state with single atomic operations so the acquisition path never
+ * waits.  Only lep_task writes the ring and its indices (it resets them when it sees
+ * an arm request) and the ring is only read once lep_task has frozen it.
+ *
+ * The ring is allocated when a capture is armed and freed by rsp_task (the only task
+ * that reads it) after the capture is turned off so the PSRAM is only used while a
+ * capture is in progress.  lep_task marks when it is using the ring so it is not freed
+ * out from under a frame being added.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "burst_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "vospi.h"
+#include <string.h>
+
+
+
+//
+// Burst Utilities variables
+//
+static const char* TAG = "burst_utilities";
+
+static const char* burst_state_names[] = {"off", "armed", "armed", "triggered", "frozen"};
+
+// Frame ring (buffers allocated while a capture is in progress)
+static lep_buffer_t burst_frame[BURST_NUM_FRAMES];
+static bool burst_allocated = false;
+
+// Serializes allocating and freeing the ring (never taken by lep_task)
+static SemaphoreHandle_t burst_mutex;
+
+// Set by lep_task while it may be adding a frame to the ring
+static volatile bool burst_adding = false;
+
+// State (written by any task, see above)
+static volatile int burst_state = BURST_STATE_OFF;
+static volatile int burst_post_frames;              // Set before arming
+static volatile int64_t burst_trigger_usec;         // Set before triggering
+
+// Ring indices (only written by lep_task)
+static int burst_push_index;      // Next slot to write
+static int burst_count;           // Number of valid frames
+static int burst_post_remaining;  // Frames still to add after the trigger
+static int burst_trigger_index;   // Slot holding the first frame added after the trigger
+
+
+
+//
+// Burst Utilities Forward Declarations for internal functions
+//
+static bool burst_alloc();
+static void burst_free();
+static void burst_add(lep_buffer_t* lep_bufP);
+
+
+
+//
+// Burst Utilities API
+//
+
+/**
+ * Initialize the module (the ring is allocated when a capture is armed)
+ */
+bool burst_init()
+{
+	burst_mutex = xSemaphoreCreateMutex();
+	if (burst_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create burst mutex");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Start capturing frames into an empty ring, allocating the ring if necessary.  When
+ * triggered, post_frames more frames are captured before the ring is frozen.  Restarts
+ * a capture in any state.  Returns false if the ring could not be allocated.
+ */
+bool burst_arm(int post_frames)
+{
+	bool success;
+	
+	if (post_frames < 0) post_frames = 0;
+	if (post_frames > (BURST_NUM_FRAMES - 1)) post_frames = BURST_NUM_FRAMES - 1;
+	
+	xSemaphoreTake(burst_mutex, portMAX_DELAY);
+	success = burst_alloc();
+	if (success) {
+		burst_post_frames = post_frames;
+		__atomic_store_n(&burst_state, BURST_STATE_ARM_REQ, __ATOMIC_SEQ_CST);
+	}
+	xSemaphoreGive(burst_mutex);
+	
+	return success;
+}
+
+
+/**
+ * Trigger an armed capture.  Returns false if a capture was not armed.
+ */
+bool burst_trigger()
+{
+	int expected = BURST_STATE_ARMED;
+	
+	if (burst_get_state() != BURST_STATE_ARMED) {
+		return false;
+	}
+	
+	burst_trigger_usec = esp_timer_get_time();
+	return __atomic_compare_exchange_n(&burst_state, &expected, BURST_STATE_TRIGGERED,
+	                                   false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * Stop capturing and discard the ring contents (the ring is freed by the next call to
+ * burst_release)
+ */
+void burst_off()
+{
+	__atomic_store_n(&burst_state, BURST_STATE_OFF, __ATOMIC_SEQ_CST);
+}
+
+
+/**
+ * Called periodically by rsp_task to free the ring once the capture has been turned off
+ */
+void burst_release()
+{
+	if (!burst_allocated || (burst_get_state() != BURST_STATE_OFF)) {
+		return;
+	}
+	
+	xSemaphoreTake(burst_mutex, portMAX_DELAY);
+	if (burst_allocated && (__atomic_load_n(&burst_state, __ATOMIC_SEQ_CST) == BURST_STATE_OFF)) {
+		// lep_task sees the off state from now on so wait for any frame it is adding
+		while (__atomic_load_n(&burst_adding, __ATOMIC_SEQ_CST)) {
+			vTaskDelay(1);
+		}
+		burst_free();
+	}
+	xSemaphoreGive(burst_mutex);
+}
+
+
+int burst_get_state()
+{
+	return __atomic_load_n(&burst_state, __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * Returns true while frames are being added to the ring
+ */
+bool burst_capturing()
+{
+	int state = burst_get_state();
+	
+	return ((state != BURST_STATE_OFF) && (state != BURST_STATE_FROZEN));
+}
+
+
+/**
+ * Called by lep_task with each frame it publishes (before filtering and publishing it)
+ */
+void burst_add_frame(lep_buffer_t* lep_bufP)
+{
+	// Mark the ring in use before looking at the state so burst_release() can't free it
+	__atomic_store_n(&burst_adding, true, __ATOMIC_SEQ_CST);
+	burst_add(lep_bufP);
+	__atomic_store_n(&burst_adding, false, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Return the number of frames in a frozen ring
+ */
+int burst_get_frame_count()
+{
+	return (burst_get_state() == BURST_STATE_FROZEN) ? burst_count : 0;
+}
+
+
+/**
+ * Return the index (0 = oldest) of the first frame captured after the trigger in a frozen ring
+ */
+int burst_get_trigger_index()
+{
+	return (burst_trigger_index - burst_push_index + burst_count + BURST_NUM_FRAMES) % BURST_NUM_FRAMES;
+}
+
+
+/**
+ * Return a frame from a frozen ring (index 0 is the oldest frame) and the time it was
+ * captured relative to the trigger in msec.  Returns NULL if the ring is not frozen
+ * or the index is out of range.
+ */
+lep_buffer_t* burst_get_frame(int index, int32_t* msec)
+{
+	int i;
+	
+	if ((index < 0) || (index >= burst_get_frame_count())) {
+		return NULL;
+	}
+	
+	i = (burst_push_index - burst_count + index + BURST_NUM_FRAMES) % BURST_NUM_FRAMES;
+	*msec = (int32_t) ((burst_frame[i].acq_usec - burst_trigger_usec) / 1000);
+	
+	return &burst_frame[i];
+}
+
+
+/**
+ * Return a text description of the current state
+ */
+const char* burst_get_state_name()
+{
+	return burst_state_names[burst_get_state()];
+}
+
+
+
+//
+// Burst Utilities internal functions
+//
+
+/**
+ * Allocate the frame ring in the external RAM if it is not already allocated
+ */
+static bool burst_alloc()
+{
+	int i;
+	
+	if (burst_allocated) return true;
+	
+	for (i=0; i<BURST_NUM_FRAMES; i++) {
+		burst_frame[i].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+		burst_frame[i].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+#ifdef LEP_HISTOGRAM_BINS
+		burst_frame[i].lep_histP = NULL;
+#endif
+		if ((burst_frame[i].lep_bufferP == NULL) || (burst_frame[i].lep_telemP == NULL)) {
+			ESP_LOGE(TAG, "malloc burst frame buffer %d failed", i);
+			burst_allocated = true;
+			burst_free();
+			return false;
+		}
+	}
+	
+	burst_allocated = true;
+	return true;
+}
+
+
+/**
+ * Free the frame ring
+ */
+static void burst_free()
+{
+	int i;
+	
+	for (i=0; i<BURST_NUM_FRAMES; i++) {
+		heap_caps_free(burst_frame[i].lep_bufferP);
+		heap_caps_free(burst_frame[i].lep_telemP);
+		burst_frame[i].lep_bufferP = NULL;
+		burst_frame[i].lep_telemP = NULL;
+	}
+	
+	burst_allocated = false;
+}
+
+
+/**
+ * Add a frame to the ring if a capture is in progress
+ */
+static void burst_add(lep_buffer_t* lep_bufP)
+{
+	int state;
+	int expected;
+	lep_buffer_t* dstP;
+	
+	state = __atomic_load_n(&burst_state, __ATOMIC_SEQ_CST);
+	
+	if (state == BURST_STATE_ARM_REQ) {
+		// Start with an empty ring
+		burst_push_index = 0;
+		burst_count = 0;
+		burst_post_remaining = burst_post_frames;
+		expected = BURST_STATE_ARM_REQ;
+		if (!__atomic_compare_exchange_n(&burst_state, &expected, BURST_STATE_ARMED,
+		                                 false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			// Turned off or re-armed in the meantime
+			return;
+		}
+		state = BURST_STATE_ARMED;
+	}
+	
+	if ((state != BURST_STATE_ARMED) && (state != BURST_STATE_TRIGGERED)) {
+		return;
+	}
+	
+	// Copy the frame into the next slot, overwriting the oldest frame when full
+	dstP = &burst_frame[burst_push_index];
+	memcpy(dstP->lep_bufferP, lep_bufP->lep_bufferP, LEP_NUM_PIXELS*2);
+	memcpy(dstP->lep_telemP, lep_bufP->lep_telemP, LEP_TEL_WORDS*2);
+	dstP->frame_num = lep_bufP->frame_num;
+	dstP->acq_usec = lep_bufP->acq_usec;
+	dstP->telem_valid = lep_bufP->telem_valid;
+	dstP->lep_min_val = lep_bufP->lep_min_val;
+	dstP->lep_max_val = lep_bufP->lep_max_val;
+	
+	if (state == BURST_STATE_TRIGGERED) {
+		if (burst_post_remaining == burst_post_frames) {
+			burst_trigger_index = burst_push_index;
+		}
+		if (burst_post_remaining-- == 0) {
+			// Last frame (the trigger frame itself when post_frames is 0).  Freeze unless
+			// the capture was stopped or restarted while we were copying.
+			expected = BURST_STATE_TRIGGERED;
+			(void) __atomic_compare_exchange_n(&burst_state, &expected, BURST_STATE_FROZEN,
+			                                   false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+		}
+	}
+	
+	if (++burst_push_index == BURST_NUM_FRAMES) burst_push_index = 0;
+	if (burst_count < BURST_NUM_FRAMES) burst_count++;
+}
@@ -0,0 +1,63 @@
+/*
+ * Burst capture utilities
+ *
+ * Maintains a ring of the most recent Lepton frames (image and telemetry) in PSRAM
+ * that can be frozen around a trigger event and then read out at whatever rate the
+ * host link allows.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef BURST_UTILITIES_H
+#define BURST_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Burst Utilities constants
+//
+
+// Burst capture state
+#define BURST_STATE_OFF       0
+#define BURST_STATE_ARM_REQ   1
+#define BURST_STATE_ARMED     2
+#define BURST_STATE_TRIGGERED 3
+#define BURST_STATE_FROZEN    4
+
+
+
+//
+// Burst Utilities API
+//
+bool burst_init();
+bool burst_arm(int post_frames);
+bool burst_trigger();
+void burst_off();
+void burst_release();
+int burst_get_state();
+bool burst_capturing();
+void burst_add_frame(lep_buffer_t* lep_bufP);
+int burst_get_frame_count();
+int burst_get_trigger_index();
+lep_buffer_t* burst_get_frame(int index, int32_t* msec);
+const char* burst_get_state_name();
+
+#endif /* BURST_UTILITIES_H */
@@ -22,10 +22,12 @@
  * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
  *
  */
+#include "burst_utilities.h"
 #include "ctrl_task.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -47,6 +49,13 @@
 //
 #define SPI_SLAVE_TIMEOUT_MSEC 1000
 
+// Frame ring indices are free-running 31-bit counts.  The tail index is stored shifted
+// up one bit with a flag indicating rsp_task is reading the slot it points to.
+#define LEP_RING_INDEX_MASK    0x7FFFFFFF
+#define LEP_RING_BUSY_FLAG     0x1
+
+#define LEP_RING_SLOT(i)       ((i) & (SYS_LEP_NUM_BUFFERS - 1))
+
 
 
 //
@@ -78,7 +87,21 @@ json_config_t lep_st;
 //
 
 // Shared memory data structures
-lep_buffer_t rsp_lep_buffer[2];   // Ping-pong buffer loaded by lep_task for rsp_task
+//   Single-producer/single-consumer ring of frames loaded by lep_task for rsp_task.
+//   lep_task assembles a frame directly in the slot at the head index and publishes
+//   it by advancing head.  rsp_task reads the slots from tail up to head.  The slot
+//   at head is never readable so the ring holds at most SYS_LEP_NUM_BUFFERS-1 frames.
+//   When it is full, lep_task either discards the oldest frame by advancing tail
+//   (unless rsp_task is reading it) or discards the new frame by not advancing head.
+static lep_buffer_t lep_frame_buffer[SYS_LEP_NUM_BUFFERS];
+static volatile uint32_t lep_ring_head = 0;            // Written only by lep_task
+static volatile uint32_t lep_ring_tail = 0;            // (Index << 1) | LEP_RING_BUSY_FLAG
+static volatile uint32_t lep_ring_overflow_count = 0;  // Frames discarded because the ring was full
+
+//   Segment buffers loaded by lep_task as each segment is read when rsp_task is
+//   streaming segments.  Each is protected by a sequence count that rsp_task checks
+//   before and after reading it.
+static lep_segment_buffer_t lep_segment_buffer[SYS_LEP_NUM_SEGMENTS];
 
 // Big buffers
 char* rx_circular_buffer;                          // Used by cmd_utilities for incoming json data
@@ -223,37 +246,46 @@ bool system_buffer_init()
 {
 	ESP_LOGI(TAG, "Buffer Allocation");
 	
-	// Allocate the LEP/RSP task lepton frame and telemetry ping-pong buffers
-	rsp_lep_buffer[0].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
-	if (rsp_lep_buffer[0].lep_bufferP == NULL) {
-		ESP_LOGE(TAG, "malloc RSP lepton shared image buffer 0 failed");
-		return false;
-	}
-	rsp_lep_buffer[0].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
-	if (rsp_lep_buffer[0].lep_telemP == NULL) {
-		ESP_LOGE(TAG, "malloc RSP lepton shared telemetry buffer 0 failed");
-		return false;
-	}
-	rsp_lep_buffer[1].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
-	if (rsp_lep_buffer[1].lep_bufferP == NULL) {
-		ESP_LOGE(TAG, "malloc RSP lepton shared image buffer 1 failed");
-		return false;
-	}
-	rsp_lep_buffer[1].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
-	if (rsp_lep_buffer[1].lep_telemP == NULL) {
-		ESP_LOGE(TAG, "malloc RSP lepton shared telemetry buffer 1 failed");
-		return false;
+	// Allocate the LEP/RSP task lepton frame and telemetry buffers
+	for (int i=0; i<SYS_LEP_NUM_BUFFERS; i++) {
+		lep_frame_buffer[i].telem_valid = false;
+		lep_frame_buffer[i].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+		if (lep_frame_buffer[i].lep_bufferP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton shared image buffer %d failed", i);
+			return false;
+		}
+		lep_frame_buffer[i].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+		if (lep_frame_buffer[i].lep_telemP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton shared telemetry buffer %d failed", i);
+			return false;
+		}
+#ifdef LEP_HISTOGRAM_BINS
+		lep_frame_buffer[i].lep_histP = heap_caps_malloc(LEP_HISTOGRAM_BINS*2, MALLOC_CAP_SPIRAM);
+		if (lep_frame_buffer[i].lep_histP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton shared histogram buffer %d failed", i);
+			return false;
+		}
+#endif
 	}
 	
-	// Create the ping-pong buffer access mutexes
-	rsp_lep_buffer[0].lep_mutex = xSemaphoreCreateMutex();
-	if (rsp_lep_buffer[0].lep_mutex == NULL) {
-		ESP_LOGE(TAG, "create RSP lepton mutex 0 failed");
-		return false;
+	// Allocate the LEP/RSP task lepton segment buffers
+	for (int i=0; i<SYS_LEP_NUM_SEGMENTS; i++) {
+		lep_segment_buffer[i].seq = 0;
+		lep_segment_buffer[i].lep_bufferP = heap_caps_malloc(SYS_LEP_MAX_SEG_PIXELS*2, MALLOC_CAP_SPIRAM);
+		if (lep_segment_buffer[i].lep_bufferP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton shared segment buffer %d failed", i);
+			return false;
+		}
+		lep_segment_buffer[i].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+		if (lep_segment_buffer[i].lep_telemP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton shared segment telemetry buffer %d failed", i);
+			return false;
+		}
 	}
-	rsp_lep_buffer[1].lep_mutex = xSemaphoreCreateMutex();
-	if (rsp_lep_buffer[1].lep_mutex == NULL) {
-		ESP_LOGE(TAG, "create RSP lepton mutex 1 failed");
+	
+	// Burst capture (its ring is allocated when a capture is started)
+	if (!burst_init()) {
+		ESP_LOGE(TAG, "burst capture initialization failed");
 		return false;
 	}
 	
@@ -352,6 +384,189 @@ bool system_spi_wait_done()
 }
 
 
+/**
+ * Return the frame buffer currently owned by lep_task
+ */
+lep_buffer_t* system_lep_frame_producer_buffer()
+{
+	return &lep_frame_buffer[LEP_RING_SLOT(lep_ring_head)];
+}
+
+
+/**
+ * Called by lep_task to publish the frame in its buffer.  Returns the buffer lep_task
+ * should fill next (the same buffer if the frame was discarded because the ring was full).
+ * Never blocks.
+ */
+lep_buffer_t* system_lep_frame_publish()
+{
+	uint32_t head = lep_ring_head;
+	uint32_t tail_word;
+	
+	tail_word = __atomic_load_n(&lep_ring_tail, __ATOMIC_ACQUIRE);
+	while (((head + 1 - (tail_word >> 1)) & LEP_RING_INDEX_MASK) >= SYS_LEP_NUM_BUFFERS) {
+		// Ring is full: the next slot to fill holds the oldest unread frame
+#ifndef LEP_FRAME_RING_DROP_NEWEST
+		if ((tail_word & LEP_RING_BUSY_FLAG) == 0) {
+			// Discard the oldest frame.  This fails (and we re-evaluate) if rsp_task
+			// changed tail since we read it.
+			if (__atomic_compare_exchange_n(&lep_ring_tail, &tail_word,
+			                                (((tail_word >> 1) + 1) & LEP_RING_INDEX_MASK) << 1,
+			                                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				__atomic_add_fetch(&lep_ring_overflow_count, 1, __ATOMIC_RELAXED);
+				break;
+			}
+			continue;
+		}
+		// rsp_task is reading the oldest frame so discard this one instead
+#endif
+		__atomic_add_fetch(&lep_ring_overflow_count, 1, __ATOMIC_RELAXED);
+		return &lep_frame_buffer[LEP_RING_SLOT(head)];
+	}
+	
+	head = (head + 1) & LEP_RING_INDEX_MASK;
+	__atomic_store_n(&lep_ring_head, head, __ATOMIC_RELEASE);
+	
+	return &lep_frame_buffer[LEP_RING_SLOT(head)];
+}
+
+
+/**
+ * Called by rsp_task to take ownership of a published frame.  Returns the oldest
+ * unread frame, or the newest (discarding older frames) if latest is set.  Returns
+ * NULL if there are no unread frames.  The buffer remains owned by rsp_task until
+ * it calls system_lep_frame_release().
+ */
+lep_buffer_t* system_lep_frame_consume(bool latest)
+{
+	uint32_t head, tail, tail_word, new_tail_word;
+	
+	tail_word = __atomic_load_n(&lep_ring_tail, __ATOMIC_ACQUIRE);
+	do {
+		tail = tail_word >> 1;
+		head = __atomic_load_n(&lep_ring_head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			return NULL;
+		}
+		
+		if (latest) {
+			tail = (head - 1) & LEP_RING_INDEX_MASK;
+		}
+		new_tail_word = (tail << 1) | LEP_RING_BUSY_FLAG;
+		
+		// Fails (updating tail_word) if lep_task discarded the oldest frame in the meantime
+	} while (!__atomic_compare_exchange_n(&lep_ring_tail, &tail_word, new_tail_word,
+	                                      false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	
+	return &lep_frame_buffer[LEP_RING_SLOT(tail)];
+}
+
+
+/**
+ * Called by rsp_task when it is done with the frame returned by system_lep_frame_consume()
+ */
+void system_lep_frame_release()
+{
+	uint32_t tail_word;
+	
+	// lep_task does not modify tail while the busy flag is set
+	tail_word = __atomic_load_n(&lep_ring_tail, __ATOMIC_ACQUIRE);
+	if ((tail_word & LEP_RING_BUSY_FLAG) != 0) {
+		__atomic_store_n(&lep_ring_tail, (((tail_word >> 1) + 1) & LEP_RING_INDEX_MASK) << 1, __ATOMIC_RELEASE);
+	}
+}
+
+
+/**
+ * Called by rsp_task (when it does not own a frame) to discard unread frames.  The
+ * most recent frame is kept if keep_newest is set.
+ */
+void system_lep_frame_flush(bool keep_newest)
+{
+	uint32_t head, tail_word;
+	
+	tail_word = __atomic_load_n(&lep_ring_tail, __ATOMIC_ACQUIRE);
+	do {
+		head = __atomic_load_n(&lep_ring_head, __ATOMIC_ACQUIRE);
+		if (keep_newest) {
+			if (((head - (tail_word >> 1)) & LEP_RING_INDEX_MASK) <= 1) {
+				return;
+			}
+			head = (head - 1) & LEP_RING_INDEX_MASK;
+		}
+	} while (!__atomic_compare_exchange_n(&lep_ring_tail, &tail_word, head << 1,
+	                                      false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+
+/**
+ * Return the number of frames discarded because rsp_task fell too far behind
+ */
+uint32_t system_lep_frame_overflow_count()
+{
+	return __atomic_load_n(&lep_ring_overflow_count, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Called by lep_task to copy a segment (1-4) from the frame it is reading in srcP
+ * to the associated segment buffer.  The frame_num in srcP must be set to the number
+ * the frame will have when it is published.  frame_id identifies the frame being read
+ * (it changes with each attempt to read a frame).
+ */
+void system_lep_segment_publish(int seg, uint32_t frame_id, lep_buffer_t* srcP, int pixel_offset, int pixel_len, bool telem_valid)
+{
+	lep_segment_buffer_t* segP = &lep_segment_buffer[seg-1];
+	
+	__atomic_add_fetch(&segP->seq, 1, __ATOMIC_ACQ_REL);
+	
+	segP->frame_id = frame_id;
+	segP->frame_num = srcP->frame_num;
+	segP->pixel_offset = pixel_offset;
+	segP->pixel_len = pixel_len;
+	memcpy(segP->lep_bufferP, srcP->lep_bufferP + pixel_offset, pixel_len*2);
+	segP->telem_valid = telem_valid;
+	if (telem_valid) {
+		memcpy(segP->lep_telemP, srcP->lep_telemP, LEP_TEL_WORDS*2);
+	}
+	segP->dropped = false;
+	
+	__atomic_add_fetch(&segP->seq, 1, __ATOMIC_ACQ_REL);
+}
+
+
+/**
+ * Called by lep_task to mark the frame identified by frame_id (with sequence number
+ * frame_num) as dropped in the buffer for segment seg (2-4) when the frame is discarded
+ * after its earlier segments were published.
+ */
+void system_lep_segment_drop(int seg, uint32_t frame_id, uint32_t frame_num)
+{
+	lep_segment_buffer_t* segP = &lep_segment_buffer[seg-1];
+	
+	__atomic_add_fetch(&segP->seq, 1, __ATOMIC_ACQ_REL);
+	
+	segP->frame_id = frame_id;
+	segP->frame_num = frame_num;
+	segP->pixel_offset = 0;
+	segP->pixel_len = 0;
+	segP->telem_valid = false;
+	segP->dropped = true;
+	
+	__atomic_add_fetch(&segP->seq, 1, __ATOMIC_ACQ_REL);
+}
+
+
+/**
+ * Return the segment buffer for segment 1-4.  The caller should read seq before and
+ * after using the contents and discard them if seq was odd or changed.
+ */
+lep_segment_buffer_t* system_lep_segment_buffer(int seg)
+{
+	return &lep_segment_buffer[seg-1];
+}
+
+
 
 //
 // Internal functions
@@ -391,3 +606,19 @@ static void IRAM_ATTR _sys_spi_slave_post_trans_cb()
 {
 	spi_slave_busy = false;
 }
+
+
+/**
+ * Account for one run of a pipeline stage that started at start_usec (esp_timer time)
+ * and ended now
+ */
+void system_stage_time_add(sys_stage_time_t* stP, int64_t start_usec)
+{
+	uint32_t t;
+	
+	t = (uint32_t) (esp_timer_get_time() - start_usec);
+	stP->count++;
+	stP->last_usec = t;
+	stP->total_usec += t;
+	if (t > stP->max_usec) stP->max_usec = t;
+}
@@ -42,20 +42,56 @@
 #define SYS_GAIN_LOW  1
 #define SYS_GAIN_AUTO 2
 
+// Number of lepton frame buffers in the ring between lep_task and rsp_task
+#define SYS_LEP_NUM_BUFFERS LEP_FRAME_RING_SLOTS
+
+#if (SYS_LEP_NUM_BUFFERS < 2) || ((SYS_LEP_NUM_BUFFERS & (SYS_LEP_NUM_BUFFERS - 1)) != 0)
+#error "LEP_FRAME_RING_SLOTS must be a power of 2 greater than 1"
+#endif
+
+// Number of lepton segments per frame and maximum segment image length (pixels)
+#define SYS_LEP_NUM_SEGMENTS    4
+#define SYS_LEP_MAX_SEG_PIXELS  (61 * 80)
+
 
 
 //
 // System Utilities typedefs
 //
 typedef struct {
+	uint32_t count;              // Number of times the stage ran
+	uint32_t last_usec;          // Duration of the most recent run
+	uint32_t max_usec;
+	uint64_t total_usec;
+} sys_stage_time_t;
+
+typedef struct {
+	uint32_t frame_num;          // Sequence number assigned by lep_task when published
+	int64_t acq_usec;            // esp_timer time of the VSYNC for the frame's last segment
 	bool telem_valid;
 	uint16_t lep_min_val;
 	uint16_t lep_max_val;
 	uint16_t* lep_bufferP;
 	uint16_t* lep_telemP;
-	SemaphoreHandle_t lep_mutex;
+#ifdef LEP_HISTOGRAM_BINS
+	uint16_t* lep_histP;         // LEP_HISTOGRAM_BINS counts (NULL if the frame has no histogram)
+	uint16_t lep_hist_base;      // Pixel value at the start of the first bin
+	uint16_t lep_hist_shift;     // Bins are (1 << lep_hist_shift) pixel values wide
+#endif
 } lep_buffer_t;
 
+typedef struct {
+	volatile uint32_t seq;       // Incremented before and after an update (odd while updating)
+	uint32_t frame_id;           // Identifies the frame read the segment is part of (changes with each attempt)
+	uint32_t frame_num;          // Sequence number the frame has if it is published
+	int pixel_offset;            // Location of the first pixel in the frame
+	int pixel_len;               // Number of pixels in the segment
+	bool telem_valid;            // Set when lep_telemP contains the frame's telemetry
+	bool dropped;                // Set when the frame was dropped before this segment (no data)
+	uint16_t* lep_bufferP;       // SYS_LEP_MAX_SEG_PIXELS words
+	uint16_t* lep_telemP;
+} lep_segment_buffer_t;
+
 typedef struct {
 	uint32_t length;
 	char* bufferP;
@@ -69,6 +105,28 @@ typedef struct {
 	SemaphoreHandle_t mutex;
 } json_cmd_response_queue_t;
 
+typedef struct {
+	uint32_t delay_ms;           // mSec between images; 0 = fast as possible
+	uint32_t num_frames;         // Number of frames to stream; 0 = infinite
+	bool segments;               // Set to stream each segment of a frame as it is read
+	bool roi;                    // Set to stream region statistics instead of images
+	bool agc;                    // Set to stream 8-bit AGC previews instead of radiometric images
+	int decimate;                // Image decimation factor (1, 2 or 4)
+	int decimate_mode;           // How pixels are combined when decimating (DECIMATE_MODE_xxx)
+	bool crop;                   // Set to stream the crop rectangle instead of the entire image
+	uint16_t crop_r1;            // Crop rectangle (inclusive)
+	uint16_t crop_c1;
+	uint16_t crop_r2;
+	uint16_t crop_c2;
+	bool isotherm;               // Set to stream the isotherm mask instead of images
+	int32_t isotherm_lo;         // Isotherm band (°C x 100, inclusive)
+	int32_t isotherm_hi;
+	int change_threshold;        // Only send changed images (counts a pixel must change); 0 = send all
+	int change_pixels;           // Number of pixels that must change
+	uint32_t heartbeat_sec;      // Maximum time between images when nothing changes; 0 = none
+	bool binary;                 // Set to send images as binary responses instead of json
+} json_stream_on_t;
+
 typedef struct {
 	bool agc_set_enabled;        // Set when agc_enabled
 	int emissivity;              // Integer percent 1 - 100
@@ -106,9 +164,6 @@ extern json_config_t lep_st;
 // Global buffer pointers for allocated memory
 //
 
-// Shared memory data structures
-extern lep_buffer_t rsp_lep_buffer[2];   // Ping-pong buffer loaded by lep_task for rsp_task
-
 // Big buffers
 extern char* rx_circular_buffer;                          // Used by cmd_utilities for incoming json data
 extern char* json_cmd_string;                             // Used by cmd_utilities to hold a parsed incoming json command
@@ -129,6 +184,16 @@ bool system_buffer_init();
 bool system_config_spi_slave(char* buf, int len);
 bool system_spi_slave_busy();
 bool system_spi_wait_done();
+lep_buffer_t* system_lep_frame_producer_buffer();
+lep_buffer_t* system_lep_frame_publish();
+lep_buffer_t* system_lep_frame_consume(bool latest);
+void system_lep_frame_release();
+void system_lep_frame_flush(bool keep_newest);
+uint32_t system_lep_frame_overflow_count();
+void system_lep_segment_publish(int seg, uint32_t frame_id, lep_buffer_t* srcP, int pixel_offset, int pixel_len, bool telem_valid);
+void system_lep_segment_drop(int seg, uint32_t frame_id, uint32_t frame_num);
+lep_segment_buffer_t* system_lep_segment_buffer(int seg);
+void system_stage_time_add(sys_stage_time_t* stP, int64_t start_usec);
 
 #define system_get_lep_st()   (&lep_st)
  
@@ -0,0 +1,240 @@
+/*
+ * Host shim: I2C driver with a simulated Lepton CCI
+ *
+ * Implements the i2c.h API for the Lepton's CCI register interface.  SET commands store
+ * their data words by command base and GET commands return them so lepton_init()'s read
+ * back checks succeed.  RUN commands do nothing.  The Lepton is always booted and idle
+ * and reports the part number of a radiometric Lepton 3.5.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <pthread.h>
+#include <string.h>
+#include "i2c.h"
+#include "cci.h"
+
+
+
+//
+// CCI Emulator constants
+//
+#define CCI_REG_WORDS     ((CCI_REG_DATA_15 / 2) + 1)
+#define CCI_BLOCK_WORDS   512
+#define CCI_MAX_ATTRS     32
+
+#define CCI_CMD_TYPE_MASK 0x0003
+#define CCI_CMD_TYPE_GET  0x0000
+#define CCI_CMD_TYPE_SET  0x0001
+
+// STATUS register: booted, boot mode (bits 2:1) and not busy (bit 0) with LEP_OK (0) result
+#define CCI_STATUS_READY  0x0006
+
+#define CCI_PART_NUMBER   "500-0771-01"
+
+
+
+//
+// CCI Emulator typedefs
+//
+typedef struct {
+	uint16_t base;               // Command with the type bits cleared
+	uint16_t len;
+	uint16_t data[CCI_BLOCK_WORDS];
+} cci_attr_t;
+
+
+
+//
+// CCI Emulator variables
+//
+static pthread_mutex_t i2c_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint16_t cci_regs[CCI_REG_WORDS];
+static uint16_t cci_block[CCI_BLOCK_WORDS];
+static uint16_t cci_addr;
+
+static cci_attr_t cci_attrs[CCI_MAX_ATTRS];
+static int cci_num_attrs = 0;
+
+
+
+//
+// CCI Emulator Forward Declarations for internal functions
+//
+static uint16_t* cci_word(uint16_t addr);
+static void cci_exec(uint16_t cmd);
+static cci_attr_t* cci_find_attr(uint16_t base, bool create);
+
+
+
+//
+// I2C API
+//
+esp_err_t i2c_master_init(int scl_pin, int sda_pin)
+{
+	cci_attr_t* attrP;
+	const char* pn = CCI_PART_NUMBER;
+	int i;
+	
+	memset(cci_regs, 0, sizeof(cci_regs));
+	cci_regs[CCI_REG_STATUS / 2] = CCI_STATUS_READY;
+	
+	// Part number (two characters per word, first character in the low byte)
+	attrP = cci_find_attr(CCI_CMD_OEM_GET_PART_NUM, true);
+	attrP->len = 16;
+	for (i=0; i<(int) strlen(pn); i++) {
+		attrP->data[i/2] |= (uint16_t) pn[i] << ((i & 1) ? 8 : 0);
+	}
+	
+	return ESP_OK;
+}
+
+
+void i2c_lock()
+{
+	pthread_mutex_lock(&i2c_mutex);
+}
+
+
+void i2c_unlock()
+{
+	pthread_mutex_unlock(&i2c_mutex);
+}
+
+
+esp_err_t i2c_master_read_slave(uint8_t addr7, uint8_t *data_rd, size_t size)
+{
+	uint16_t* wP;
+	uint16_t w;
+	
+	if (addr7 != CCI_ADDRESS) return ESP_FAIL;
+	
+	// Words are read big-endian starting at the last address written
+	while (size >= 2) {
+		wP = cci_word(cci_addr);
+		w = (wP != NULL) ? *wP : 0;
+		*data_rd++ = w >> 8;
+		*data_rd++ = w & 0xFF;
+		cci_addr += 2;
+		size -= 2;
+	}
+	
+	return ESP_OK;
+}
+
+
+esp_err_t i2c_master_write_slave(uint8_t addr7, uint8_t *data_wr, size_t size)
+{
+	uint16_t* wP;
+	uint16_t w;
+	
+	if ((addr7 != CCI_ADDRESS) || (size < 2)) return ESP_FAIL;
+	
+	// Register address followed by zero or more big-endian data words
+	cci_addr = (data_wr[0] << 8) | data_wr[1];
+	data_wr += 2;
+	size -= 2;
+	while (size >= 2) {
+		w = (data_wr[0] << 8) | data_wr[1];
+		wP = cci_word(cci_addr);
+		if (wP != NULL) {
+			*wP = w;
+		}
+		if (cci_addr == CCI_REG_COMMAND) {
+			cci_exec(w);
+		}
+		cci_addr += 2;
+		data_wr += 2;
+		size -= 2;
+	}
+	
+	return ESP_OK;
+}
+
+
+
+//
+// CCI Emulator internal functions
+//
+static uint16_t* cci_word(uint16_t addr)
+{
+	if (addr < (CCI_REG_WORDS * 2)) {
+		return &cci_regs[addr / 2];
+	} else if (addr >= CCI_BLOCK_BUF_0) {
+		return &cci_block[((addr - CCI_BLOCK_BUF_0) / 2) % CCI_BLOCK_WORDS];
+	}
+	
+	return NULL;
+}
+
+
+static void cci_exec(uint16_t cmd)
+{
+	cci_attr_t* attrP;
+	uint16_t* dataP;
+	int len;
+	
+	len = cci_regs[CCI_REG_DATA_LENGTH / 2];
+	if (len > CCI_BLOCK_WORDS) len = CCI_BLOCK_WORDS;
+	dataP = (len > 16) ? cci_block : &cci_regs[CCI_REG_DATA_0 / 2];
+	
+	switch (cmd & CCI_CMD_TYPE_MASK) {
+		case CCI_CMD_TYPE_GET:
+			attrP = cci_find_attr(cmd & ~CCI_CMD_TYPE_MASK, false);
+			if (attrP != NULL) {
+				memcpy(dataP, attrP->data, len * sizeof(uint16_t));
+			} else {
+				memset(dataP, 0, len * sizeof(uint16_t));
+			}
+			break;
+		
+		case CCI_CMD_TYPE_SET:
+			attrP = cci_find_attr(cmd & ~CCI_CMD_TYPE_MASK, true);
+			if (attrP != NULL) {
+				memcpy(attrP->data, dataP, len * sizeof(uint16_t));
+				attrP->len = len;
+			}
+			break;
+		
+		default:
+			// RUN commands have no effect
+			break;
+	}
+	
+	cci_regs[CCI_REG_STATUS / 2] = CCI_STATUS_READY;
+}
+
+
+static cci_attr_t* cci_find_attr(uint16_t base, bool create)
+{
+	int i;
+	
+	for (i=0; i<cci_num_attrs; i++) {
+		if (cci_attrs[i].base == base) {
+			return &cci_attrs[i];
+		}
+	}
+	
+	if (create && (cci_num_attrs < CCI_MAX_ATTRS)) {
+		cci_attrs[cci_num_attrs].base = base;
+		return &cci_attrs[cci_num_attrs++];
+	}
+	
+	return NULL;
+}
@@ -0,0 +1,578 @@
+/*
+ * Host shim: cJSON subset and mbedtls base64
+ *
+ * Just enough of cJSON to parse commands and print unformatted responses the way the
+ * ESP-IDF json component does, and the base64 codec json_utilities uses for images.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "cJSON.h"
+#include "mbedtls/base64.h"
+
+
+
+//
+// cJSON Shim variables
+//
+static const char* parse_error_ptr;
+
+static const char b64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+
+//
+// cJSON Shim Forward Declarations for internal functions
+//
+static cJSON* new_item(int type);
+static void add_item(cJSON* parent, cJSON* item);
+static const char* skip_ws(const char* s);
+static const char* parse_value(cJSON* item, const char* s);
+static const char* parse_string(char** out, const char* s);
+static bool print_value(const cJSON* item, char** p, char* end);
+static bool print_string(const char* str, char** p, char* end);
+static bool print_chars(const char* str, int len, char** p, char* end);
+static int b64_value(unsigned char c);
+
+
+
+//
+// cJSON API
+//
+cJSON* cJSON_Parse(const char* value)
+{
+	cJSON* item;
+	const char* s;
+	
+	parse_error_ptr = NULL;
+	item = new_item(cJSON_Invalid);
+	if (item == NULL) return NULL;
+	
+	s = parse_value(item, skip_ws(value));
+	if ((s == NULL) || (*skip_ws(s) != 0)) {
+		if (s != NULL) parse_error_ptr = s;
+		cJSON_Delete(item);
+		return NULL;
+	}
+	
+	return item;
+}
+
+
+const char* cJSON_GetErrorPtr()
+{
+	return parse_error_ptr;
+}
+
+
+cJSON_bool cJSON_PrintPreallocated(cJSON* item, char* buffer, const int length, const cJSON_bool format)
+{
+	char* p = buffer;
+	
+	// Formatted output is not supported (the firmware never asks for it)
+	if ((buffer == NULL) || (length <= 0) || format) return 0;
+	
+	if (!print_value(item, &p, buffer + length - 1)) return 0;
+	*p = 0;
+	return 1;
+}
+
+
+void cJSON_Delete(cJSON* item)
+{
+	cJSON* next;
+	
+	while (item != NULL) {
+		next = item->next;
+		if (!(item->type & cJSON_IsReference)) {
+			cJSON_Delete(item->child);
+			free(item->valuestring);
+		}
+		if (!(item->type & cJSON_StringIsConst)) {
+			free(item->string);
+		}
+		free(item);
+		item = next;
+	}
+}
+
+
+int cJSON_GetArraySize(const cJSON* array)
+{
+	cJSON* c;
+	int n = 0;
+	
+	if (array == NULL) return 0;
+	for (c = array->child; c != NULL; c = c->next) n++;
+	return n;
+}
+
+
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index)
+{
+	cJSON* c;
+	
+	if ((array == NULL) || (index < 0)) return NULL;
+	for (c = array->child; (c != NULL) && (index > 0); c = c->next) index--;
+	return c;
+}
+
+
+cJSON* cJSON_GetObjectItem(const cJSON* const object, const char* const string)
+{
+	cJSON* c;
+	
+	if ((object == NULL) || (string == NULL)) return NULL;
+	for (c = object->child; c != NULL; c = c->next) {
+		if ((c->string != NULL) && (strcasecmp(c->string, string) == 0)) return c;
+	}
+	return NULL;
+}
+
+
+cJSON_bool cJSON_HasObjectItem(const cJSON* object, const char* string)
+{
+	return cJSON_GetObjectItem(object, string) != NULL;
+}
+
+
+char* cJSON_GetStringValue(const cJSON* const item)
+{
+	return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+
+cJSON_bool cJSON_IsArray(const cJSON* const item)
+{
+	return (item != NULL) && ((item->type & 0xFF) == cJSON_Array);
+}
+
+
+cJSON_bool cJSON_IsString(const cJSON* const item)
+{
+	return (item != NULL) && ((item->type & 0xFF) == cJSON_String);
+}
+
+
+cJSON* cJSON_CreateObject()
+{
+	return new_item(cJSON_Object);
+}
+
+
+cJSON* cJSON_CreateArray()
+{
+	return new_item(cJSON_Array);
+}
+
+
+cJSON* cJSON_CreateStringReference(const char* string)
+{
+	cJSON* item = new_item(cJSON_String | cJSON_IsReference);
+	
+	if (item != NULL) item->valuestring = (char*) string;
+	return item;
+}
+
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item)
+{
+	if ((array == NULL) || (item == NULL)) return 0;
+	add_item(array, item);
+	return 1;
+}
+
+
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item)
+{
+	if ((object == NULL) || (string == NULL) || (item == NULL)) return 0;
+	item->string = strdup(string);
+	if (item->string == NULL) return 0;
+	add_item(object, item);
+	return 1;
+}
+
+
+cJSON* cJSON_AddNumberToObject(cJSON* const object, const char* const name, const double number)
+{
+	cJSON* item = new_item(cJSON_Number);
+	
+	if (item == NULL) return NULL;
+	item->valuedouble = number;
+	if (number >= 2147483647.0) {
+		item->valueint = 2147483647;
+	} else if (number <= -2147483648.0) {
+		item->valueint = -2147483647 - 1;
+	} else {
+		item->valueint = (int) number;
+	}
+	if (!cJSON_AddItemToObject(object, name, item)) {
+		cJSON_Delete(item);
+		return NULL;
+	}
+	return item;
+}
+
+
+cJSON* cJSON_AddStringToObject(cJSON* const object, const char* const name, const char* const string)
+{
+	cJSON* item = new_item(cJSON_String);
+	
+	if (item == NULL) return NULL;
+	item->valuestring = strdup(string);
+	if ((item->valuestring == NULL) || !cJSON_AddItemToObject(object, name, item)) {
+		cJSON_Delete(item);
+		return NULL;
+	}
+	return item;
+}
+
+
+
+//
+// mbedtls base64 API
+//
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen)
+{
+	size_t i;
+	size_t n = 4 * ((slen + 2) / 3);
+	uint32_t v;
+	
+	if (slen == 0) {
+		*olen = 0;
+		return 0;
+	}
+	if (dlen < n + 1) {
+		*olen = n + 1;
+		return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+	}
+	
+	for (i = 0; i + 2 < slen; i += 3) {
+		v = (src[i] << 16) | (src[i+1] << 8) | src[i+2];
+		*dst++ = b64_chars[(v >> 18) & 0x3F];
+		*dst++ = b64_chars[(v >> 12) & 0x3F];
+		*dst++ = b64_chars[(v >> 6) & 0x3F];
+		*dst++ = b64_chars[v & 0x3F];
+	}
+	if (i < slen) {
+		v = src[i] << 16;
+		if (i + 1 < slen) v |= src[i+1] << 8;
+		*dst++ = b64_chars[(v >> 18) & 0x3F];
+		*dst++ = b64_chars[(v >> 12) & 0x3F];
+		*dst++ = (i + 1 < slen) ? b64_chars[(v >> 6) & 0x3F] : '=';
+		*dst++ = '=';
+	}
+	*dst = 0;
+	*olen = n;
+	
+	return 0;
+}
+
+
+int mbedtls_base64_decode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen)
+{
+	size_t i;
+	size_t n = 0;
+	size_t pad = 0;
+	int b;
+	uint32_t v = 0;
+	int bits = 0;
+	
+	// Validate and size the output first
+	for (i = 0; i < slen; i++) {
+		if (src[i] == '=') {
+			pad++;
+		} else if ((pad != 0) || (b64_value(src[i]) < 0)) {
+			return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+		} else {
+			n++;
+		}
+	}
+	if ((pad > 2) || (((n + pad) % 4) != 0)) return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+	n = (n * 6) / 8;
+	if ((dst == NULL) || (dlen < n)) {
+		*olen = n;
+		return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+	}
+	
+	for (i = 0; i < slen; i++) {
+		if ((b = b64_value(src[i])) < 0) break;
+		v = (v << 6) | b;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			*dst++ = (v >> bits) & 0xFF;
+		}
+	}
+	*olen = n;
+	
+	return 0;
+}
+
+
+
+//
+// cJSON Shim internal functions
+//
+static cJSON* new_item(int type)
+{
+	cJSON* item = calloc(1, sizeof(cJSON));
+	
+	if (item != NULL) item->type = type;
+	return item;
+}
+
+
+static void add_item(cJSON* parent, cJSON* item)
+{
+	cJSON* c = parent->child;
+	
+	item->next = NULL;
+	if (c == NULL) {
+		parent->child = item;
+		item->prev = NULL;
+	} else {
+		while (c->next != NULL) c = c->next;
+		c->next = item;
+		item->prev = c;
+	}
+}
+
+
+static const char* skip_ws(const char* s)
+{
+	// Like cJSON every control character is whitespace (commands arrive with their start delimiter)
+	while ((*s != 0) && ((unsigned char) *s <= 32)) s++;
+	return s;
+}
+
+
+static const char* parse_value(cJSON* item, const char* s)
+{
+	cJSON* child;
+	char* end;
+	bool is_object;
+	
+	if (strncmp(s, "null", 4) == 0) {
+		item->type = cJSON_NULL;
+		return s + 4;
+	}
+	if (strncmp(s, "false", 5) == 0) {
+		item->type = cJSON_False;
+		return s + 5;
+	}
+	if (strncmp(s, "true", 4) == 0) {
+		item->type = cJSON_True;
+		item->valueint = 1;
+		return s + 4;
+	}
+	if (*s == '"') {
+		item->type = cJSON_String;
+		return parse_string(&item->valuestring, s);
+	}
+	if ((*s == '-') || isdigit((unsigned char) *s)) {
+		item->type = cJSON_Number;
+		item->valuedouble = strtod(s, &end);
+		if (item->valuedouble >= 2147483647.0) {
+			item->valueint = 2147483647;
+		} else if (item->valuedouble <= -2147483648.0) {
+			item->valueint = -2147483647 - 1;
+		} else {
+			item->valueint = (int) item->valuedouble;
+		}
+		return end;
+	}
+	if ((*s == '{') || (*s == '[')) {
+		is_object = (*s == '{');
+		item->type = is_object ? cJSON_Object : cJSON_Array;
+		s = skip_ws(s + 1);
+		if (*s == (is_object ? '}' : ']')) return s + 1;
+		
+		while (1) {
+			if ((child = new_item(cJSON_Invalid)) == NULL) return NULL;
+			add_item(item, child);
+			if (is_object) {
+				if (*s != '"') break;
+				if ((s = parse_string(&child->string, s)) == NULL) return NULL;
+				s = skip_ws(s);
+				if (*s != ':') break;
+				s = skip_ws(s + 1);
+			}
+			if ((s = parse_value(child, s)) == NULL) return NULL;
+			s = skip_ws(s);
+			if (*s == ',') {
+				s = skip_ws(s + 1);
+			} else if (*s == (is_object ? '}' : ']')) {
+				return s + 1;
+			} else {
+				break;
+			}
+		}
+	}
+	
+	parse_error_ptr = s;
+	return NULL;
+}
+
+
+static const char* parse_string(char** out, const char* s)
+{
+	const char* start = ++s;
+	char* d;
+	unsigned int u;
+	
+	// Escapes only shorten the string so its raw length bounds the output
+	while ((*s != 0) && (*s != '"')) {
+		if ((*s == '\\') && (*(s+1) != 0)) s++;
+		s++;
+	}
+	if (*s != '"') {
+		parse_error_ptr = start - 1;
+		return NULL;
+	}
+	if ((*out = malloc(s - start + 1)) == NULL) return NULL;
+	
+	d = *out;
+	for (s = start; *s != '"'; s++) {
+		if (*s != '\\') {
+			*d++ = *s;
+			continue;
+		}
+		switch (*++s) {
+			case 'b': *d++ = '\b'; break;
+			case 'f': *d++ = '\f'; break;
+			case 'n': *d++ = '\n'; break;
+			case 'r': *d++ = '\r'; break;
+			case 't': *d++ = '\t'; break;
+			case 'u':
+				// Commands are ASCII; keep the low byte of a \u escape
+				if (sscanf(s + 1, "%4x", &u) == 1) {
+					*d++ = u & 0xFF;
+					while ((*(s+1) != '"') && isxdigit((unsigned char) *(s+1))) s++;
+				}
+				break;
+			default: *d++ = *s;
+		}
+	}
+	*d = 0;
+	
+	return s + 1;
+}
+
+
+static bool print_value(const cJSON* item, char** p, char* end)
+{
+	char num[32];
+	const cJSON* c;
+	double d;
+	bool is_object;
+	
+	switch (item->type & 0xFF) {
+		case cJSON_NULL:
+			return print_chars("null", 4, p, end);
+		case cJSON_False:
+			return print_chars("false", 5, p, end);
+		case cJSON_True:
+			return print_chars("true", 4, p, end);
+		case cJSON_String:
+			return print_string(item->valuestring, p, end);
+		case cJSON_Number:
+			// Same choice of representation as cJSON's print_number
+			d = item->valuedouble;
+			if (isnan(d) || isinf(d)) {
+				strcpy(num, "null");
+			} else if (d == (double) item->valueint) {
+				sprintf(num, "%d", item->valueint);
+			} else {
+				sprintf(num, "%1.15g", d);
+				if (strtod(num, NULL) != d) sprintf(num, "%1.17g", d);
+			}
+			return print_chars(num, strlen(num), p, end);
+		case cJSON_Array:
+		case cJSON_Object:
+			is_object = ((item->type & 0xFF) == cJSON_Object);
+			if (!print_chars(is_object ? "{" : "[", 1, p, end)) return false;
+			for (c = item->child; c != NULL; c = c->next) {
+				if (is_object) {
+					if (!print_string(c->string, p, end)) return false;
+					if (!print_chars(":", 1, p, end)) return false;
+				}
+				if (!print_value(c, p, end)) return false;
+				if ((c->next != NULL) && !print_chars(",", 1, p, end)) return false;
+			}
+			return print_chars(is_object ? "}" : "]", 1, p, end);
+	}
+	
+	return false;
+}
+
+
+static bool print_string(const char* str, char** p, char* end)
+{
+	char esc[8];
+	
+	if (str == NULL) str = "";
+	if (!print_chars("\"", 1, p, end)) return false;
+	for (; *str != 0; str++) {
+		switch (*str) {
+			case '"':  if (!print_chars("\\\"", 2, p, end)) return false; break;
+			case '\\': if (!print_chars("\\\\", 2, p, end)) return false; break;
+			case '\b': if (!print_chars("\\b", 2, p, end)) return false; break;
+			case '\f': if (!print_chars("\\f", 2, p, end)) return false; break;
+			case '\n': if (!print_chars("\\n", 2, p, end)) return false; break;
+			case '\r': if (!print_chars("\\r", 2, p, end)) return false; break;
+			case '\t': if (!print_chars("\\t", 2, p, end)) return false; break;
+			default:
+				if ((unsigned char) *str < 0x20) {
+					sprintf(esc, "\\u%04x", (unsigned char) *str);
+					if (!print_chars(esc, 6, p, end)) return false;
+				} else {
+					if (!print_chars(str, 1, p, end)) return false;
+				}
+		}
+	}
+	return print_chars("\"", 1, p, end);
+}
+
+
+static bool print_chars(const char* str, int len, char** p, char* end)
+{
+	if ((end - *p) < len) return false;
+	memcpy(*p, str, len);
+	*p += len;
+	return true;
+}
+
+
+static int b64_value(unsigned char c)
+{
+	if ((c >= 'A') && (c <= 'Z')) return c - 'A';
+	if ((c >= 'a') && (c <= 'z')) return c - 'a' + 26;
+	if ((c >= '0') && (c <= '9')) return c - '0' + 52;
+	if (c == '+') return 62;
+	if (c == '/') return 63;
+	return -1;
+}
@@ -0,0 +1,198 @@
+/*
+ * Host shim: ESP-IDF logging, timer, heap and system information
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host_shim.h"
+
+
+
+//
+// ESP Shim constants
+//
+
+// Allocation header (keeps the returned pointer 16-byte aligned)
+#define HEAP_HDR_LEN 16
+
+// Nominal heap sizes of a tCam-Mini for heap_caps_get_minimum_free_size()
+#define HEAP_INT_LEN    (200 * 1024)
+#define HEAP_SPIRAM_LEN (4 * 1024 * 1024)
+
+
+
+//
+// ESP Shim variables
+//
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static const char log_letter[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+static pthread_mutex_t heap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static host_heap_stats_t heap_stats[2];    // Indexed by spiram
+
+static int64_t timer_start_usec = -1;
+
+// Factory-programmed MAC address and application description reported by the host
+static const uint8_t host_mac_addr[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+static const esp_app_desc_t host_app_desc = {
+	.version = "3.1-host",
+	.project_name = "tCamMini",
+	.time = __TIME__,
+	.date = __DATE__,
+	.idf_ver = "host"
+};
+
+
+
+//
+// ESP Shim API
+//
+void host_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+	va_list args;
+	
+	if (level > log_level) return;
+	
+	fprintf(stderr, "%c (%lld) %s: ", log_letter[level], (long long) (esp_timer_get_time() / 1000), tag);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+}
+
+
+void host_log_set_level(esp_log_level_t level)
+{
+	log_level = level;
+}
+
+
+int64_t esp_timer_get_time()
+{
+	struct timespec ts;
+	int64_t t;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t = ((int64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+	if (timer_start_usec < 0) {
+		timer_start_usec = t;
+	}
+	
+	return t - timer_start_usec;
+}
+
+
+void* heap_caps_malloc(size_t size, uint32_t caps)
+{
+	uint8_t* p;
+	int i = ((caps & MALLOC_CAP_SPIRAM) != 0) ? 1 : 0;
+	
+	p = malloc(size + HEAP_HDR_LEN);
+	if (p == NULL) return NULL;
+	
+	*((size_t*) p) = size;
+	*((int*) (p + sizeof(size_t))) = i;
+	
+	pthread_mutex_lock(&heap_mutex);
+	heap_stats[i].cur_bytes += size;
+	heap_stats[i].allocs++;
+	if (heap_stats[i].cur_bytes > heap_stats[i].peak_bytes) {
+		heap_stats[i].peak_bytes = heap_stats[i].cur_bytes;
+	}
+	pthread_mutex_unlock(&heap_mutex);
+	
+	return p + HEAP_HDR_LEN;
+}
+
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+	void* p;
+	
+	p = heap_caps_malloc(n * size, caps);
+	if (p != NULL) {
+		memset(p, 0, n * size);
+	}
+	
+	return p;
+}
+
+
+void heap_caps_free(void* ptr)
+{
+	uint8_t* p;
+	int i;
+	
+	if (ptr == NULL) return;
+	
+	p = (uint8_t*) ptr - HEAP_HDR_LEN;
+	i = *((int*) (p + sizeof(size_t)));
+	
+	pthread_mutex_lock(&heap_mutex);
+	heap_stats[i].cur_bytes -= *((size_t*) p);
+	pthread_mutex_unlock(&heap_mutex);
+	
+	free(p);
+}
+
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+	size_t len;
+	size_t peak;
+	int i = ((caps & MALLOC_CAP_SPIRAM) != 0) ? 1 : 0;
+	
+	len = (i == 1) ? HEAP_SPIRAM_LEN : HEAP_INT_LEN;
+	pthread_mutex_lock(&heap_mutex);
+	peak = heap_stats[i].peak_bytes;
+	pthread_mutex_unlock(&heap_mutex);
+	
+	return (peak < len) ? len - peak : 0;
+}
+
+
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac)
+{
+	memcpy(mac, host_mac_addr, sizeof(host_mac_addr));
+	return ESP_OK;
+}
+
+
+const esp_app_desc_t* esp_ota_get_app_description()
+{
+	return &host_app_desc;
+}
+
+
+void host_heap_get_stats(bool spiram, host_heap_stats_t* statsP)
+{
+	pthread_mutex_lock(&heap_mutex);
+	*statsP = heap_stats[spiram ? 1 : 0];
+	pthread_mutex_unlock(&heap_mutex);
+}
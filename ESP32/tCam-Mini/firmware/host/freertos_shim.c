@@ -0,0 +1,351 @@
+/*
+ * Host shim: FreeRTOS tasks, task notifications and mutexes
+ *
+ * Tasks are POSIX threads.  Each has a notification value protected by a mutex and a
+ * condition variable.  Threads not created by xTaskCreatePinnedToCore (main and the
+ * simulated ISR thread) are given a task structure the first time they need one.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "host_shim.h"
+
+
+
+//
+// FreeRTOS Shim typedefs
+//
+struct host_task {
+	pthread_t thread;
+	char name[16];
+	TaskFunction_t fn;
+	void* arg;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t stack_depth;        // Requested stack (bytes)
+	uint32_t value;              // Notification value
+	bool pending;                // Set when a notification has not been received
+};
+
+struct host_mutex {
+	pthread_mutex_t m;
+};
+
+
+
+//
+// FreeRTOS Shim variables
+//
+static __thread struct host_task* cur_task = NULL;
+
+
+
+//
+// FreeRTOS Shim Forward Declarations for internal functions
+//
+static struct host_task* task_alloc(const char* name);
+static void* task_start(void* arg);
+static void abs_timeout(TickType_t ticks, clockid_t clk, struct timespec* tsP);
+
+
+
+//
+// FreeRTOS Shim API
+//
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth,
+                                   void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask,
+                                   BaseType_t xCoreID)
+{
+	struct host_task* t;
+	
+	t = task_alloc(pcName);
+	if (t == NULL) return pdFAIL;
+	t->fn = pvTaskCode;
+	t->arg = pvParameters;
+	t->stack_depth = usStackDepth;
+	
+	// The handle must be valid before the task runs since tasks find each other through it
+	if (pvCreatedTask != NULL) {
+		*pvCreatedTask = t;
+	}
+	
+	if (pthread_create(&t->thread, NULL, task_start, t) != 0) {
+		if (pvCreatedTask != NULL) {
+			*pvCreatedTask = NULL;
+		}
+		free(t);
+		return pdFAIL;
+	}
+	pthread_setname_np(t->thread, t->name);
+	
+	return pdPASS;
+}
+
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth,
+                       void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask)
+{
+	return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask, 0);
+}
+
+
+void vTaskDelete(TaskHandle_t xTask)
+{
+	if ((xTask == NULL) || (xTask == cur_task)) {
+		pthread_exit(NULL);
+	} else {
+		pthread_cancel(xTask->thread);
+	}
+}
+
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+	// Host thread stacks are not measured so report the whole stack as unused
+	if (xTask == NULL) xTask = xTaskGetCurrentTaskHandle();
+	return xTask->stack_depth;
+}
+
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+	struct timespec ts;
+	uint64_t usec = ((uint64_t) xTicksToDelay * 1000000) / configTICK_RATE_HZ;
+	
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) != 0) {}
+}
+
+
+TickType_t xTaskGetTickCount()
+{
+	return (TickType_t) ((esp_timer_get_time() * configTICK_RATE_HZ) / 1000000);
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+	if (cur_task == NULL) {
+		cur_task = task_alloc("host");
+		if (cur_task != NULL) {
+			cur_task->thread = pthread_self();
+		}
+	}
+	
+	return cur_task;
+}
+
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction)
+{
+	BaseType_t ret = pdPASS;
+	
+	if (xTaskToNotify == NULL) return pdFAIL;
+	
+	pthread_mutex_lock(&xTaskToNotify->lock);
+	switch (eAction) {
+		case eSetBits:
+			xTaskToNotify->value |= ulValue;
+			break;
+		case eIncrement:
+			xTaskToNotify->value++;
+			break;
+		case eSetValueWithOverwrite:
+			xTaskToNotify->value = ulValue;
+			break;
+		case eSetValueWithoutOverwrite:
+			if (xTaskToNotify->pending) {
+				ret = pdFAIL;
+			} else {
+				xTaskToNotify->value = ulValue;
+			}
+			break;
+		default:
+			break;
+	}
+	xTaskToNotify->pending = true;
+	pthread_cond_signal(&xTaskToNotify->cond);
+	pthread_mutex_unlock(&xTaskToNotify->lock);
+	
+	return ret;
+}
+
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+                              BaseType_t* pxHigherPriorityTaskWoken)
+{
+	if (pxHigherPriorityTaskWoken != NULL) {
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	}
+	
+	return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit,
+                           uint32_t* pulNotificationValue, TickType_t xTicksToWait)
+{
+	struct host_task* t = xTaskGetCurrentTaskHandle();
+	struct timespec ts;
+	BaseType_t ret;
+	
+	pthread_mutex_lock(&t->lock);
+	if (!t->pending) {
+		t->value &= ~ulBitsToClearOnEntry;
+		if (xTicksToWait == portMAX_DELAY) {
+			while (!t->pending) {
+				pthread_cond_wait(&t->cond, &t->lock);
+			}
+		} else if (xTicksToWait != 0) {
+			abs_timeout(xTicksToWait, CLOCK_MONOTONIC, &ts);
+			while (!t->pending) {
+				if (pthread_cond_timedwait(&t->cond, &t->lock, &ts) == ETIMEDOUT) {
+					break;
+				}
+			}
+		}
+	}
+	
+	if (pulNotificationValue != NULL) {
+		*pulNotificationValue = t->value;
+	}
+	if (t->pending) {
+		t->value &= ~ulBitsToClearOnExit;
+		t->pending = false;
+		ret = pdTRUE;
+	} else {
+		ret = pdFALSE;
+	}
+	pthread_mutex_unlock(&t->lock);
+	
+	return ret;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	struct host_mutex* m;
+	
+	m = malloc(sizeof(struct host_mutex));
+	if (m != NULL) {
+		pthread_mutex_init(&m->m, NULL);
+	}
+	
+	return m;
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait)
+{
+	struct timespec ts;
+	
+	if (xTicksToWait == portMAX_DELAY) {
+		return (pthread_mutex_lock(&xSemaphore->m) == 0) ? pdTRUE : pdFALSE;
+	} else if (xTicksToWait == 0) {
+		return (pthread_mutex_trylock(&xSemaphore->m) == 0) ? pdTRUE : pdFALSE;
+	} else {
+		abs_timeout(xTicksToWait, CLOCK_REALTIME, &ts);
+		return (pthread_mutex_timedlock(&xSemaphore->m, &ts) == 0) ? pdTRUE : pdFALSE;
+	}
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+	return (pthread_mutex_unlock(&xSemaphore->m) == 0) ? pdTRUE : pdFALSE;
+}
+
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+	pthread_mutex_destroy(&xSemaphore->m);
+	free(xSemaphore);
+}
+
+
+/**
+ * Return the CPU time used by a task's thread (uSec)
+ */
+uint64_t host_task_cpu_usec(TaskHandle_t task)
+{
+	clockid_t cid;
+	struct timespec ts;
+	
+	if ((task == NULL) || (pthread_getcpuclockid(task->thread, &cid) != 0)) {
+		return 0;
+	}
+	if (clock_gettime(cid, &ts) != 0) {
+		return 0;
+	}
+	
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+
+
+//
+// FreeRTOS Shim internal functions
+//
+static struct host_task* task_alloc(const char* name)
+{
+	struct host_task* t;
+	pthread_condattr_t ca;
+	
+	t = calloc(1, sizeof(struct host_task));
+	if (t == NULL) return NULL;
+	
+	strncpy(t->name, name, sizeof(t->name) - 1);
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_condattr_init(&ca);
+	pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+	pthread_cond_init(&t->cond, &ca);
+	pthread_condattr_destroy(&ca);
+	
+	return t;
+}
+
+
+static void* task_start(void* arg)
+{
+	cur_task = (struct host_task*) arg;
+	cur_task->fn(cur_task->arg);
+	
+	return NULL;
+}
+
+
+static void abs_timeout(TickType_t ticks, clockid_t clk, struct timespec* tsP)
+{
+	uint64_t nsec = ((uint64_t) ticks * 1000000000) / configTICK_RATE_HZ;
+	
+	clock_gettime(clk, tsP);
+	nsec += tsP->tv_nsec;
+	tsP->tv_sec += nsec / 1000000000;
+	tsP->tv_nsec = nsec % 1000000000;
+}
@@ -0,0 +1,204 @@
+/*
+ * Host shim: ESP-IDF GPIO driver and simulated Lepton VSYNC
+ *
+ * A thread generates VSYNC edges at a fixed period, counting them for the VoSPI replay
+ * and calling any enabled GPIO interrupt handler (there is only the VSYNC handler).
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <time.h>
+#include "driver/gpio.h"
+#include "host_shim.h"
+
+
+
+//
+// GPIO Shim constants
+//
+#define GPIO_NUM_PINS 40
+
+
+
+//
+// GPIO Shim variables
+//
+static gpio_isr_t isr_handler[GPIO_NUM_PINS];
+static void* isr_arg[GPIO_NUM_PINS];
+static volatile bool isr_enabled[GPIO_NUM_PINS];
+
+static pthread_t vsync_thread;
+static volatile bool vsync_running = false;
+static uint32_t vsync_period_usec;
+static volatile uint32_t vsync_count = 0;
+
+
+
+//
+// GPIO Shim Forward Declarations for internal functions
+//
+static void* vsync_gen(void* arg);
+
+
+
+//
+// GPIO Shim API
+//
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+	return ESP_OK;
+}
+
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+	return 0;
+}
+
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+	if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_PINS)) return ESP_ERR_INVALID_ARG;
+	
+	isr_enabled[gpio_num] = (intr_type != GPIO_INTR_DISABLE);
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler_fn, void* args)
+{
+	if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_PINS)) return ESP_ERR_INVALID_ARG;
+	
+	isr_arg[gpio_num] = args;
+	__atomic_store_n(&isr_handler[gpio_num], isr_handler_fn, __ATOMIC_RELEASE);
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+	if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_PINS)) return ESP_ERR_INVALID_ARG;
+	
+	isr_enabled[gpio_num] = true;
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+	if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_PINS)) return ESP_ERR_INVALID_ARG;
+	
+	isr_enabled[gpio_num] = false;
+	return ESP_OK;
+}
+
+
+/**
+ * Start generating VSYNC edges every period_usec
+ */
+bool host_vsync_start(uint32_t period_usec)
+{
+	if (vsync_running) return false;
+	
+	vsync_period_usec = period_usec;
+	vsync_running = true;
+	if (pthread_create(&vsync_thread, NULL, vsync_gen, NULL) != 0) {
+		vsync_running = false;
+		return false;
+	}
+	pthread_setname_np(vsync_thread, "vsync");
+	
+	return true;
+}
+
+
+void host_vsync_stop()
+{
+	if (vsync_running) {
+		vsync_running = false;
+		pthread_join(vsync_thread, NULL);
+	}
+}
+
+
+/**
+ * Return the number of VSYNC edges generated
+ */
+uint32_t host_vsync_count()
+{
+	return __atomic_load_n(&vsync_count, __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * Advance the VSYNC count without calling the interrupt handlers (for single-threaded
+ * benchmarks that call the VoSPI driver directly).  Returns the new count.
+ */
+uint32_t host_vsync_step()
+{
+	return __atomic_add_fetch(&vsync_count, 1, __ATOMIC_ACQ_REL);
+}
+
+
+
+//
+// GPIO Shim internal functions
+//
+static void* vsync_gen(void* arg)
+{
+	struct timespec ts;
+	gpio_isr_t fn;
+	int i;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	while (vsync_running) {
+		// Sleep until the next edge (absolute time so the period does not drift)
+		ts.tv_nsec += (long) vsync_period_usec * 1000;
+		while (ts.tv_nsec >= 1000000000) {
+			ts.tv_nsec -= 1000000000;
+			ts.tv_sec++;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+		
+		// The Lepton starts outputting the next segment at the edge
+		__atomic_add_fetch(&vsync_count, 1, __ATOMIC_ACQ_REL);
+		
+		for (i=0; i<GPIO_NUM_PINS; i++) {
+			fn = __atomic_load_n(&isr_handler[i], __ATOMIC_ACQUIRE);
+			if ((fn != NULL) && isr_enabled[i]) {
+				fn(isr_arg[i]);
+			}
+		}
+	}
+	
+	return NULL;
+}
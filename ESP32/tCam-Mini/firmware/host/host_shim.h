@@ -0,0 +1,82 @@
+/*
+ * Host build support
+ *
+ * Functions the host benchmark uses to drive and observe the FreeRTOS/ESP-IDF shim.
+ * They have no firmware equivalent.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+//
+// Host Shim typedefs
+//
+typedef struct {
+	size_t cur_bytes;            // Currently allocated
+	size_t peak_bytes;           // High-water mark
+	uint32_t allocs;             // Successful allocations
+} host_heap_stats_t;
+
+typedef struct {
+	uint32_t vsyncs;             // VSYNC periods since the replay started
+	uint32_t packets;            // Packets read by the SPI master
+	uint32_t late_packets;       // Packets read after the segment for the VSYNC period was exhausted
+	uint32_t loops;              // Times the capture was restarted from its beginning
+} host_replay_stats_t;
+
+
+
+//
+// Host Shim API
+//
+
+// Logging
+void host_log_set_level(esp_log_level_t level);
+
+// Heap (spiram selects the MALLOC_CAP_SPIRAM allocations, otherwise internal memory)
+void host_heap_get_stats(bool spiram, host_heap_stats_t* statsP);
+
+// Command interface (a connected socket or -1 when disconnected)
+void host_net_set_socket(int sock);
+
+// Tasks
+uint64_t host_task_cpu_usec(TaskHandle_t task);
+
+// VSYNC generator
+bool host_vsync_start(uint32_t period_usec);
+void host_vsync_stop();
+uint32_t host_vsync_count();
+uint32_t host_vsync_step();
+
+// VoSPI capture replay
+bool host_replay_open(const char* path);
+uint32_t host_replay_get_flags();
+uint32_t host_replay_get_num_vsyncs();
+void host_replay_get_stats(host_replay_stats_t* statsP);
+
+#endif /* HOST_SHIM_H */
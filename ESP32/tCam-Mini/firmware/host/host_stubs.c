@@ -0,0 +1,260 @@
+/*
+ * Host build stand-ins for firmware modules outside the acquisition pipeline
+ *
+ * The host build compiles the acquisition pipeline (lep_task, vospi, the frame ring in
+ * sys_utilities and the image processing modules) and the response pipeline (rsp_task,
+ * json_utilities and bin_utilities).  These replace the control task, persistent storage,
+ * networking, serial interface, firmware update and clock modules they refer to.  The
+ * command socket is one end of a loopback connection supplied with host_net_set_socket().
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <string.h>
+#include <time.h>
+#include "ctrl_task.h"
+#include "ds3232.h"
+#include "host_shim.h"
+#include "json_utilities.h"
+#include "net_cmd_task.h"
+#include "net_utilities.h"
+#include "ps_utilities.h"
+#include "sif_utilities.h"
+#include "time_utilities.h"
+#include "upd_utilities.h"
+#include "esp_log.h"
+#include "mdns.h"
+
+
+
+//
+// Host Stubs variables
+//
+static const char* TAG = "host";
+
+static int host_fault_type = CTRL_FAULT_NONE;
+
+static int host_sock = -1;
+
+static char host_cam_name[] = "tCam-Mini-0001";
+static net_info_t host_net_info = {
+	host_cam_name, "", "", "",
+	NET_INFO_FLAG_INITIALIZED | NET_INFO_FLAG_ENABLED | NET_INFO_FLAG_CONNECTED | NET_INFO_FLAG_CLIENT_MODE,
+	{0, 0, 0, 0}, {1, 0, 0, 127}, {0, 0, 0, 255}, {1, 0, 0, 127}
+};
+
+bool (*net_init)();
+bool (*net_reinit)();
+net_info_t* (*net_get_info)();
+
+
+
+//
+// ctrl_task
+//
+void ctrl_get_if_mode(int* brd, int* iface)
+{
+	*brd = CTRL_BRD_WIFI_TYPE;
+	*iface = CTRL_IF_MODE_WIFI;
+}
+
+
+void ctrl_set_fault_type(int f)
+{
+	if (f != host_fault_type) {
+		ESP_LOGI(TAG, "Fault type %d", f);
+		host_fault_type = f;
+	}
+}
+
+
+
+//
+// Board services
+//
+void time_init()
+{
+}
+
+
+void time_set(tmElements_t te)
+{
+	// The host clock is not changed
+}
+
+
+void time_get(tmElements_t* te)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_REALTIME, &ts);
+	rtc_breakTime(ts.tv_sec, te);
+	te->Millisecond = ts.tv_nsec / 1000000;
+}
+
+
+void rtc_breakTime(time_t time, tmElements_t* tm)
+{
+	struct tm t;
+	
+	gmtime_r(&time, &t);
+	tm->Millisecond = 0;
+	tm->Second = t.tm_sec;
+	tm->Minute = t.tm_min;
+	tm->Hour = t.tm_hour;
+	tm->Wday = t.tm_wday + 1;
+	tm->Day = t.tm_mday;
+	tm->Month = t.tm_mon + 1;
+	tm->Year = t.tm_year - 70;
+}
+
+
+time_t rtc_makeTime(const tmElements_t tm)
+{
+	struct tm t;
+	
+	memset(&t, 0, sizeof(t));
+	t.tm_sec = tm.Second;
+	t.tm_min = tm.Minute;
+	t.tm_hour = tm.Hour;
+	t.tm_mday = tm.Day;
+	t.tm_mon = tm.Month - 1;
+	t.tm_year = tm.Year + 70;
+	
+	return timegm(&t);
+}
+
+
+bool ps_init(int brd, int iface)
+{
+	return true;
+}
+
+
+void ps_get_lep_state(json_config_t* state)
+{
+	state->agc_set_enabled = false;
+	state->emissivity = 100;
+	state->gain_mode = SYS_GAIN_HIGH;
+}
+
+
+void ps_set_lep_state(const json_config_t* state)
+{
+}
+
+
+void ps_set_net_info(const net_info_t* info)
+{
+}
+
+
+bool ps_has_new_cam_name(const net_info_t* info)
+{
+	return (strcmp(info->ap_ssid, host_net_info.ap_ssid) != 0);
+}
+
+
+char ps_nibble_to_ascii(uint8_t n)
+{
+	n = n & 0x0F;
+	
+	if (n < 10) {
+		return '0' + n;
+	} else {
+		return 'A' + n - 10;
+	}
+}
+
+
+static bool host_net_init()
+{
+	return true;
+}
+
+
+static net_info_t* host_net_get_info()
+{
+	return &host_net_info;
+}
+
+
+void net_init_if(int if_type)
+{
+	net_init = &host_net_init;
+	net_reinit = &host_net_init;
+	net_get_info = &host_net_get_info;
+}
+
+
+void host_net_set_socket(int sock)
+{
+	host_sock = sock;
+}
+
+
+bool net_cmd_connected()
+{
+	return (host_sock >= 0);
+}
+
+
+int net_cmd_get_socket()
+{
+	return host_sock;
+}
+
+
+esp_err_t mdns_hostname_set(const char* hostname)
+{
+	return ESP_OK;
+}
+
+
+void sif_send(const char* s, int len)
+{
+}
+
+
+
+//
+// Firmware update (not supported by the host)
+//
+bool upd_init(uint32_t len, char* version)
+{
+	ESP_LOGE(TAG, "Firmware update not supported");
+	return false;
+}
+
+
+bool upd_complete()
+{
+	return false;
+}
+
+
+void upd_early_terminate()
+{
+}
+
+
+bool upd_process_bytes(uint32_t start, uint32_t len, uint8_t* buf)
+{
+	return false;
+}
+
@@ -0,0 +1,598 @@
+/*
+ * Host acquisition pipeline benchmark
+ *
+ * Runs the firmware's lep_task against a replayed VoSPI capture with a simulated VSYNC
+ * and a stand-in for rsp_task that takes every frame from the frame ring and runs the
+ * image processing stages rsp_task may use.  Reports frame rates, per-stage times,
+ * per-task CPU time and memory high-water marks.
+ *
+ * With -C the firmware's rsp_task runs instead of the stand-in.  A client connected
+ * through a loopback socket sends the commands (e.g. stream_on) to a stand-in for
+ * net_cmd_task and counts the responses so the encode and send stages are measured.
+ *
+ * usage: pipeline_bench [-s seconds] [-p vsync_usec] [-F] [-B post_frames] [-C command]... [-v] capture_file
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include "lwip/sockets.h"
+#include <sys/resource.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ctrl_task.h"
+#include "lep_task.h"
+#include "rsp_task.h"
+#include "cmd_utilities.h"
+#include "net_cmd_task.h"
+#include "agc_utilities.h"
+#include "alarm_utilities.h"
+#include "change_utilities.h"
+#include "crop_utilities.h"
+#include "decimate_utilities.h"
+#include "filter_utilities.h"
+#include "isotherm_utilities.h"
+#include "burst_utilities.h"
+#include "roi_utilities.h"
+#include "temp_utilities.h"
+#include "lepton_utilities.h"
+#include "cci.h"
+#include "vospi.h"
+#include "sys_utilities.h"
+#include "system_config.h"
+#include "host_shim.h"
+#include "vospi_capture.h"
+
+
+
+//
+// Pipeline Bench constants
+//
+
+// Frame ring polling period of the rsp_task stand-in (matches RSP_TASK_EVAL_FAST_MSEC)
+#define BENCH_POLL_MSEC      10
+
+// Image processing stages run on each frame
+#define BENCH_STAGE_AGC      0
+#define BENCH_STAGE_DECIMATE 1
+#define BENCH_STAGE_CROP     2
+#define BENCH_STAGE_ROI      3
+#define BENCH_STAGE_ISOTHERM 4
+#define BENCH_STAGE_CHANGE   5
+#define BENCH_STAGE_ALARM    6
+#define BENCH_NUM_STAGES     7
+
+// Command client
+#define BENCH_MAX_CMDS       8
+#define BENCH_RX_BUF_LEN     4096
+
+
+
+//
+// Pipeline Bench variables
+//
+static const char* stage_name[BENCH_NUM_STAGES] = {
+	"agc", "decimate_2", "crop", "roi", "isotherm", "change", "alarm"
+};
+
+static volatile bool bench_running = true;
+static volatile bool bench_rsp_done = false;
+
+// Updated by the rsp_task stand-in
+static sys_stage_time_t stage_time[BENCH_NUM_STAGES];
+static uint32_t rsp_frames = 0;
+static uint32_t rsp_frame_gaps = 0;
+static uint64_t rsp_cpu_usec = 0;
+
+// Commands sent by the client (rsp_task runs when there are any)
+static const char* bench_cmd[BENCH_MAX_CMDS];
+static int bench_num_cmds = 0;
+static int client_sock = -1;
+static pthread_t client_thread;
+
+// Updated by the client
+static volatile uint32_t client_json_rsps = 0;
+static volatile uint32_t client_bin_rsps = 0;
+static volatile uint64_t client_bytes = 0;
+
+
+
+//
+// Pipeline Bench Forward Declarations for internal functions
+//
+static void usage();
+static void bench_rsp_task();
+static bool bench_connect();
+static void bench_cmd_task();
+static void* bench_client(void* arg);
+static void print_stage(const char* name, sys_stage_time_t* stP);
+
+
+
+//
+// Pipeline Bench API
+//
+int main(int argc, char** argv)
+{
+	int c;
+	int run_secs = 10;
+	uint32_t vsync_usec = LEP_FRAME_USEC;
+	bool filter_en = false;
+	int burst_post_frames = -1;
+	int burst_frames = 0;
+	const char* burst_state = "off";
+	uint32_t cap_flags;
+	uint32_t frame_errs, crc_errs;
+	uint64_t lep_cpu_usec;
+	int64_t start_usec, run_usec;
+	int brd_type, if_type;
+	lep_task_stats_t lep_stats;
+	vospi_stats_t vospi_stats;
+	sys_stage_time_t filter_time;
+	host_replay_stats_t replay_stats;
+	host_heap_stats_t spiram_stats, internal_stats, spiram_released_stats;
+	rsp_perf_t rsp_perf;
+	uint32_t json_rsps, bin_rsps;
+	uint64_t rx_bytes;
+	struct rusage ru;
+	
+	(void) esp_timer_get_time();
+	
+	while ((c = getopt(argc, argv, "s:p:FB:C:v")) != -1) {
+		switch (c) {
+			case 's':
+				run_secs = atoi(optarg);
+				break;
+			case 'p':
+				vsync_usec = atoi(optarg);
+				break;
+			case 'F':
+				filter_en = true;
+				break;
+			case 'B':
+				burst_post_frames = atoi(optarg);
+				break;
+			case 'C':
+				if (bench_num_cmds == BENCH_MAX_CMDS) usage();
+				bench_cmd[bench_num_cmds++] = optarg;
+				break;
+			case 'v':
+				host_log_set_level(ESP_LOG_DEBUG);
+				break;
+			default:
+				usage();
+		}
+	}
+	if ((optind != (argc - 1)) || (run_secs < 1) || (vsync_usec < 1000)) {
+		usage();
+	}
+	
+	if (!host_replay_open(argv[optind])) {
+		exit(1);
+	}
+	
+	// lepton_init() always enables telemetry at the location selected in system_config.h
+	cap_flags = host_replay_get_flags();
+#ifdef LEP_TELEM_LOCATION_HEADER
+	if ((cap_flags & (VOSPI_CAP_FLAG_TELEM | VOSPI_CAP_FLAG_HEADER)) != (VOSPI_CAP_FLAG_TELEM | VOSPI_CAP_FLAG_HEADER)) {
+		fprintf(stderr, "The capture must include header telemetry (LEP_TELEM_LOCATION_HEADER is defined)\n");
+		exit(1);
+	}
+#else
+	if ((cap_flags & (VOSPI_CAP_FLAG_TELEM | VOSPI_CAP_FLAG_HEADER)) != VOSPI_CAP_FLAG_TELEM) {
+		fprintf(stderr, "The capture must include footer telemetry (LEP_TELEM_LOCATION_HEADER is not defined)\n");
+		exit(1);
+	}
+#endif
+	
+	// Initialize the system as app_main does
+	ctrl_get_if_mode(&brd_type, &if_type);
+	if (!system_esp_io_init(brd_type, if_type)) {
+		fprintf(stderr, "ESP32 init failed\n");
+		exit(1);
+	}
+	if (!system_peripheral_init(brd_type, if_type)) {
+		fprintf(stderr, "Peripheral init failed\n");
+		exit(1);
+	}
+	if (!system_buffer_init()) {
+		fprintf(stderr, "Buffer init failed\n");
+		exit(1);
+	}
+	
+	if (bench_num_cmds != 0) {
+		// The client sees a closed socket as an error instead of a signal, as lwIP does
+		signal(SIGPIPE, SIG_IGN);
+		if (!bench_connect()) {
+			fprintf(stderr, "Loopback connection failed\n");
+			exit(1);
+		}
+		xTaskCreatePinnedToCore(&bench_cmd_task, "net_cmd_task", 3072, NULL, 1, &task_handle_cmd, 0);
+		xTaskCreatePinnedToCore(&rsp_task, "rsp_task", 2816, NULL, 19, &task_handle_rsp, 0);
+	} else {
+		xTaskCreatePinnedToCore(&bench_rsp_task, "rsp_task", 2816, NULL, 19, &task_handle_rsp, 0);
+	}
+	xTaskCreatePinnedToCore(&lep_task, "lep_task", 2048, NULL, 19, &task_handle_lep, 1);
+	
+	// Let lep_task initialize the Lepton before VSYNC starts
+	vTaskDelay(pdMS_TO_TICKS(100));
+	if (filter_en) {
+		filter_set_config(FILTER_MODE_IIR, FILTER_DEF_STRENGTH, FILTER_DEF_MOTION);
+	}
+	if ((bench_num_cmds != 0) && (pthread_create(&client_thread, NULL, bench_client, NULL) != 0)) {
+		fprintf(stderr, "Client start failed\n");
+		exit(1);
+	}
+	
+	start_usec = esp_timer_get_time();
+	host_vsync_start(vsync_usec);
+	if (burst_post_frames >= 0) {
+		// Capture for the first half of the run and then trigger
+		if (!burst_arm(burst_post_frames)) {
+			fprintf(stderr, "Burst capture could not be started\n");
+		}
+		vTaskDelay(pdMS_TO_TICKS(run_secs * 500));
+		(void) burst_trigger();
+		vTaskDelay(pdMS_TO_TICKS(run_secs * 500));
+		burst_state = burst_get_state_name();
+		burst_frames = burst_get_frame_count();
+	} else {
+		vTaskDelay(pdMS_TO_TICKS(run_secs * 1000));
+	}
+	
+	// Collect statistics while the tasks are still running
+	run_usec = esp_timer_get_time() - start_usec;
+	lep_cpu_usec = host_task_cpu_usec(task_handle_lep);
+	lep_get_stats(&lep_stats);
+	vospi_get_stats(&vospi_stats);
+	vospi_get_crc_errors(&frame_errs, &crc_errs);
+	filter_get_stage_time(&filter_time);
+	rsp_get_perf(&rsp_perf);
+	json_rsps = client_json_rsps;
+	bin_rsps = client_bin_rsps;
+	rx_bytes = client_bytes;
+	host_vsync_stop();
+	host_replay_get_stats(&replay_stats);
+	
+	// Let rsp_task (or its stand-in) release the burst capture ring
+	burst_off();
+	vTaskDelay(pdMS_TO_TICKS(5 * BENCH_POLL_MSEC));
+	host_heap_get_stats(true, &spiram_released_stats);
+	
+	bench_running = false;
+	if (bench_num_cmds != 0) {
+		// rsp_task runs forever
+		rsp_cpu_usec = host_task_cpu_usec(task_handle_rsp);
+		rsp_frames = rsp_perf.images_sent;
+	} else {
+		while (!bench_rsp_done) {
+			vTaskDelay(pdMS_TO_TICKS(BENCH_POLL_MSEC));
+		}
+	}
+	
+	host_heap_get_stats(true, &spiram_stats);
+	host_heap_get_stats(false, &internal_stats);
+	getrusage(RUSAGE_SELF, &ru);
+	
+	printf("\nRun time:              %.2f sec (%u VSYNC periods of %u uSec, %u capture loops)\n",
+	       run_usec / 1000000.0, replay_stats.vsyncs, vsync_usec, replay_stats.loops);
+	printf("Frames published:      %u (%.2f fps)\n", lep_stats.frames, lep_stats.frames * 1000000.0 / run_usec);
+	if (bench_num_cmds != 0) {
+		printf("Images sent:           %u (%.2f fps, %u unchanged)\n", rsp_perf.images_sent,
+		       rsp_perf.images_sent * 1000000.0 / run_usec, rsp_perf.images_unchanged);
+		printf("Responses received:    %u json, %u binary (%llu bytes, %.2f MB/sec)\n", json_rsps, bin_rsps,
+		       (unsigned long long) rx_bytes, rx_bytes / (double) run_usec);
+	} else {
+		printf("Frames processed:      %u (%.2f fps, %u frame number gaps)\n", rsp_frames,
+		       rsp_frames * 1000000.0 / run_usec, rsp_frame_gaps);
+	}
+	printf("Ring overflows:        %u\n", system_lep_frame_overflow_count());
+	printf("Duplicate frames:      %u\n", vospi_get_duplicate_count());
+	printf("CRC errors:            %u\n", crc_errs);
+	printf("Missed frames:         %u\n", lep_stats.missed_frames);
+	printf("Missed VSYNCs:         %u\n", lep_stats.missed_vsyncs);
+	printf("Resyncs:               %u fast, %u slow\n", lep_stats.fast_resyncs, lep_stats.resyncs);
+	printf("Segments:              %u (read errors: discard %u, segment %u, row %u, invalid %u, sequence %u)\n",
+	       vospi_stats.segments, vospi_stats.read_errors[DISCARD], vospi_stats.read_errors[SEGMENT_ERROR],
+	       vospi_stats.read_errors[ROW_ERROR], vospi_stats.read_errors[SEGMENT_INVALID],
+	       vospi_stats.read_errors[SEGMENT_SEQUENCE]);
+	printf("SPI packets:           %u (%u after the segment)\n", replay_stats.packets, replay_stats.late_packets);
+	if (burst_post_frames >= 0) {
+		printf("Burst capture:         %s with %d frames\n", burst_state, burst_frames);
+	}
+	
+	printf("\nStage times (uSec)         count      avg      max\n");
+	print_stage("vospi_transfer_segment", &vospi_stats.xfer);
+	print_stage("filter", &filter_time);
+	if (bench_num_cmds != 0) {
+		print_stage("rsp encode", &rsp_perf.encode);
+		print_stage("rsp send", &rsp_perf.send);
+	} else {
+		for (c=0; c<BENCH_NUM_STAGES; c++) {
+			print_stage(stage_name[c], &stage_time[c]);
+		}
+	}
+	
+	printf("\nTask CPU time:\n");
+	printf("  lep_task  %10.3f sec (%.1f uSec/frame, %.2f%% of one core)\n", lep_cpu_usec / 1000000.0,
+	       (lep_stats.frames != 0) ? (double) lep_cpu_usec / lep_stats.frames : 0.0,
+	       100.0 * lep_cpu_usec / run_usec);
+	printf("  rsp_task  %10.3f sec (%.1f uSec/%s)\n", rsp_cpu_usec / 1000000.0,
+	       (rsp_frames != 0) ? (double) rsp_cpu_usec / rsp_frames : 0.0, (bench_num_cmds != 0) ? "image" : "frame");
+	
+	printf("\nMemory high-water marks:\n");
+	printf("  SPIRAM    %8zu bytes (%u allocations, %zu bytes in use after burst_off)\n", spiram_stats.peak_bytes,
+	       spiram_stats.allocs, spiram_released_stats.cur_bytes);
+	printf("  Internal  %8zu bytes (%u allocations)\n", internal_stats.peak_bytes, internal_stats.allocs);
+	printf("  Max RSS   %8ld kB\n", ru.ru_maxrss);
+	
+	return (lep_stats.frames != 0) ? 0 : 1;
+}
+
+
+
+//
+// Pipeline Bench internal functions
+//
+static void usage()
+{
+	fprintf(stderr, "usage: pipeline_bench [-s seconds] [-p vsync_usec] [-F] [-B post_frames] [-C command]... [-v] capture_file\n");
+	fprintf(stderr, "  -s  run time (default 10 seconds)\n");
+	fprintf(stderr, "  -p  VSYNC period (default %d uSec)\n", LEP_FRAME_USEC);
+	fprintf(stderr, "  -F  enable the temporal filter\n");
+	fprintf(stderr, "  -B  run a burst capture, triggered half way through, with post_frames after the trigger\n");
+	fprintf(stderr, "  -C  json command sent to the firmware's rsp_task through a loopback socket (up to %d)\n", BENCH_MAX_CMDS);
+	fprintf(stderr, "  -v  debug logging\n");
+	exit(1);
+}
+
+
+/**
+ * Stand-in for rsp_task.  Takes every published frame from the ring and runs the image
+ * processing stages on it.
+ */
+static void bench_rsp_task()
+{
+	alarm_rule_t rule;
+	alarm_event_t event;
+	roi_def_t roi;
+	roi_stats_t roi_stats;
+	lep_buffer_t* lep_bufP;
+	uint32_t last_frame_num = 0;
+	uint16_t lo, hi;
+	int enc, len, pixels, res;
+	int64_t t;
+	
+	(void) roi_init();
+	(void) alarm_init();
+	(void) agc_init();
+	(void) decimate_init();
+	(void) crop_init();
+	(void) change_init();
+	(void) isotherm_init();
+	
+	roi.r1 = 30;
+	roi.c1 = 40;
+	roi.r2 = 89;
+	roi.c2 = 119;
+	roi.maskP = NULL;
+	roi_set_regions(&roi, 1);
+	
+	memset(&rule, 0, sizeof(rule));
+	rule.type = ALARM_TYPE_COUNT_ABOVE;
+	rule.roi = 0;
+	rule.use_temp = true;
+	rule.temp = 3500;
+	rule.count = 100;
+	rule.frames = 3;
+	alarm_set_rules(&rule, 1);
+	
+	while (bench_running) {
+		lep_request_frames(LEP_REQ_SRC_RSP, true);
+		lep_request_frames(LEP_REQ_SRC_BURST, burst_capturing());
+		
+		while ((lep_bufP = system_lep_frame_consume(false)) != NULL) {
+			rsp_frames++;
+			if ((last_frame_num != 0) && (lep_bufP->frame_num != (last_frame_num + 1))) {
+				rsp_frame_gaps++;
+			}
+			last_frame_num = lep_bufP->frame_num;
+			
+			t = esp_timer_get_time();
+			(void) agc_process(lep_bufP, &lo, &hi);
+			system_stage_time_add(&stage_time[BENCH_STAGE_AGC], t);
+			
+			t = esp_timer_get_time();
+			(void) decimate_process(lep_bufP->lep_bufferP, DECIMATE_2, DECIMATE_MODE_AVG, NULL, NULL);
+			system_stage_time_add(&stage_time[BENCH_STAGE_DECIMATE], t);
+			
+			t = esp_timer_get_time();
+			(void) crop_process(lep_bufP->lep_bufferP, 30, 40, 89, 119, NULL, NULL);
+			system_stage_time_add(&stage_time[BENCH_STAGE_CROP], t);
+			
+			t = esp_timer_get_time();
+			(void) roi_compute(lep_bufP->lep_bufferP, &roi_stats);
+			system_stage_time_add(&stage_time[BENCH_STAGE_ROI], t);
+			
+			t = esp_timer_get_time();
+			res = temp_get_resolution(lep_bufP);
+			(void) isotherm_process(lep_bufP->lep_bufferP, temp_c100_to_counts(3000, res),
+			                        temp_c100_to_counts(4000, res), &enc, &len, &pixels);
+			system_stage_time_add(&stage_time[BENCH_STAGE_ISOTHERM], t);
+			
+			t = esp_timer_get_time();
+			(void) change_detect(lep_bufP->lep_bufferP, 50, 100);
+			change_set_reference(lep_bufP->lep_bufferP);
+			system_stage_time_add(&stage_time[BENCH_STAGE_CHANGE], t);
+			
+			t = esp_timer_get_time();
+			if (alarm_process(lep_bufP)) {
+				while (alarm_get_event(&event)) {}
+			}
+			system_stage_time_add(&stage_time[BENCH_STAGE_ALARM], t);
+			
+			system_lep_frame_release();
+		}
+		
+		burst_release();
+		vTaskDelay(pdMS_TO_TICKS(BENCH_POLL_MSEC));
+	}
+	
+	lep_request_frames(LEP_REQ_SRC_RSP, false);
+	rsp_cpu_usec = host_task_cpu_usec(xTaskGetCurrentTaskHandle());
+	bench_rsp_done = true;
+	vTaskDelete(NULL);
+}
+
+
+/**
+ * Connect the client to the command socket through the loopback interface
+ */
+static bool bench_connect()
+{
+	int listen_sock;
+	int sock;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	
+	listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+	if (listen_sock < 0) return false;
+	if ((bind(listen_sock, (struct sockaddr*) &addr, sizeof(addr)) != 0) ||
+	    (getsockname(listen_sock, (struct sockaddr*) &addr, &addr_len) != 0) ||
+	    (listen(listen_sock, 1) != 0)) {
+		close(listen_sock);
+		return false;
+	}
+	
+	client_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+	if ((client_sock < 0) || (connect(client_sock, (struct sockaddr*) &addr, sizeof(addr)) != 0)) {
+		close(listen_sock);
+		return false;
+	}
+	sock = accept(listen_sock, NULL, NULL);
+	close(listen_sock);
+	if (sock < 0) return false;
+	
+	host_net_set_socket(sock);
+	return true;
+}
+
+
+/**
+ * Stand-in for net_cmd_task.  Receives commands from the client.
+ */
+static void bench_cmd_task()
+{
+	char rx_buffer[256];
+	int len;
+	
+	init_command_processor();
+	
+	while (bench_running) {
+		len = recv(net_cmd_get_socket(), rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT);
+		if (len > 0) {
+			push_rx_data(rx_buffer, len);
+			while (process_rx_data()) {}
+		} else if ((len == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+			break;
+		} else {
+			vTaskDelay(pdMS_TO_TICKS(50));
+		}
+	}
+	
+	vTaskDelete(NULL);
+}
+
+
+/**
+ * Client thread.  Sends the commands and then reads and counts responses until the
+ * connection fails.
+ */
+static void* bench_client(void* arg)
+{
+	char start = CMD_JSON_STRING_START;
+	char stop = CMD_JSON_STRING_STOP;
+	uint8_t buf[BENCH_RX_BUF_LEN];
+	uint8_t hdr[8];
+	int hdr_len = 0;
+	int i, len;
+	bool in_json = false;
+	uint32_t skip = 0;
+	
+	for (i=0; i<bench_num_cmds; i++) {
+		len = strlen(bench_cmd[i]);
+		if ((send(client_sock, &start, 1, 0) != 1) ||
+		    (send(client_sock, bench_cmd[i], len, 0) != len) ||
+		    (send(client_sock, &stop, 1, 0) != 1)) {
+			fprintf(stderr, "Client send failed\n");
+			return NULL;
+		}
+	}
+	
+	// Responses are json delimited by start and stop bytes or binary with their length in a header
+	while ((len = recv(client_sock, buf, sizeof(buf), 0)) > 0) {
+		client_bytes += len;
+		for (i=0; i<len; i++) {
+			if (skip != 0) {
+				skip--;
+			} else if (hdr_len != 0) {
+				hdr[hdr_len++] = buf[i];
+				if (hdr_len == sizeof(hdr)) {
+					// Skip the rest of the header and the payload
+					skip = (hdr[2] | (hdr[3] << 8)) - sizeof(hdr);
+					skip += hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) | ((uint32_t) hdr[7] << 24);
+					hdr_len = 0;
+					client_bin_rsps++;
+				}
+			} else if (in_json) {
+				if (buf[i] == CMD_JSON_STRING_STOP) {
+					in_json = false;
+					client_json_rsps++;
+				}
+			} else if (buf[i] == CMD_JSON_STRING_START) {
+				in_json = true;
+			} else if (buf[i] == CMD_BINARY_START) {
+				hdr[hdr_len++] = buf[i];
+			}
+		}
+	}
+	
+	return NULL;
+}
+
+
+static void print_stage(const char* name, sys_stage_time_t* stP)
+{
+	printf("  %-22s %8u %8.1f %8u\n", name, stP->count,
+	       (stP->count != 0) ? (double) stP->total_usec / stP->count : 0.0, stP->max_usec);
+}
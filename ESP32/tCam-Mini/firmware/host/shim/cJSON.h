@@ -0,0 +1,94 @@
+/*
+ * Host shim: cJSON
+ *
+ * The subset of the cJSON API (the ESP-IDF json component) used by json_utilities,
+ * implemented in cjson_shim.c.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef cJSON__h
+#define cJSON__h
+
+#include <stddef.h>
+
+
+//
+// cJSON constants
+//
+
+// Item types
+#define cJSON_Invalid       (0)
+#define cJSON_False         (1 << 0)
+#define cJSON_True          (1 << 1)
+#define cJSON_NULL          (1 << 2)
+#define cJSON_Number        (1 << 3)
+#define cJSON_String        (1 << 4)
+#define cJSON_Array         (1 << 5)
+#define cJSON_Object        (1 << 6)
+#define cJSON_Raw           (1 << 7)
+
+// Item flags
+#define cJSON_IsReference   256
+#define cJSON_StringIsConst 512
+
+
+
+//
+// cJSON typedefs
+//
+typedef struct cJSON {
+	struct cJSON* next;
+	struct cJSON* prev;
+	struct cJSON* child;
+	int type;
+	char* valuestring;
+	int valueint;
+	double valuedouble;
+	char* string;
+} cJSON;
+
+typedef int cJSON_bool;
+
+
+
+//
+// cJSON API
+//
+cJSON* cJSON_Parse(const char* value);
+const char* cJSON_GetErrorPtr();
+cJSON_bool cJSON_PrintPreallocated(cJSON* item, char* buffer, const int length, const cJSON_bool format);
+void cJSON_Delete(cJSON* item);
+
+int cJSON_GetArraySize(const cJSON* array);
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index);
+cJSON* cJSON_GetObjectItem(const cJSON* const object, const char* const string);
+cJSON_bool cJSON_HasObjectItem(const cJSON* object, const char* string);
+char* cJSON_GetStringValue(const cJSON* const item);
+cJSON_bool cJSON_IsArray(const cJSON* const item);
+cJSON_bool cJSON_IsString(const cJSON* const item);
+
+cJSON* cJSON_CreateObject();
+cJSON* cJSON_CreateArray();
+cJSON* cJSON_CreateStringReference(const char* string);
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item);
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item);
+cJSON* cJSON_AddNumberToObject(cJSON* const object, const char* const name, const double number);
+cJSON* cJSON_AddStringToObject(cJSON* const object, const char* const name, const char* const string);
+
+#endif /* cJSON__h */
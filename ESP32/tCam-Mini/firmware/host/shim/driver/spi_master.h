@@ -0,0 +1,91 @@
+/*
+ * Host shim: ESP-IDF SPI master driver
+ *
+ * Lepton VoSPI transactions are fed from a recorded packet stream (see spi_replay.c).
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef SPI_MASTER_H
+#define SPI_MASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+	SPI1_HOST = 0,
+	HSPI_HOST = 1,
+	VSPI_HOST = 2
+} spi_host_device_t;
+
+typedef struct {
+	int mosi_io_num;
+	int miso_io_num;
+	int sclk_io_num;
+	int quadwp_io_num;
+	int quadhd_io_num;
+	int max_transfer_sz;
+	uint32_t flags;
+	int intr_flags;
+} spi_bus_config_t;
+
+#define SPI_DEVICE_HALFDUPLEX (1 << 4)
+
+typedef struct {
+	uint8_t command_bits;
+	uint8_t address_bits;
+	uint8_t dummy_bits;
+	uint8_t mode;
+	uint16_t duty_cycle_pos;
+	uint16_t cs_ena_pretrans;
+	uint8_t cs_ena_posttrans;
+	int clock_speed_hz;
+	int input_delay_ns;
+	int spics_io_num;
+	uint32_t flags;
+	int queue_size;
+	void (*pre_cb)(void*);
+	void (*post_cb)(void*);
+} spi_device_interface_config_t;
+
+typedef struct {
+	uint32_t flags;
+	uint16_t cmd;
+	uint64_t addr;
+	size_t length;
+	size_t rxlength;
+	void* user;
+	const void* tx_buffer;
+	void* rx_buffer;
+} spi_transaction_t;
+
+typedef struct host_spi_device* spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* bus_config, int dma_chan);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* dev_config,
+                             spi_device_handle_t* handle);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans_desc,
+                                 TickType_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans_desc,
+                                      TickType_t ticks_to_wait);
+
+#endif /* SPI_MASTER_H */
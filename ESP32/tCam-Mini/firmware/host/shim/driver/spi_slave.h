@@ -0,0 +1,61 @@
+/*
+ * Host shim: ESP-IDF SPI slave driver
+ *
+ * The serial interface host is not simulated.  Transactions complete immediately.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef SPI_SLAVE_H
+#define SPI_SLAVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/spi_master.h"
+
+typedef struct spi_slave_transaction_t spi_slave_transaction_t;
+typedef void (*slave_transaction_cb_t)(spi_slave_transaction_t* trans);
+
+typedef struct {
+	int spics_io_num;
+	uint32_t flags;
+	int queue_size;
+	uint8_t mode;
+	slave_transaction_cb_t post_setup_cb;
+	slave_transaction_cb_t post_trans_cb;
+} spi_slave_interface_config_t;
+
+struct spi_slave_transaction_t {
+	size_t length;
+	size_t trans_len;
+	const void* tx_buffer;
+	void* rx_buffer;
+	void* user;
+};
+
+esp_err_t spi_slave_initialize(spi_host_device_t host, const spi_bus_config_t* bus_config,
+                               const spi_slave_interface_config_t* slave_config, int dma_chan);
+esp_err_t spi_slave_free(spi_host_device_t host);
+esp_err_t spi_slave_queue_trans(spi_host_device_t host, const spi_slave_transaction_t* trans_desc,
+                                TickType_t ticks_to_wait);
+esp_err_t spi_slave_get_trans_result(spi_host_device_t host, spi_slave_transaction_t** trans_desc,
+                                     TickType_t ticks_to_wait);
+
+#endif /* SPI_SLAVE_H */
@@ -0,0 +1,53 @@
+/*
+ * Host shim: ESP-IDF OTA operations
+ *
+ * Only the application description is used by the host build.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_OTA_OPS_H
+#define ESP_OTA_OPS_H
+
+#include <stdint.h>
+
+
+//
+// OTA typedefs
+//
+typedef struct {
+	uint32_t magic_word;
+	uint32_t secure_version;
+	uint32_t reserv1[2];
+	char version[32];
+	char project_name[32];
+	char time[16];
+	char date[16];
+	char idf_ver[32];
+	uint8_t app_elf_sha256[32];
+	uint32_t reserv2[20];
+} esp_app_desc_t;
+
+
+
+//
+// OTA API
+//
+const esp_app_desc_t* esp_ota_get_app_description();
+
+#endif /* ESP_OTA_OPS_H */
@@ -0,0 +1,37 @@
+/*
+ * Host shim: ESP-IDF system definitions
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+
+// Reached indirectly through esp_system.h and the FreeRTOS headers in ESP-IDF
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac);
+
+#endif /* ESP_SYSTEM_H */
@@ -0,0 +1,48 @@
+/*
+ * Host shim: FreeRTOS base definitions
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_system.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE   0
+#define pdTRUE    1
+#define pdPASS    pdTRUE
+#define pdFAIL    pdFALSE
+
+#define configTICK_RATE_HZ   1000
+#define portMAX_DELAY        ((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS     portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms)    ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+// ISRs run in their own thread on the host and the woken task is scheduled by the OS
+#define portYIELD_FROM_ISR()
+
+#endif /* FREERTOS_H */
@@ -0,0 +1,31 @@
+/*
+ * Host shim: ESP-IDF mDNS service
+ *
+ * The host does not advertise itself; set_wifi only renames it.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MDNS_H
+#define MDNS_H
+
+#include "esp_err.h"
+
+esp_err_t mdns_hostname_set(const char* hostname);
+
+#endif /* MDNS_H */
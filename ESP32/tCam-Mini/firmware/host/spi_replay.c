@@ -0,0 +1,285 @@
+/*
+ * Host shim: ESP-IDF SPI master and slave drivers
+ *
+ * The SPI master replays a VoSPI capture (see vospi_capture.h).  Packets read during a
+ * VSYNC period come from the capture block for that period, wrapping to the start of
+ * the capture at its end.  Once a block is exhausted, or before a capture is opened,
+ * discard packets are returned just as the Lepton does when it has no data.
+ * Transactions complete immediately so measured times are CPU time only.
+ *
+ * The SPI slave (serial interface host) is not simulated.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/spi_master.h"
+#include "driver/spi_slave.h"
+#include "esp_log.h"
+#include "host_shim.h"
+#include "vospi_capture.h"
+
+
+
+//
+// SPI Replay constants
+//
+#define SPI_MAX_QUEUE 64
+
+
+
+//
+// SPI Replay typedefs
+//
+struct host_spi_device {
+	int queue_size;
+	int q_push;
+	int q_pop;
+	int q_count;
+	spi_transaction_t* queue[SPI_MAX_QUEUE];
+};
+
+
+
+//
+// SPI Replay variables
+//
+static const char* TAG = "spi_replay";
+
+static vospi_cap_header_t cap_hdr;
+static uint8_t* cap_dataP = NULL;
+
+static uint32_t cur_vsync = 0;
+static int cur_pkt;
+static host_replay_stats_t replay_stats;
+
+static const spi_slave_transaction_t* slave_trans = NULL;
+
+
+
+//
+// SPI Replay Forward Declarations for internal functions
+//
+static void read_packet(uint8_t* bufP, size_t len);
+
+
+
+//
+// SPI Replay API
+//
+
+/**
+ * Load a capture file to replay
+ */
+bool host_replay_open(const char* path)
+{
+	FILE* fp;
+	size_t len;
+	
+	if ((fp = fopen(path, "rb")) == NULL) {
+		ESP_LOGE(TAG, "Could not open %s", path);
+		return false;
+	}
+	
+	if ((fread(&cap_hdr, sizeof(cap_hdr), 1, fp) != 1) ||
+	    (cap_hdr.magic != VOSPI_CAP_MAGIC) || (cap_hdr.version != VOSPI_CAP_VERSION) ||
+	    (cap_hdr.pkts_per_vsync == 0) || (cap_hdr.num_vsyncs == 0)) {
+		ESP_LOGE(TAG, "%s is not a VoSPI capture", path);
+		fclose(fp);
+		return false;
+	}
+	
+	len = (size_t) cap_hdr.num_vsyncs * cap_hdr.pkts_per_vsync * VOSPI_CAP_PKT_LEN;
+	cap_dataP = malloc(len);
+	if ((cap_dataP == NULL) || (fread(cap_dataP, 1, len, fp) != len)) {
+		ESP_LOGE(TAG, "Could not read %s", path);
+		free(cap_dataP);
+		cap_dataP = NULL;
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+	
+	ESP_LOGI(TAG, "Loaded %u VSYNC periods (%u packets each, %u uSec)", cap_hdr.num_vsyncs,
+	         cap_hdr.pkts_per_vsync, cap_hdr.vsync_usec);
+	
+	return true;
+}
+
+
+/**
+ * Return the capture's VOSPI_CAP_FLAG_xxx flags
+ */
+uint32_t host_replay_get_flags()
+{
+	return cap_hdr.flags;
+}
+
+
+/**
+ * Return the number of VSYNC periods in the capture
+ */
+uint32_t host_replay_get_num_vsyncs()
+{
+	return cap_hdr.num_vsyncs;
+}
+
+
+void host_replay_get_stats(host_replay_stats_t* statsP)
+{
+	*statsP = replay_stats;
+	statsP->vsyncs = cur_vsync;
+}
+
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* bus_config, int dma_chan)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* dev_config,
+                             spi_device_handle_t* handle)
+{
+	struct host_spi_device* devP;
+	
+	if (dev_config->queue_size > SPI_MAX_QUEUE) return ESP_ERR_INVALID_ARG;
+	
+	devP = calloc(1, sizeof(struct host_spi_device));
+	if (devP == NULL) return ESP_ERR_NO_MEM;
+	devP->queue_size = dev_config->queue_size;
+	
+	*handle = devP;
+	return ESP_OK;
+}
+
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc)
+{
+	read_packet(trans_desc->rx_buffer, trans_desc->rxlength / 8);
+	return ESP_OK;
+}
+
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc)
+{
+	return spi_device_polling_transmit(handle, trans_desc);
+}
+
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans_desc,
+                                 TickType_t ticks_to_wait)
+{
+	if (handle->q_count == handle->queue_size) return ESP_ERR_TIMEOUT;
+	
+	read_packet(trans_desc->rx_buffer, trans_desc->rxlength / 8);
+	handle->queue[handle->q_push] = trans_desc;
+	handle->q_push = (handle->q_push + 1) % SPI_MAX_QUEUE;
+	handle->q_count++;
+	
+	return ESP_OK;
+}
+
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans_desc,
+                                      TickType_t ticks_to_wait)
+{
+	if (handle->q_count == 0) return ESP_ERR_TIMEOUT;
+	
+	*trans_desc = handle->queue[handle->q_pop];
+	handle->q_pop = (handle->q_pop + 1) % SPI_MAX_QUEUE;
+	handle->q_count--;
+	
+	return ESP_OK;
+}
+
+
+esp_err_t spi_slave_initialize(spi_host_device_t host, const spi_bus_config_t* bus_config,
+                               const spi_slave_interface_config_t* slave_config, int dma_chan)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t spi_slave_free(spi_host_device_t host)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t spi_slave_queue_trans(spi_host_device_t host, const spi_slave_transaction_t* trans_desc,
+                                TickType_t ticks_to_wait)
+{
+	slave_trans = trans_desc;
+	return ESP_OK;
+}
+
+
+esp_err_t spi_slave_get_trans_result(spi_host_device_t host, spi_slave_transaction_t** trans_desc,
+                                     TickType_t ticks_to_wait)
+{
+	if (slave_trans == NULL) return ESP_ERR_TIMEOUT;
+	
+	*trans_desc = (spi_slave_transaction_t*) slave_trans;
+	slave_trans = NULL;
+	return ESP_OK;
+}
+
+
+
+//
+// SPI Replay internal functions
+//
+
+/**
+ * Return the next packet the Lepton would output during the current VSYNC period
+ */
+static void read_packet(uint8_t* bufP, size_t len)
+{
+	uint32_t v;
+	uint32_t block;
+	
+	if (len > VOSPI_CAP_PKT_LEN) len = VOSPI_CAP_PKT_LEN;
+	replay_stats.packets++;
+	
+	v = host_vsync_count();
+	if ((cap_dataP == NULL) || (v == 0)) {
+		memset(bufP, 0xFF, len);
+		return;
+	}
+	
+	if (v != cur_vsync) {
+		// A new segment starts with each VSYNC edge
+		cur_vsync = v;
+		cur_pkt = 0;
+		if (((v - 1) % cap_hdr.num_vsyncs) == 0) {
+			if (v != 1) replay_stats.loops++;
+		}
+	}
+	
+	if (cur_pkt < cap_hdr.pkts_per_vsync) {
+		block = (v - 1) % cap_hdr.num_vsyncs;
+		memcpy(bufP, cap_dataP + (((size_t) block * cap_hdr.pkts_per_vsync) + cur_pkt) * VOSPI_CAP_PKT_LEN, len);
+		cur_pkt++;
+	} else {
+		replay_stats.late_packets++;
+		memset(bufP, 0xFF, len);
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * Host VoSPI driver microbenchmark
+ *
+ * Calls the VoSPI driver directly (without lep_task, the VSYNC thread or any delays)
+ * for every VSYNC period of a capture and reports the time spent reading and unpacking
+ * segments and finishing frames.  This isolates the per-pixel work done as packets are
+ * copied into the frame buffer.
+ *
+ * usage: vospi_bench [-r repeats] capture_file
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "ctrl_task.h"
+#include "lepton_utilities.h"
+#include "vospi.h"
+#include "sys_utilities.h"
+#include "system_config.h"
+#include "host_shim.h"
+#include "vospi_capture.h"
+
+
+
+//
+// VoSPI Bench Forward Declarations for internal functions
+//
+static void usage();
+
+
+
+//
+// VoSPI Bench API
+//
+int main(int argc, char** argv)
+{
+	int c;
+	int repeats = 20;
+	int brd_type, if_type;
+	int pixel_offset, pixel_len;
+	bool telem_valid;
+	uint32_t cap_flags, num_vsyncs;
+	uint32_t i, n, r;
+	uint32_t frames = 0;
+	uint32_t pass_frames;
+	uint32_t segments = 0;
+	int64_t t, seg_usec = 0, frame_usec = 0;
+	int64_t pass_usec;
+	double best_usec = 0;
+	lep_buffer_t frame;
+	
+	(void) esp_timer_get_time();
+	
+	while ((c = getopt(argc, argv, "r:")) != -1) {
+		switch (c) {
+			case 'r':
+				repeats = atoi(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+	if ((optind != (argc - 1)) || (repeats < 1)) {
+		usage();
+	}
+	
+	if (!host_replay_open(argv[optind])) {
+		exit(1);
+	}
+	cap_flags = host_replay_get_flags();
+	num_vsyncs = host_replay_get_num_vsyncs();
+	
+	ctrl_get_if_mode(&brd_type, &if_type);
+	if (!system_esp_io_init(brd_type, if_type)) {
+		fprintf(stderr, "ESP32 init failed\n");
+		exit(1);
+	}
+	if (vospi_init(BRD_W_LEP_CSN_IO) != ESP_OK) {
+		fprintf(stderr, "VoSPI init failed\n");
+		exit(1);
+	}
+	vospi_include_telem((cap_flags & VOSPI_CAP_FLAG_TELEM) != 0, (cap_flags & VOSPI_CAP_FLAG_HEADER) != 0);
+	
+	frame.lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+	frame.lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+#ifdef LEP_HISTOGRAM_BINS
+	frame.lep_histP = heap_caps_malloc(LEP_HISTOGRAM_BINS*2, MALLOC_CAP_SPIRAM);
+#endif
+	vospi_set_frame_buffer(&frame);
+	
+	// Each pass replays the whole capture.  The fastest pass is the least disturbed by
+	// other activity on the host.
+	n = num_vsyncs * repeats;
+	for (r=0; r<repeats; r++) {
+		pass_usec = 0;
+		pass_frames = 0;
+		for (i=0; i<num_vsyncs; i++) {
+			(void) host_vsync_step();
+			t = esp_timer_get_time();
+			if (vospi_transfer_segment(t)) {
+				pass_usec += esp_timer_get_time() - t;
+				t = esp_timer_get_time();
+				vospi_get_frame(&frame);
+				frame_usec += esp_timer_get_time() - t;
+				pass_frames++;
+			} else {
+				pass_usec += esp_timer_get_time() - t;
+			}
+			if (vospi_get_completed_segment(&pixel_offset, &pixel_len, &telem_valid) != 0) {
+				segments++;
+			}
+		}
+		
+		seg_usec += pass_usec;
+		frames += pass_frames;
+		if ((pass_frames != 0) && ((best_usec == 0) || (((double) pass_usec / pass_frames) < best_usec))) {
+			best_usec = (double) pass_usec / pass_frames;
+		}
+	}
+	
+	printf("VSYNC periods:    %u (%u repeats of the capture)\n", n, repeats);
+	printf("Segments:         %u\n", segments);
+	printf("Frames:           %u\n", frames);
+	printf("Segment reads:    %.2f uSec per VSYNC period\n", (double) seg_usec / n);
+	printf("Per frame:        %.2f uSec reading segments (fastest pass %.2f uSec), %.2f uSec in vospi_get_frame\n",
+	       (frames != 0) ? (double) seg_usec / frames : 0.0, best_usec,
+	       (frames != 0) ? (double) frame_usec / frames : 0.0);
+	
+	return (frames != 0) ? 0 : 1;
+}
+
+
+
+//
+// VoSPI Bench internal functions
+//
+static void usage()
+{
+	fprintf(stderr, "usage: vospi_bench [-r repeats] capture_file\n");
+	fprintf(stderr, "  -r  number of times to replay the capture (default 20)\n");
+	exit(1);
+}
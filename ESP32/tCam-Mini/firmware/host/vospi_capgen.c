@@ -0,0 +1,343 @@
+/*
+ * VoSPI capture generator
+ *
+ * Writes a synthetic Lepton 3.5 VoSPI capture (see vospi_capture.h) for the host
+ * benchmark when no recorded capture is available.  Each unique frame takes
+ * LEP_VSYNC_PER_FRAME VSYNC periods: four valid segments followed by segments with the
+ * invalid segment number 0.  The image is a noisy room temperature background with a
+ * warm target moving in a circle.  Duplicate frames and packets with bad CRCs may be
+ * inserted to exercise those paths.
+ *
+ * usage: vospi_capgen [-n frames] [-t none|footer|header] [-D dup_every] [-e crc_err_every]
+ *                     [-d discards] -o capture_file
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "lep_task.h"
+#include "lepton_utilities.h"
+#include "vospi.h"
+#include "vospi_capture.h"
+
+
+
+//
+// Capture Generator constants
+//
+
+// Image
+#define CAPGEN_BKG_K100      29515    /* 22 °C */
+#define CAPGEN_TARGET_K100   30715    /* 34 °C */
+#define CAPGEN_TARGET_RADIUS 12
+#define CAPGEN_ORBIT_RADIUS  35
+#define CAPGEN_ORBIT_FRAMES  90
+#define CAPGEN_NOISE_COUNTS  16
+
+// Extra discard packets at the end of each VSYNC period block
+#define CAPGEN_PAD_PKTS      2
+
+
+
+//
+// Capture Generator variables
+//
+static uint16_t img[LEP_NUM_PIXELS];
+static uint16_t telem[LEP_TEL_LINES * (LEP_WIDTH/2)];
+static uint32_t rand_state = 1;
+
+
+
+//
+// Capture Generator Forward Declarations for internal functions
+//
+static void usage();
+static void gen_image(int n);
+static void gen_telem(uint32_t frame_count);
+static void write_segment(FILE* fp, int seg_num, int ttt, int lines, int pkts_per_vsync, int discards,
+                          int telem_loc, bool crc_err);
+static void put_packet(uint8_t* pktP, int line, int ttt, uint16_t* wordsP);
+static uint16_t packet_crc(uint8_t* pktP);
+static uint32_t next_rand();
+
+
+
+//
+// Capture Generator API
+//
+int main(int argc, char** argv)
+{
+	char* out_path = NULL;
+	int num_frames = 90;
+	int telem_loc = VOSPI_CAP_FLAG_TELEM;
+	int dup_every = 0;
+	int crc_err_every = 0;
+	int discards = 2;
+	int lines, pkts_per_vsync;
+	int c, f, n, v;
+	uint32_t frame_count = 0;
+	bool dup;
+	FILE* fp;
+	vospi_cap_header_t hdr;
+	
+	while ((c = getopt(argc, argv, "n:t:D:e:d:o:")) != -1) {
+		switch (c) {
+			case 'n':
+				num_frames = atoi(optarg);
+				break;
+			case 't':
+				if (strcmp(optarg, "none") == 0) {
+					telem_loc = 0;
+				} else if (strcmp(optarg, "footer") == 0) {
+					telem_loc = VOSPI_CAP_FLAG_TELEM;
+				} else if (strcmp(optarg, "header") == 0) {
+					telem_loc = VOSPI_CAP_FLAG_TELEM | VOSPI_CAP_FLAG_HEADER;
+				} else {
+					usage();
+				}
+				break;
+			case 'D':
+				dup_every = atoi(optarg);
+				break;
+			case 'e':
+				crc_err_every = atoi(optarg);
+				break;
+			case 'd':
+				discards = atoi(optarg);
+				break;
+			case 'o':
+				out_path = optarg;
+				break;
+			default:
+				usage();
+		}
+	}
+	if ((out_path == NULL) || (num_frames < 1) || (discards < 0)) {
+		usage();
+	}
+	
+	lines = (telem_loc != 0) ? LEP_TEL_PKTS_PER_SEG : LEP_NOTEL_PKTS_PER_SEG;
+	pkts_per_vsync = discards + lines + CAPGEN_PAD_PKTS;
+	
+	if ((fp = fopen(out_path, "wb")) == NULL) {
+		fprintf(stderr, "Could not create %s\n", out_path);
+		exit(1);
+	}
+	
+	hdr.magic = VOSPI_CAP_MAGIC;
+	hdr.version = VOSPI_CAP_VERSION;
+	hdr.pkts_per_vsync = pkts_per_vsync;
+	hdr.vsync_usec = LEP_FRAME_USEC;
+	hdr.num_vsyncs = num_frames * LEP_VSYNC_PER_FRAME;
+	hdr.flags = telem_loc;
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	
+	for (f=0; f<num_frames; f++) {
+		// A duplicate repeats the previous frame (including its frame counter)
+		dup = (dup_every != 0) && (f != 0) && ((f % dup_every) == 0);
+		if (!dup) {
+			gen_image(f);
+			gen_telem(++frame_count);
+		}
+		
+		for (v=0; v<LEP_VSYNC_PER_FRAME; v++) {
+			n = (v < 4) ? v + 1 : 0;
+			write_segment(fp, (v < 4) ? v + 1 : 1, n, lines, pkts_per_vsync, discards, telem_loc,
+			              (crc_err_every != 0) && (f != 0) && ((f % crc_err_every) == 0) && (v == 1));
+		}
+	}
+	
+	fclose(fp);
+	printf("Wrote %d frames (%d VSYNC periods) to %s\n", num_frames, hdr.num_vsyncs, out_path);
+	
+	return 0;
+}
+
+
+
+//
+// Capture Generator internal functions
+//
+static void usage()
+{
+	fprintf(stderr, "usage: vospi_capgen [-n frames] [-t none|footer|header] [-D dup_every] [-e crc_err_every]\n");
+	fprintf(stderr, "                    [-d discards] -o capture_file\n");
+	exit(1);
+}
+
+
+/**
+ * Generate image n
+ */
+static void gen_image(int n)
+{
+	double a = (2.0 * M_PI * n) / CAPGEN_ORBIT_FRAMES;
+	int tr = (LEP_HEIGHT / 2) + (int) (CAPGEN_ORBIT_RADIUS * sin(a) / 2);
+	int tc = (LEP_WIDTH / 2) + (int) (CAPGEN_ORBIT_RADIUS * cos(a));
+	int r, c, dr, dc;
+	uint16_t v;
+	
+	for (r=0; r<LEP_HEIGHT; r++) {
+		for (c=0; c<LEP_WIDTH; c++) {
+			// Background with a vertical gradient and noise
+			v = CAPGEN_BKG_K100 + (r * 2) + (next_rand() % CAPGEN_NOISE_COUNTS);
+			dr = r - tr;
+			dc = c - tc;
+			if (((dr * dr) + (dc * dc)) <= (CAPGEN_TARGET_RADIUS * CAPGEN_TARGET_RADIUS)) {
+				v += CAPGEN_TARGET_K100 - CAPGEN_BKG_K100;
+			}
+			img[r * LEP_WIDTH + c] = v;
+		}
+	}
+}
+
+
+/**
+ * Generate the telemetry for a frame
+ */
+static void gen_telem(uint32_t frame_count)
+{
+	memset(telem, 0, sizeof(telem));
+	telem[LEP_TEL_REV] = 0x000E;
+	telem[LEP_TEL_TC_LOW] = (frame_count * 37) & 0xFFFF;
+	telem[LEP_TEL_TC_HIGH] = (frame_count * 37) >> 16;
+	telem[LEP_TEL_STATUS_LOW] = LEP_FFC_STATE_CMPL;
+	telem[LEP_TEL_FC_LOW] = frame_count & 0xFFFF;
+	telem[LEP_TEL_FC_HIGH] = frame_count >> 16;
+	telem[LEP_TEL_FPA_T_K100] = 30315;
+	telem[LEP_TEL_HSE_T_K100] = 30215;
+	telem[LEP_TEL_EMISSIVITY] = 8192;
+	telem[LEP_TEL_BG_T_K100] = 29515;
+	telem[LEP_TEL_TLIN_ENABLE] = 1;
+	telem[LEP_TEL_TLIN_RES] = 1;
+}
+
+
+/**
+ * Write one VSYNC period's block.  seg_num selects the portion of the frame and ttt is the
+ * segment number sent in packet 20 (0 for an invalid segment).
+ */
+static void write_segment(FILE* fp, int seg_num, int ttt, int lines, int pkts_per_vsync, int discards,
+                          int telem_loc, bool crc_err)
+{
+	uint8_t pkt[LEP_PKT_LENGTH];
+	uint16_t* wordsP;
+	int i, line, g, p;
+	
+	// Discard packets preceding the segment
+	memset(pkt, 0, sizeof(pkt));
+	pkt[0] = 0x0F;
+	for (i=0; i<discards; i++) {
+		fwrite(pkt, sizeof(pkt), 1, fp);
+	}
+	
+	for (line=0; line<lines; line++) {
+		// Line within the frame's lines (image and telemetry)
+		g = ((seg_num - 1) * lines) + line;
+		if (telem_loc & VOSPI_CAP_FLAG_HEADER) {
+			p = g - LEP_TEL_LINES;
+		} else {
+			p = g;
+		}
+		
+		if ((telem_loc != 0) && ((p < 0) || (p >= LEP_IMG_LINES))) {
+			// Telemetry line (the fourth line is reserved)
+			i = (p < 0) ? p + LEP_TEL_LINES : p - LEP_IMG_LINES;
+			wordsP = (i < LEP_TEL_PACKETS) ? &telem[i * (LEP_WIDTH/2)] : &telem[LEP_TEL_PACKETS * (LEP_WIDTH/2)];
+		} else {
+			wordsP = &img[p * (LEP_WIDTH/2)];
+		}
+		
+		put_packet(pkt, line, (line == 20) ? ttt : 0, wordsP);
+		if (crc_err && (line == 10)) {
+			pkt[100] ^= 0x01;
+		}
+		fwrite(pkt, sizeof(pkt), 1, fp);
+	}
+	
+	// Pad the block with discard packets
+	memset(pkt, 0, sizeof(pkt));
+	pkt[0] = 0x0F;
+	for (i=discards+lines; i<pkts_per_vsync; i++) {
+		fwrite(pkt, sizeof(pkt), 1, fp);
+	}
+}
+
+
+/**
+ * Build a packet from 80 16-bit words
+ */
+static void put_packet(uint8_t* pktP, int line, int ttt, uint16_t* wordsP)
+{
+	uint16_t crc;
+	int i;
+	
+	pktP[0] = (ttt << 4) | ((line >> 8) & 0x0F);
+	pktP[1] = line & 0xFF;
+	pktP[2] = 0;
+	pktP[3] = 0;
+	for (i=0; i<(LEP_WIDTH/2); i++) {
+		pktP[4 + 2*i] = wordsP[i] >> 8;
+		pktP[5 + 2*i] = wordsP[i] & 0xFF;
+	}
+	
+	crc = packet_crc(pktP);
+	pktP[2] = crc >> 8;
+	pktP[3] = crc & 0xFF;
+}
+
+
+/**
+ * CRC16 over the packet with the TTT bits and CRC field zeroed
+ */
+static uint16_t packet_crc(uint8_t* pktP)
+{
+	uint16_t crc = 0;
+	uint8_t b;
+	int i, j;
+	
+	for (i=0; i<LEP_PKT_LENGTH; i++) {
+		if (i == 0) {
+			b = pktP[0] & 0x0F;
+		} else if ((i == 2) || (i == 3)) {
+			b = 0;
+		} else {
+			b = pktP[i];
+		}
+		crc ^= b << 8;
+		for (j=0; j<8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ LEP_CRC16_POLY : (crc << 1);
+		}
+	}
+	
+	return crc;
+}
+
+
+static uint32_t next_rand()
+{
+	rand_state = (rand_state * 1103515245) + 12345;
+	
+	return (rand_state >> 16) & 0x7FFF;
+}
@@ -0,0 +1,61 @@
+/*
+ * VoSPI capture file format
+ *
+ * A capture holds the packets the Lepton clocked out on VoSPI, grouped by VSYNC period
+ * so they can be replayed in step with a simulated VSYNC.  All header fields are
+ * little-endian.  Packets are stored exactly as they were read (big-endian, 164 bytes).
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef VOSPI_CAPTURE_H
+#define VOSPI_CAPTURE_H
+
+#include <stdint.h>
+
+
+//
+// VoSPI Capture constants
+//
+#define VOSPI_CAP_MAGIC          0x49505356     /* "VSPI" */
+#define VOSPI_CAP_VERSION        1
+
+#define VOSPI_CAP_PKT_LEN        164
+
+// Header flags - telemetry location (matches the Lepton configuration at capture time)
+#define VOSPI_CAP_FLAG_TELEM     0x0001
+#define VOSPI_CAP_FLAG_HEADER    0x0002
+
+
+
+//
+// VoSPI Capture typedefs
+//
+
+// File header, followed by num_vsyncs blocks of pkts_per_vsync packets.  Each block starts
+// with the first packet read after a VSYNC edge.  Blocks are padded with discard packets.
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t pkts_per_vsync;
+	uint32_t vsync_usec;         // VSYNC period when the capture was made
+	uint32_t num_vsyncs;
+	uint32_t flags;              // VOSPI_CAP_FLAG_xxx
+} vospi_cap_header_t;
+
+#endif /* VOSPI_CAPTURE_H */
@@ -35,6 +35,8 @@
 #include "lep_task.h"
 #include "rsp_task.h"
 #include "lepton_utilities.h"
+#include "burst_utilities.h"
+#include "filter_utilities.h"
 #include "cci.h"
 #include "vospi.h"
 #include "sys_utilities.h"
@@ -53,6 +55,7 @@
 #define STATE_RUN       1
 #define STATE_RE_INIT   2
 #define STATE_ERROR     3
+#define STATE_IDLE      4
 
 
 //
@@ -62,6 +65,60 @@ static const char* TAG = "lep_task";
 
 static int lep_brd_type;
 static int lep_if_type;
+static int lep_vsync_pin;
+
+// VSYNC interrupt state
+//   lep_vsync_armed   - set when the task is waiting for VSYNC (edges are not counted as
+//                       missed while the task is deliberately not reading the Lepton)
+//   lep_vsync_pending - set by the ISR, cleared by the task when it consumes the edge
+static volatile int64_t lep_vsync_usec;
+static volatile bool lep_vsync_armed = false;
+static volatile bool lep_vsync_pending = false;
+static volatile uint32_t lep_vsync_missed_count = 0;
+
+// Frame phase tracking
+//   lep_vsync_period_x16 - measured VSYNC period (uSec * 16, running average maintained by the ISR)
+//   lep_vsync_skip       - set while the ISR should ignore edges until lep_vsync_wake_usec
+//   lep_vsync_wake_usec  - low 32-bits of the esp_timer time to resume waking the task
+//   lep_seg1_usec        - VSYNC timestamp of the most recently read first segment
+static volatile uint32_t lep_vsync_period_x16 = LEP_FRAME_USEC << 4;
+static volatile bool lep_vsync_skip = false;
+static volatile uint32_t lep_vsync_wake_usec;
+static int64_t lep_seg1_usec;
+static bool lep_seg1_valid = false;
+
+// Sequence number of the last frame published.  The frame being read is given the
+// next number, which is only used up if it is published.
+static uint32_t lep_frame_num = 0;
+
+// Identification of the frame being read, incremented each time the first segment of a
+// frame is read so segments of frames that were abandoned are never mixed with others
+static uint32_t lep_frame_id = 0;
+
+// Last segment of the frame being read that was published (0 for none)
+static int lep_seg_published = 0;
+
+// Statistics (missed_vsyncs is maintained in lep_vsync_missed_count)
+static lep_task_stats_t lep_stats;
+
+// Mask of LEP_REQ_SRC_xxx bits for clients currently using frames
+static volatile uint32_t lep_request_mask = 0;
+
+// Set when rsp_task wants each segment published as it is read
+static volatile bool lep_segment_publish_en = false;
+
+
+//
+// LEP Task Forward Declarations for internal functions
+//
+static bool lep_vsync_isr_init(int vsync_pin);
+static void IRAM_ATTR lep_vsync_isr(void* arg);
+static void lep_vsync_arm(bool en);
+static bool lep_vsync_wait(int64_t* vsyncDetectedUsec);
+static int lep_handle_segment(lep_buffer_t* lep_bufP);
+static void lep_track_phase(int seg, int64_t vsyncDetectedUsec);
+static void lep_fast_resync();
+static bool lep_ffc_running();
 
 
 
@@ -76,13 +133,21 @@ static int lep_if_type;
 void lep_task()
 {
 	int lep_csn_pin;
-	int lep_vsync_pin;
 	int task_state = STATE_INIT;
-	int rsp_buf_index = 0;
-	int vsync_count = 0;
+	lep_buffer_t* lep_bufP;
+	int seg;
+	int64_t lastFrameUsec = 0;   // Last time a frame or correctly sequenced segment was read
+	int64_t ffcStartUsec = 0;
+	int64_t noFrameUsec;
+	bool ffc_hold = false;
+	bool fast_resync_done = false;
 	int sync_fail_count = 0;
 	int reset_fail_count = 0;
+	bool got_frame;
 	int64_t vsyncDetectedUsec;
+	int64_t lastRequestUsec = 0;
+	int64_t idleStartUsec = 0;
+	int64_t idleUsec;
 	
 	ESP_LOGI(TAG, "Start task");
 	
@@ -107,12 +172,28 @@ void lep_task()
 		ctrl_set_fault_type(CTRL_FAULT_LEP_VOSPI);
 		vTaskDelete(NULL);
 	}
+	
+	// The temporal filter is optional so the task runs without it
+	(void) filter_init();
+	
+	// Frames are assembled directly in the shared buffer we own
+	lep_bufP = system_lep_frame_producer_buffer();
+	vospi_set_frame_buffer(lep_bufP);
+	
+	// Setup the VSYNC interrupt to wake us for each segment
+	if (!lep_vsync_isr_init(lep_vsync_pin)) {
+		ESP_LOGE(TAG, "Lepton VSYNC interrupt initialization failed");
+		ctrl_set_fault_type(CTRL_FAULT_LEP_VOSPI);
+		vTaskDelete(NULL);
+	}
 
 	while (true) {
 		switch (task_state) {
 			case STATE_INIT:  // After power-on reset
 				if (lepton_init()) {
 					task_state = STATE_RUN;
+					lastFrameUsec = esp_timer_get_time();
+					lep_vsync_arm(true);
 				} else {
 					ESP_LOGE(TAG, "Lepton CCI initialization failed");
 					ctrl_set_fault_type(CTRL_FAULT_LEP_CCI);
@@ -124,32 +205,66 @@ void lep_task()
 				break;
 			
 			case STATE_RUN:   // Initialized and running
-				// Spin waiting for vsync to be asserted
-				while (gpio_get_level((gpio_num_t) lep_vsync_pin) == 0) {
-//					vTaskDelay(pdMS_TO_TICKS(9));
+#ifdef LEP_IDLE_WHEN_UNUSED
+				// Stop reading the Lepton when no client has used images for a while.  The
+				// VSYNC interrupt is disabled to eliminate its overhead too.
+				if (lep_request_mask != 0) {
+					lastRequestUsec = esp_timer_get_time();
+				} else if ((esp_timer_get_time() - lastRequestUsec) > (LEP_IDLE_HOLDOFF_MSEC * 1000)) {
+					lep_vsync_arm(false);
+					gpio_intr_disable((gpio_num_t) lep_vsync_pin);
+					idleStartUsec = esp_timer_get_time();
+					lep_stats.idle_periods++;
+					task_state = STATE_IDLE;
+					break;
 				}
-				vsyncDetectedUsec = esp_timer_get_time();
+#endif
 				
-				// Attempt to process a segment
-				if (vospi_transfer_segment(vsyncDetectedUsec)) {
-					// Got image
-					vsync_count = 0;
+				// Block waiting for the VSYNC interrupt and then attempt to process a segment
+				if (lep_vsync_wait(&vsyncDetectedUsec)) {
+					got_frame = vospi_transfer_segment(vsyncDetectedUsec);
 					
-					// Copy the frame to the current half of the shared buffer and let rsp_task know
-					xSemaphoreTake(rsp_lep_buffer[rsp_buf_index].lep_mutex, portMAX_DELAY);
-					vospi_get_frame(&rsp_lep_buffer[rsp_buf_index]);
-					xSemaphoreGive(rsp_lep_buffer[rsp_buf_index].lep_mutex);
-#ifdef LOG_ACQ_TIMESTAMP
-					ESP_LOGI(TAG, "Push into buf %d", rsp_buf_index);
-#endif
-					if (rsp_buf_index == 0) {
-						xTaskNotify(task_handle_rsp, RSP_NOTIFY_LEP_FRAME_MASK_0, eSetBits);
-						rsp_buf_index = 1;
-					} else {
-						xTaskNotify(task_handle_rsp, RSP_NOTIFY_LEP_FRAME_MASK_1, eSetBits);
-						rsp_buf_index = 0;
+					// Number the frame and optionally make each segment available as soon as it has been read
+					seg = lep_handle_segment(lep_bufP);
+					
+					// Schedule the next segment we need to read
+					lep_track_phase(seg, vsyncDetectedUsec);
+					
+					// A new frame discarded after its first segment was read is missed too
+					if (vospi_frame_discarded()) {
+						lep_stats.missed_frames++;
 					}
+				} else {
+					got_frame = false;
+					seg = 0;
+				}
+				
+				if (seg != 0) {
+					// Every correctly sequenced segment (of any frame) shows we are still in sync
+					lastFrameUsec = esp_timer_get_time();
+				}
+				
+				if (got_frame) {
+					// Got image.  Publish the frame assembled in our ring slot for rsp_task and start
+					// assembling the next frame in the slot we get back
+					vospi_get_frame(lep_bufP);
+					lep_bufP->acq_usec = vsyncDetectedUsec;
+					lep_frame_num = lep_bufP->frame_num;
 					
+					// Burst capture holds the Lepton data as read (like image segments)
+					burst_add_frame(lep_bufP);
+					filter_process(lep_bufP);
+					lep_bufP = system_lep_frame_publish();
+					lep_stats.frames++;
+					vospi_set_frame_buffer(lep_bufP);
+#ifdef LOG_ACQ_TIMESTAMP
+					ESP_LOGI(TAG, "Publish frame");
+#endif
+				}
+				
+				if (seg == 4) {
+					// A complete frame, including a repeat of the previous frame that is not
+					// published, shows we are synchronized with the Lepton.
 					// Clear the resynchronization fault indication if necessary (since we are working again)
 					if (sync_fail_count >= LEP_SYNC_FAIL_FAULT_LIMIT) {
 						ctrl_set_fault_type(CTRL_FAULT_NONE);
@@ -157,26 +272,62 @@ void lep_task()
 					// Hold fault counters reset while operating
 					sync_fail_count = 0;
 					reset_fail_count = 0;
-					
-					vTaskDelay(pdMS_TO_TICKS(30));
+					fast_resync_done = false;
+					ffc_hold = false;
 				} else {
-					// We should see a valid frame every 12 vsync interrupts (one frame period).
-					// However, since we may be resynchronizing with the VoSPI stream and our task
-					// may be interrupted by other tasks, we give the lepton extra frame periods
-					// to start correctly streaming data.  We may still fail when the lepton runs
-					// a FFC since that takes a long time.
-					if (++vsync_count == 36) {
-						vsync_count = 0;
+					// A segment out of sequence means we lost our place in the current frame.
+					// Hunt for the first segment of the next frame immediately instead of
+					// waiting for frames to stop arriving.
+					if (vospi_sequence_lost()) {
+						lep_fast_resync();
+					}
+					
+					// The Lepton does not output new frames while it runs a FFC (reported in the
+					// telemetry) so that is not counted as a loss of synchronization for a while
+					if (lep_ffc_running()) {
+						if (!ffc_hold) {
+							ffc_hold = true;
+							ffcStartUsec = esp_timer_get_time();
+							lep_stats.ffc_holds++;
+						}
+						if ((esp_timer_get_time() - ffcStartUsec) < (LEP_FFC_MAX_MSEC * 1000)) {
+							lastFrameUsec = esp_timer_get_time();
+						}
+					} else {
+						ffc_hold = false;
+					}
+					
+					// We should see valid segments in 4 of every 12 vsync interrupts (one frame period).
+					// However, since our task may be interrupted by other tasks, we give the lepton
+					// extra frame periods to start correctly streaming data.  We first try hunting
+					// for the next frame on every VSYNC and only pause for the Lepton to resynchronize
+					// VoSPI when that fails.  Time is measured since we may skip VSYNC edges between
+					// frames.  A frame still being read is never abandoned this way (losing our place
+					// in it is detected as a segment sequence error).
+					noFrameUsec = esp_timer_get_time() - lastFrameUsec;
+					if (!fast_resync_done && !vospi_frame_in_progress() && (noFrameUsec >= (LEP_FAST_SYNC_WAIT_VSYNCS * LEP_FRAME_USEC))) {
+						lep_fast_resync();
+						fast_resync_done = true;
+					} else if (noFrameUsec >= (LEP_SYNC_WAIT_VSYNCS * LEP_FRAME_USEC)) {
 						ESP_LOGI(TAG, "Could not get lepton image");
 						
 						// Pause to allow resynchronization
 						// (Lepton 3.5 data sheet section 4.2.3.3.1 "Establishing/Re-Establishing Sync")
-						vTaskDelay(pdMS_TO_TICKS(185));
+						lep_stats.resyncs++;
+						lep_vsync_arm(false);
+						vTaskDelay(pdMS_TO_TICKS(LEP_RESYNC_MSEC));
+						if (vospi_resync()) {
+							lep_stats.missed_frames++;
+						}
+						lep_vsync_arm(true);
+						lastFrameUsec = esp_timer_get_time();
+						fast_resync_done = false;
 						
 						// Check for too many consecutive resynchronization failures.
 						// This should only occur if something has gone wrong.
 						if (sync_fail_count++ == LEP_SYNC_FAIL_FAULT_LIMIT) {
 							ctrl_set_fault_type(CTRL_FAULT_LEP_SYNC);
+							lep_vsync_arm(false);
 							if (reset_fail_count == 0) {
 								// Reset the first time
 								task_state = STATE_RE_INIT;
@@ -194,8 +345,30 @@ void lep_task()
 				}
 				break;
 			
+			case STATE_IDLE:  // Not reading the Lepton
+				// Wait for a client to request frames or the periodic check of the Lepton
+				(void) xTaskNotifyWait(0x00, LEP_NOTIFY_REQUEST_MASK, NULL, pdMS_TO_TICKS(LEP_IDLE_CHECK_MSEC));
+				
+				// The Lepton resynchronizes once VoSPI has been idle long enough so make sure
+				// it has been before we start reading again
+				idleUsec = esp_timer_get_time() - idleStartUsec;
+				if (idleUsec < (LEP_RESYNC_MSEC * 1000)) {
+					vTaskDelay(pdMS_TO_TICKS(LEP_RESYNC_MSEC - (idleUsec / 1000)) + 1);
+				}
+				(void) vospi_resync();
+				lastFrameUsec = esp_timer_get_time();
+				fast_resync_done = false;
+				
+				// Run for at least the holdoff period (so a periodic check reads some frames)
+				lastRequestUsec = esp_timer_get_time();
+				gpio_intr_enable((gpio_num_t) lep_vsync_pin);
+				lep_vsync_arm(true);
+				task_state = STATE_RUN;
+				break;
+			
 			case STATE_RE_INIT:  // Reset and re-init
 				ESP_LOGI(TAG,  "Reset Lepton");
+				lep_stats.resets++;
 				
 				// Assert hardware reset
 				if (lep_brd_type == CTRL_BRD_ETH_TYPE) {
@@ -214,6 +387,8 @@ void lep_task()
     			// Attempt to re-initialize the Lepton
     			if (lepton_init()) {
 					task_state = STATE_RUN;
+					lastFrameUsec = esp_timer_get_time();
+					lep_vsync_arm(true);
 					
 					// Note the reset
     				reset_fail_count = 1;
@@ -241,3 +416,276 @@ void lep_task()
 		}
 	}
 }
+
+
+/**
+ * Enable or disable publishing each segment as it is read (in addition to complete frames)
+ */
+void lep_set_segment_publish(bool en)
+{
+	lep_segment_publish_en = en;
+}
+
+
+/**
+ * Called by a client (identified by one LEP_REQ_SRC_xxx bit) to indicate if it is
+ * currently using frames.  lep_task stops reading the Lepton when no client is.
+ */
+void lep_request_frames(uint32_t src_mask, bool en)
+{
+	uint32_t prev;
+	
+	if (en) {
+		prev = __atomic_fetch_or(&lep_request_mask, src_mask, __ATOMIC_ACQ_REL);
+		if (prev == 0) {
+			// Wake lep_task if it is idle
+			xTaskNotify(task_handle_lep, LEP_NOTIFY_REQUEST_MASK, eSetBits);
+		}
+	} else {
+		(void) __atomic_fetch_and(&lep_request_mask, ~src_mask, __ATOMIC_ACQ_REL);
+	}
+}
+
+
+/**
+ * Return a copy of the task statistics
+ */
+void lep_get_stats(lep_task_stats_t* statsP)
+{
+	*statsP = lep_stats;
+	statsP->missed_vsyncs = lep_vsync_missed_count;
+}
+
+
+
+//
+// LEP Task internal functions
+//
+
+/**
+ * Configure the VSYNC GPIO to interrupt on its rising edge
+ */
+static bool lep_vsync_isr_init(int vsync_pin)
+{
+	esp_err_t ret;
+	
+	gpio_set_intr_type((gpio_num_t) vsync_pin, GPIO_INTR_POSEDGE);
+	
+	// The ISR service may have already been installed by another driver
+	ret = gpio_install_isr_service(0);
+	if ((ret != ESP_OK) && (ret != ESP_ERR_INVALID_STATE)) {
+		ESP_LOGE(TAG, "Could not install GPIO ISR service - %d", ret);
+		return false;
+	}
+	
+	ret = gpio_isr_handler_add((gpio_num_t) vsync_pin, lep_vsync_isr, NULL);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Could not add VSYNC ISR handler - %d", ret);
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * VSYNC rising edge ISR - timestamp the edge and wake lep_task
+ */
+static void IRAM_ATTR lep_vsync_isr(void* arg)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	int64_t t;
+	uint32_t delta;
+	
+	t = esp_timer_get_time();
+	
+	// Track the VSYNC period (ignoring intervals where an edge was not seen)
+	delta = (uint32_t) (t - lep_vsync_usec);
+	if ((delta > (LEP_FRAME_USEC - LEP_VSYNC_JITTER_USEC)) && (delta < (LEP_FRAME_USEC + LEP_VSYNC_JITTER_USEC))) {
+		lep_vsync_period_x16 += delta - (lep_vsync_period_x16 >> 4);
+	}
+	lep_vsync_usec = t;
+	
+	// Ignore edges for segments between frames
+	if (lep_vsync_skip) {
+		if ((int32_t) ((uint32_t) t - lep_vsync_wake_usec) < 0) {
+			return;
+		}
+		lep_vsync_skip = false;
+	}
+	
+	if (lep_vsync_armed) {
+		if (lep_vsync_pending) {
+			// Previous edge was never serviced
+			lep_vsync_missed_count++;
+		}
+		lep_vsync_pending = true;
+		xTaskNotifyFromISR(task_handle_lep, LEP_NOTIFY_VSYNC_MASK, eSetBits, &xHigherPriorityTaskWoken);
+	}
+	
+	if (xHigherPriorityTaskWoken == pdTRUE) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+
+/**
+ * Enable or disable VSYNC notifications.  Any edge seen before the task starts waiting
+ * again is discarded so a segment read is never started from a stale timestamp.
+ */
+static void lep_vsync_arm(bool en)
+{
+	lep_vsync_armed = false;
+	lep_vsync_pending = false;
+	lep_vsync_skip = false;
+	
+	// Frame phase must be re-established after reading stops
+	lep_seg1_valid = false;
+	
+	// Clear any outstanding notification
+	(void) xTaskNotifyWait(0x00, LEP_NOTIFY_VSYNC_MASK, NULL, 0);
+	
+	lep_vsync_armed = en;
+}
+
+
+/**
+ * Number a new frame when its first segment has been read and, if enabled, copy a
+ * segment that was just read to its shared segment buffer and let rsp_task know.
+ * Segments of a frame known to be a duplicate are not published.  A frame that is
+ * identified as a duplicate or discarded after some of its segments were published
+ * is ended with a dropped marker in place of its next segment.  Returns the segment
+ * number (1-4) or 0 if no valid segment was read.
+ */
+static int lep_handle_segment(lep_buffer_t* lep_bufP)
+{
+	int seg;
+	int pixel_offset;
+	int pixel_len;
+	bool telem_valid;
+	
+	seg = vospi_get_completed_segment(&pixel_offset, &pixel_len, &telem_valid);
+	if (seg == 1) {
+		lep_bufP->frame_num = lep_frame_num + 1;
+		lep_frame_id++;
+		lep_seg_published = 0;
+	}
+	
+	if (lep_segment_publish_en) {
+		if ((seg != 0) && !vospi_frame_duplicate()) {
+			system_lep_segment_publish(seg, lep_frame_id, lep_bufP, pixel_offset, pixel_len, telem_valid);
+			lep_seg_published = seg;
+			xTaskNotify(task_handle_rsp, RSP_NOTIFY_LEP_SEGMENT_MASK, eSetBits);
+		} else if ((lep_seg_published != 0) && ((seg != 0) || vospi_frame_discarded())) {
+			// The frame was identified as a repeat (from its last segment) or discarded
+			// after its first segments were published
+			system_lep_segment_drop(lep_seg_published + 1, lep_frame_id, lep_bufP->frame_num);
+			lep_seg_published = 0;
+			xTaskNotify(task_handle_rsp, RSP_NOTIFY_LEP_SEGMENT_MASK, eSetBits);
+		}
+	}
+	
+	return seg;
+}
+
+
+/**
+ * Track the phase of the Lepton's unique frames (one every LEP_VSYNC_PER_FRAME VSYNC
+ * periods) from the VSYNC timestamp of each first segment we read.  Counts frames
+ * whose first segment we did not read and, when LEP_PHASE_LOCK is defined, ignores
+ * VSYNC edges after the last segment of a frame until half a period before the first
+ * segment of the next frame is expected.  Every edge is used while the phase is
+ * unknown or the first segment did not arrive when expected.
+ */
+static void lep_track_phase(int seg, int64_t vsyncDetectedUsec)
+{
+	int32_t period;
+	int32_t frame_period;
+	int64_t dt;
+	int n;
+	
+	period = lep_vsync_period_x16 >> 4;
+	frame_period = period * LEP_VSYNC_PER_FRAME;
+	
+	if (seg == 1) {
+		if (lep_seg1_valid) {
+			// Number of frame periods since the previous first segment
+			dt = vsyncDetectedUsec - lep_seg1_usec;
+			n = (int) ((dt + (frame_period / 2)) / frame_period);
+			if (n > 1) {
+				lep_stats.missed_frames += n - 1;
+			}
+		}
+		lep_seg1_usec = vsyncDetectedUsec;
+		lep_seg1_valid = true;
+	}
+	
+#ifdef LEP_PHASE_LOCK
+	if (lep_seg1_valid) {
+		dt = vsyncDetectedUsec - lep_seg1_usec;
+		if ((dt > ((5 * period) / 2)) && (dt < (frame_period - (period / 2)))) {
+			// Past the last segment
+			lep_vsync_wake_usec = (uint32_t) (lep_seg1_usec + frame_period - (period / 2));
+			lep_vsync_skip = true;
+		}
+	}
+#endif
+}
+
+
+/**
+ * Block until the next VSYNC edge
+ *  - Returns true with the ISR timestamp in vsyncDetectedUsec, false on timeout
+ */
+static bool lep_vsync_wait(int64_t* vsyncDetectedUsec)
+{
+	uint32_t notification_value = 0;
+	int32_t timeout_msec = LEP_VSYNC_TIMEOUT_MSEC;
+	int32_t skip_usec;
+	
+	// Include the time edges are being ignored
+	if (lep_vsync_skip) {
+		skip_usec = (int32_t) (lep_vsync_wake_usec - (uint32_t) esp_timer_get_time());
+		if (skip_usec > 0) {
+			timeout_msec += skip_usec / 1000;
+		}
+	}
+	
+	// Frame request notifications are only used to leave STATE_IDLE and are discarded here
+	while (xTaskNotifyWait(0x00, LEP_NOTIFY_VSYNC_MASK | LEP_NOTIFY_REQUEST_MASK, &notification_value, pdMS_TO_TICKS(timeout_msec))) {
+		if (Notification(notification_value, LEP_NOTIFY_VSYNC_MASK)) {
+			*vsyncDetectedUsec = lep_vsync_usec;
+			lep_vsync_pending = false;
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+/**
+ * Discard any partially read frame and read every VSYNC edge until the first segment
+ * of a frame is seen.  This recovers from missed segments without the VoSPI idle
+ * period the Lepton needs to recover from a loss of packet synchronization.
+ */
+static void lep_fast_resync()
+{
+	lep_stats.fast_resyncs++;
+	if (vospi_resync()) {
+		lep_stats.missed_frames++;
+	}
+	lep_vsync_arm(true);
+}
+
+
+/**
+ * Return true if the most recently read telemetry shows the Lepton is about to run
+ * or is running a FFC
+ */
+static bool lep_ffc_running()
+{
+	uint32_t ffc_state = vospi_get_ffc_state();
+	
+	return ((ffc_state == LEP_FFC_STATE_IMM) || (ffc_state == LEP_FFC_STATE_RUN));
+}
@@ -27,6 +27,7 @@
 #ifndef LEP_TASK_H
 #define LEP_TASK_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -41,11 +42,69 @@
 // Reset fail delay before attempting a re-init (seconds)
 #define LEP_RESET_FAIL_RETRY_SECS 60
 
+// Number of VSYNC periods (segments) in each unique Lepton frame
+#define LEP_VSYNC_PER_FRAME       12
+
+// Maximum deviation of a VSYNC interval from nominal used to measure the VSYNC period (uSec)
+#define LEP_VSYNC_JITTER_USEC     1000
+
+// Time without a frame before hunting for the first segment of the next frame on
+// every VSYNC (fast resynchronization) (VSYNC periods)
+#define LEP_FAST_SYNC_WAIT_VSYNCS 18
+
+// Time without a frame before attempting to resynchronize with VoSPI (VSYNC periods)
+#define LEP_SYNC_WAIT_VSYNCS      36
+
+// Maximum time a FFC in progress holds off resynchronization (mSec)
+#define LEP_FFC_MAX_MSEC          1500
+
+// Maximum time to wait for a VSYNC interrupt before considering it missing (mSec)
+// (VSYNC is nominally asserted every 9.45 mSec)
+#define LEP_VSYNC_TIMEOUT_MSEC    20
+
+// Time the VoSPI interface must be idle for the Lepton to resynchronize (mSec)
+// (Lepton 3.5 data sheet section 4.2.3.3.1 "Establishing/Re-Establishing Sync")
+#define LEP_RESYNC_MSEC           185
+
+// Idle mode timing (mSec)
+//   LEP_IDLE_HOLDOFF_MSEC - time with no frame requests before VoSPI reads are stopped
+//   LEP_IDLE_CHECK_MSEC   - period to briefly resume reads to verify the Lepton is still working
+#define LEP_IDLE_HOLDOFF_MSEC     1000
+#define LEP_IDLE_CHECK_MSEC       30000
+
+// Frame request sources for lep_request_frames()
+#define LEP_REQ_SRC_RSP           0x00000001
+#define LEP_REQ_SRC_BURST         0x00000002
+#define LEP_REQ_SRC_ALARM         0x00000004
+
+// Task notifications
+#define LEP_NOTIFY_VSYNC_MASK     0x00000001
+#define LEP_NOTIFY_REQUEST_MASK   0x00000002
+
+
+
+//
+// LEP Task typedefs
+//
+typedef struct {
+	uint32_t frames;             // Frames published to rsp_task
+	uint32_t fast_resyncs;       // Fast VoSPI resynchronizations (without a delay)
+	uint32_t resyncs;            // VoSPI resynchronization delays
+	uint32_t ffc_holds;          // Times resynchronization was held off because the Lepton was running a FFC
+	uint32_t resets;             // Lepton hardware resets
+	uint32_t idle_periods;       // Times VoSPI reads were stopped because no client was using images
+	uint32_t missed_vsyncs;      // VSYNC edges that occurred while the previous edge was pending
+	uint32_t missed_frames;      // Unique frames whose first segment was not read or that were discarded part way through
+} lep_task_stats_t;
+
 
 
 //
 // LEP Task API
 //
 void lep_task();
+void lep_set_segment_publish(bool en);
+void lep_request_frames(uint32_t src_mask, bool en);
+void lep_get_stats(lep_task_stats_t* statsP);
 
 #endif /* LEP_TASK_H */
\ No newline at end of file
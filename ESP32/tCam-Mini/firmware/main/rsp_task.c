@@ -28,6 +28,15 @@
 #include "ctrl_task.h"
 #include "lep_task.h"
 #include "rsp_task.h"
+#include "agc_utilities.h"
+#include "bin_utilities.h"
+#include "alarm_utilities.h"
+#include "burst_utilities.h"
+#include "change_utilities.h"
+#include "crop_utilities.h"
+#include "decimate_utilities.h"
+#include "isotherm_utilities.h"
+#include "roi_utilities.h"
 #include "cmd_utilities.h"
 #include "json_utilities.h"
 #include "sif_utilities.h"
@@ -43,6 +52,7 @@
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 #include <lwip/netdb.h>
+#include <string.h>
 
 
 //
@@ -72,15 +82,33 @@ static const char* TAG = "rsp_task";
 static bool connected;
 static bool stream_on;
 static bool image_pending;
-static bool got_image_0, got_image_1;
+static bool got_segment;
+static bool next_image_binary;                  // Send images as binary responses instead of json
+static bool cur_image_binary;
+
+// Stream parameters (next_stream is set by cmd_task and copied to cur_stream when streaming starts)
+static json_stream_on_t next_stream;
+static json_stream_on_t cur_stream;
 
 // Stream rate/duration control
-static uint32_t next_stream_frame_delay_msec;   // mSec between images; 0 = fast as possible
-static uint32_t cur_stream_frame_delay_usec;
-static uint32_t next_stream_frame_num;          // Number of frames to stream; 0 = infinite
-static uint32_t cur_stream_frame_num;
 static uint32_t stream_remaining_frames;        // Remaining frames to stream
 static int64_t stream_ready_usec;               // Next ESP32 uSec timestamp to send image
+static int stream_seg_next;                     // Next segment to send (1-4)
+static uint32_t stream_seg_frame_id;            // Frame identification of the segments being sent
+static uint32_t stream_seg_frame_num;           // Sequence number of the frame being sent
+static int64_t stream_heartbeat_usec;           // ESP32 uSec timestamp the next heartbeat image is due
+
+// Alarm state
+static bool alarm_image_pending;                // Send the next image in full for an alarm event
+
+// Burst capture read-out
+static bool burst_sending;                      // Set while sending the frozen burst ring
+static int burst_send_index;                    // Next burst frame to send
+
+// Performance measurement
+static rsp_perf_t rsp_perf;
+static int64_t perf_window_usec;                // Start of the current send rate measurement
+static uint32_t perf_window_images;             // images_sent at the start of the measurement
 
 // cam_info json string temporary buffer
 static SemaphoreHandle_t cam_info_mutex;
@@ -107,13 +135,24 @@ static int fw_seg_length;
 static void init_state();
 static void eval_stream_ready();
 static void handle_notifications();
-static int process_image(int n);
+static void process_alarms();
+static bool stream_frame_unchanged(lep_buffer_t* lep_bufP);
+static void process_segments(int if_type);
+static void drop_segment_frame(int if_type);
+static int process_image(lep_buffer_t* lep_bufP);
+static int process_segment(lep_segment_buffer_t* lep_segP, int seg);
+static void process_burst(int if_type);
+static void delimit_image_rsp_buffer();
+static void send_image(int if_type);
+static void count_stream_frame();
 static void send_response(char* rsp, int len, bool ser_mode);
+static void push_response(char* rsp, int len);
 static bool cmd_response_available();
 static int get_cmd_response();
 static char pop_cmd_response_buffer();
 static void send_spi_image(char* rsp, int rsp_length);
 static void send_get_fw();
+static void update_send_rate();
 
 
 
@@ -122,9 +161,11 @@ static void send_get_fw();
 //
 void rsp_task()
 {
+	bool send_frame;
 	int len;
 	int brd_type;
 	int if_type;
+	lep_buffer_t* lep_bufP;
 	
 	ESP_LOGI(TAG, "Start task");
 	
@@ -137,12 +178,43 @@ void rsp_task()
 	
 	cam_info_mutex = xSemaphoreCreateMutex();
 	
+	if (!roi_init()) {
+		ESP_LOGE(TAG, "ROI init failed");
+	}
+	
+	if (!alarm_init()) {
+		ESP_LOGE(TAG, "Alarm init failed");
+	}
+	
+	if (!agc_init()) {
+		ESP_LOGE(TAG, "AGC preview init failed");
+	}
+	
+	if (!decimate_init()) {
+		ESP_LOGE(TAG, "Decimate init failed");
+	}
+	
+	if (!crop_init()) {
+		ESP_LOGE(TAG, "Crop init failed");
+	}
+	
+	if (!change_init()) {
+		ESP_LOGE(TAG, "Change detection init failed");
+	}
+	
+	if (!isotherm_init()) {
+		ESP_LOGE(TAG, "Isotherm init failed");
+	}
+	
+	perf_window_usec = esp_timer_get_time();
+	perf_window_images = 0;
+	
 	//
 	// Task loop
 	//
 	while (1) {
 		// Evaluate streaming conditions for ready to send image if enabled before
-		// handling notifications (of images from lep_task)
+		// looking for images from lep_task
 		if (stream_on) {
 			eval_stream_ready();
 		}
@@ -163,44 +235,74 @@ void rsp_task()
 		}
 		
 		// Look for things to send
-		if (got_image_0 || got_image_1) {
-			if (connected) {
-				if (got_image_0) {
-					len = process_image(0);
-					got_image_0 = false;
-#ifdef LOG_IMG_TIMESTAMP
-					ESP_LOGI(TAG, "process image 0");
-#endif
-				} else {
-					len = process_image(1);
-					got_image_1 = false;
+		if (!(stream_on && (cur_stream.delay_ms == 0) && !cur_stream.segments)) {
+			// Only keep the most recent frame when we aren't sending every frame so the
+			// ring doesn't fill (and count overflows) while we wait
+			system_lep_frame_flush(true);
+		}
+		
+		send_frame = image_pending && connected && !(stream_on && cur_stream.segments);
+		if (send_frame || alarm_enabled()) {
+			// Take ownership of the next frame from the frame ring.  When streaming as
+			// fast as possible we send every frame in order (draining any backlog built up
+			// while the network stalled), otherwise we send the most recent frame.
+			lep_bufP = system_lep_frame_consume(!(stream_on && (cur_stream.delay_ms == 0)));
+			if (lep_bufP != NULL) {
+				// Every frame we take is evaluated against the alarm rules.  An event that
+				// includes an image sends this frame (between frames when streaming segments).
+				if (alarm_enabled() && alarm_process(lep_bufP)) {
+					process_alarms();
+				}
+				
+				if (send_frame) {
+					image_pending = false;
+					if (stream_frame_unchanged(lep_bufP)) {
+						// Nothing new to send
+						send_frame = false;
+					}
+				}
+				
+				if (send_frame || alarm_image_pending) {
+					len = process_image(lep_bufP);
+					if (send_frame && stream_on && (cur_stream.change_threshold != 0)) {
+						// Following images are compared to this one
+						change_set_reference(lep_bufP->lep_bufferP);
+						stream_heartbeat_usec = esp_timer_get_time() + (int64_t) cur_stream.heartbeat_sec * 1000000;
+					}
+					system_lep_frame_release();
 #ifdef LOG_IMG_TIMESTAMP
-					ESP_LOGI(TAG, "process image 1");
+					ESP_LOGI(TAG, "process image");
 #endif
-				}	
 					
-				// Send the image
-				if (len != 0) {
-					if (if_type == CTRL_IF_MODE_SIF) {
-						// Configure a SPI slave response if the slave is available,
-						// otherwise drop the response
-						if (!system_spi_slave_busy()) {
-							send_spi_image(sys_image_rsp_buffer.bufferP, sys_image_rsp_buffer.length);
-						}
-					} else {
-						send_response(sys_image_rsp_buffer.bufferP, sys_image_rsp_buffer.length, false);
+					// Send the image
+					if (len != 0) {
+						send_image(if_type);
 					}
-				}
-				
-				// If streaming, determine if we have sent the required number of images if necessary
-				if (stream_on && (cur_stream_frame_num != 0)) {
-					if (--stream_remaining_frames == 0) {
-						stream_on = false;
+					
+					// If streaming, determine if we have sent the required number of images if necessary
+					if (send_frame) {
+						count_stream_frame();
 					}
+				} else {
+					system_lep_frame_release();
 				}
 			}
 		}
 		
+		if (got_segment) {
+			got_segment = false;
+			if (connected && stream_on && cur_stream.segments) {
+				process_segments(if_type);
+			}
+		}
+		
+		if (burst_sending && connected) {
+			process_burst(if_type);
+		}
+		
+		// Free the burst capture ring after the capture has been turned off
+		burst_release();
+		
 		if (cmd_response_available()) {
 			// Get the command response and send it if possible
 			len = get_cmd_response();
@@ -236,6 +338,14 @@ void rsp_task()
 			}
 		}
 		
+		update_send_rate();
+		
+		// Let lep_task know if we want frames and segments
+		lep_request_frames(LEP_REQ_SRC_RSP, connected && (stream_on || image_pending));
+		lep_request_frames(LEP_REQ_SRC_BURST, burst_capturing());
+		lep_request_frames(LEP_REQ_SRC_ALARM, alarm_enabled());
+		lep_set_segment_publish(stream_on && cur_stream.segments);
+		
 		// Sleep task - less if we are streaming
 		if (stream_on) {
 			vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_FAST_MSEC));
@@ -246,17 +356,32 @@ void rsp_task()
 }
 
 
+// Called before sending RSP_NOTIFY_CMD_GET_IMG_MASK
+void rsp_set_image_parameters(bool binary)
+{
+	next_image_binary = binary;
+}
+
+
 // Called before sending RSP_NOTIFY_CMD_STREAM_ON_MASK
-void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames)
+void rsp_set_stream_parameters(json_stream_on_t* stream_paramsP)
 {
-	next_stream_frame_delay_msec = delay_ms;
-	next_stream_frame_num = num_frames;
+	next_image_binary = stream_paramsP->binary;
+	next_stream = *stream_paramsP;
+}
+
+
+/**
+ * Return a copy of the performance measurements
+ */
+void rsp_get_perf(rsp_perf_t* perfP)
+{
+	*perfP = rsp_perf;
 }
 
 
 void rsp_set_cam_info_msg(uint32_t info_value, char* info_string)
 {
-	int i;
 	int len;
 	
 	xSemaphoreTake(cam_info_mutex, portMAX_DELAY);
@@ -264,25 +389,7 @@ void rsp_set_cam_info_msg(uint32_t info_value, char* info_string)
 	// Create the cam_info json string
 	len = json_get_cam_info(cam_info_string, info_value, info_string);
 	
-	// Atomically load cmd_task_response_buffer
-	xSemaphoreTake(sys_cmd_response_buffer.mutex, portMAX_DELAY);
-	
-	// Only load if there's room for this response
-	if (len <= (CMD_RESPONSE_BUFFER_LEN - sys_cmd_response_buffer.length)) {
-		for (i=0; i<len; i++) {
-			// Push data
-			*sys_cmd_response_buffer.pushP = cam_info_string[i];
-			
-			// Increment push pointer
-			if (++sys_cmd_response_buffer.pushP >= (sys_cmd_response_buffer.bufferP + CMD_RESPONSE_BUFFER_LEN)) {
-				sys_cmd_response_buffer.pushP = sys_cmd_response_buffer.bufferP;
-			}
-		}
-		
-		sys_cmd_response_buffer.length += len;
-	}
-	
-	xSemaphoreGive(sys_cmd_response_buffer.mutex);
+	push_response(cam_info_string, len);
 	
 	xSemaphoreGive(cam_info_mutex);
 }
@@ -316,11 +423,16 @@ static void init_state()
 {
 	connected = false;
 	stream_on = false;
-	next_stream_frame_delay_msec = 0;
-	next_stream_frame_num = 0;
+	memset(&next_stream, 0, sizeof(json_stream_on_t));
+	next_stream.decimate = DECIMATE_NONE;
+	next_stream.decimate_mode = DECIMATE_MODE_AVG;
+	cur_stream = next_stream;
 	image_pending = false;
-	got_image_0 = false;
-	got_image_1 = false;
+	alarm_image_pending = false;
+	got_segment = false;
+	next_image_binary = false;
+	cur_image_binary = false;
+	burst_sending = false;
 	fw_update_state = FW_UPD_IDLE;
 	
 	// Flush the command response buffer
@@ -338,12 +450,12 @@ static void init_state()
 static void eval_stream_ready()
 {
 	// Determine if we are ready to send the next available image
-	if (cur_stream_frame_delay_usec == 0) {
+	if (cur_stream.delay_ms == 0) {
 		image_pending = true;
 	} else {
 		if (esp_timer_get_time() >= stream_ready_usec) {
 			image_pending = true;
-			stream_ready_usec = stream_ready_usec + cur_stream_frame_delay_usec;
+			stream_ready_usec = stream_ready_usec + (int64_t) cur_stream.delay_ms * 1000;
 		}
 	}
 }
@@ -364,6 +476,8 @@ static void handle_notifications()
 		if (Notification(notification_value, RSP_NOTIFY_CMD_GET_IMG_MASK)) {
 			// Note to process the next received image
 			image_pending = true;
+			cur_image_binary = next_image_binary;
+			system_lep_frame_flush(false);
 			
 			// Stop any on-going streaming
 			stream_on = false;
@@ -371,18 +485,30 @@ static void handle_notifications()
 		
 		if (Notification(notification_value, RSP_NOTIFY_CMD_STREAM_ON_MASK)) {
 			// Setup streaming
-			cur_stream_frame_delay_usec = next_stream_frame_delay_msec * 1000;
-			cur_stream_frame_num = next_stream_frame_num;
-			stream_remaining_frames = next_stream_frame_num;
+			cur_stream = next_stream;
+			stream_remaining_frames = cur_stream.num_frames;
+			cur_image_binary = next_image_binary;
+			change_reset();
+			
+			// Segment streaming starts with the first segment of the next new frame
+			stream_seg_next = 1;
+			stream_seg_frame_id = system_lep_segment_buffer(1)->frame_id;
 			
-			// First image is immediate
+			// First image is immediate (and newly acquired)
 			stream_ready_usec = esp_timer_get_time();
 			image_pending = true;
+			system_lep_frame_flush(false);
 			
 			// Start streaming
 			stream_on = true;
 		}
 		
+		if (Notification(notification_value, RSP_NOTIFY_CMD_BURST_GET_MASK)) {
+			// Start sending the burst ring from its oldest frame (once it is frozen)
+			burst_sending = true;
+			burst_send_index = 0;
+		}
+		
 		if (Notification(notification_value, RSP_NOTIFY_CMD_STREAM_OFF_MASK)) {
 			// Stop streaming
 			stream_on = false;
@@ -391,18 +517,8 @@ static void handle_notifications()
 		//
 		// Handle lep_task notifications
 		//
-		if (Notification(notification_value, RSP_NOTIFY_LEP_FRAME_MASK_0)) {
-			if (image_pending) {
-				got_image_0 = true;
-				image_pending = false;
-			}
-		}
-		
-		if (Notification(notification_value, RSP_NOTIFY_LEP_FRAME_MASK_1)) {
-			if (image_pending) {
-				got_image_1 = true;
-				image_pending = false;
-			}
+		if (Notification(notification_value, RSP_NOTIFY_LEP_SEGMENT_MASK)) {
+			got_segment = true;
 		}
 		
 		//
@@ -507,35 +623,199 @@ static void handle_notifications()
 
 
 /**
- * Convert lepton data in the specified half of the ping-pong buffer into a json record
+ * Send available segments of the frame currently being streamed, in order.  A frame
+ * is started with its first segment when it is time to send an image and abandoned
+ * if lep_task drops it or starts reading a new frame before we have sent all its
+ * segments.
+ */
+static void process_segments(int if_type)
+{
+	int len;
+	uint32_t seq;
+	lep_segment_buffer_t* lep_segP;
+	
+	while (stream_on) {
+		if (stream_seg_next != 1) {
+			// Look for an abandoned frame (lep_task failed to read the remaining segments)
+			if (system_lep_segment_buffer(1)->frame_id != stream_seg_frame_id) {
+				drop_segment_frame(if_type);
+			}
+		}
+		
+		// Check that the next segment is stable (written at least once and not being updated)
+		lep_segP = system_lep_segment_buffer(stream_seg_next);
+		seq = __atomic_load_n(&lep_segP->seq, __ATOMIC_ACQUIRE);
+		if ((seq == 0) || ((seq & 0x1) == 0x1)) {
+			return;
+		}
+		
+		if (stream_seg_next == 1) {
+			// Only start a new frame when it is time to send one
+			if (!image_pending || (lep_segP->frame_id == stream_seg_frame_id)) {
+				return;
+			}
+			stream_seg_frame_id = lep_segP->frame_id;
+			stream_seg_frame_num = lep_segP->frame_num;
+			image_pending = false;
+		} else if (lep_segP->frame_id != stream_seg_frame_id) {
+			// Segment not read yet
+			return;
+		} else if (lep_segP->dropped) {
+			// lep_task discarded the frame after publishing its first segments
+			drop_segment_frame(if_type);
+			continue;
+		}
+		
+		len = process_segment(lep_segP, stream_seg_next);
+		
+		// Discard the frame if lep_task updated the segment while we were converting it
+		if (__atomic_load_n(&lep_segP->seq, __ATOMIC_ACQUIRE) != seq) {
+			drop_segment_frame(if_type);
+			return;
+		}
+		
+		if (len != 0) {
+			send_image(if_type);
+		}
+		
+		if (stream_seg_next == SYS_LEP_NUM_SEGMENTS) {
+			// Sent a complete frame
+			stream_seg_next = 1;
+			count_stream_frame();
+		} else {
+			stream_seg_next++;
+		}
+	}
+}
+
+
+/**
+ * Abandon the frame whose segments are being streamed and start with the next frame.
+ * The host is told the frame was dropped if some of its segments have been sent.
+ */
+static void drop_segment_frame(int if_type)
+{
+	if (stream_seg_next != 1) {
+		sys_image_rsp_buffer.length = json_get_image_segment_dropped_string(sys_image_rsp_buffer.bufferP+1,
+		                                                                    stream_seg_frame_num, stream_seg_next);
+		delimit_image_rsp_buffer();
+		if (sys_image_rsp_buffer.length != 0) {
+			send_image(if_type);
+		}
+	}
+	
+	stream_seg_next = 1;
+	image_pending = true;
+}
+
+
+/**
+ * Send queued alarm events to the host through the command response queue (in order
+ * with command responses).  An event may request the frame that caused it be sent too.
+ */
+static void process_alarms()
+{
+	alarm_event_t event;
+	int len;
+	
+	while (alarm_get_event(&event)) {
+		if (!connected) continue;
+		
+		xSemaphoreTake(cam_info_mutex, portMAX_DELAY);
+		len = json_get_alarm_event(cam_info_string, &event);
+		push_response(cam_info_string, len);
+		xSemaphoreGive(cam_info_mutex);
+		
+		if (event.image) {
+			alarm_image_pending = true;
+		}
+	}
+}
+
+
+/**
+ * Return true if the frame should not be sent because we are only streaming changed
+ * images and it has not changed (and a heartbeat image is not due)
+ */
+static bool stream_frame_unchanged(lep_buffer_t* lep_bufP)
+{
+	if (!stream_on || (cur_stream.change_threshold == 0) || alarm_image_pending) {
+		return false;
+	}
+	
+	if ((cur_stream.heartbeat_sec != 0) && (esp_timer_get_time() >= stream_heartbeat_usec)) {
+		return false;
+	}
+	
+	if (change_detect(lep_bufP->lep_bufferP, cur_stream.change_threshold, cur_stream.change_pixels)) {
+		return false;
+	}
+	
+	rsp_perf.images_unchanged++;
+	
+	return true;
+}
+
+
+/**
+ * Convert lepton data in the specified shared buffer (owned by us) into a json record
  * with delimitors for transmission over the network
  */
-static int process_image(int n)
+static int process_image(lep_buffer_t* lep_bufP)
 {
-#ifdef LOG_PROC_TIMESTAMP
-	int64_t tb, te;
+	bool binary = cur_image_binary;
+	char* bufP = sys_image_rsp_buffer.bufferP;
+	int64_t tb;
 	
 	tb = esp_timer_get_time();
-#endif
 	
-	// Convert the image into a json record
-	xSemaphoreTake(rsp_lep_buffer[n].lep_mutex, portMAX_DELAY);
-    sys_image_rsp_buffer.length = json_get_image_file_string(sys_image_rsp_buffer.bufferP+1, &rsp_lep_buffer[n]);
-    xSemaphoreGive(rsp_lep_buffer[n].lep_mutex);
-    
-    if ((sys_image_rsp_buffer.length > 0) && (sys_image_rsp_buffer.length < JSON_MAX_IMAGE_TEXT_LEN-2)) {
-        // Add the delimitors
-        *sys_image_rsp_buffer.bufferP = CMD_JSON_STRING_START;
-        *(sys_image_rsp_buffer.bufferP + sys_image_rsp_buffer.length + 1) = CMD_JSON_STRING_STOP;
-        sys_image_rsp_buffer.length = sys_image_rsp_buffer.length + 2;
-    } else {
-        ESP_LOGE(TAG, "Illegal image_json_text for sys_image_rsp_buffer (%d bytes)", sys_image_rsp_buffer.length);
-        sys_image_rsp_buffer.length = 0;
+	// Convert the image (or just its region statistics, isotherm mask, AGC preview, thumbnail
+	// or crop when streaming them) into a json record or, if requested, a binary record
+	// (images only).  Alarm events that include an image always get the full image.
+	if (stream_on && cur_stream.roi && !alarm_image_pending) {
+		binary = false;
+		sys_image_rsp_buffer.length = json_get_roi_string(bufP+1, lep_bufP);
+	} else if (stream_on && cur_stream.isotherm && !alarm_image_pending) {
+		binary = false;
+		sys_image_rsp_buffer.length = json_get_isotherm_string(bufP+1, lep_bufP,
+			cur_stream.isotherm_lo, cur_stream.isotherm_hi);
+	} else if (stream_on && cur_stream.agc && !alarm_image_pending) {
+		if (binary) {
+			sys_image_rsp_buffer.length = bin_get_agc_image(bufP, lep_bufP);
+		} else {
+			sys_image_rsp_buffer.length = json_get_agc_image_string(bufP+1, lep_bufP);
+		}
+	} else if (stream_on && (cur_stream.decimate != DECIMATE_NONE) && !alarm_image_pending) {
+		if (binary) {
+			sys_image_rsp_buffer.length = bin_get_decimated_image(bufP, lep_bufP, cur_stream.decimate, cur_stream.decimate_mode);
+		} else {
+			sys_image_rsp_buffer.length = json_get_decimated_image_string(bufP+1, lep_bufP, cur_stream.decimate, cur_stream.decimate_mode);
+		}
+	} else if (stream_on && cur_stream.crop && !alarm_image_pending) {
+		if (binary) {
+			sys_image_rsp_buffer.length = bin_get_cropped_image(bufP, lep_bufP,
+				cur_stream.crop_r1, cur_stream.crop_c1, cur_stream.crop_r2, cur_stream.crop_c2);
+		} else {
+			sys_image_rsp_buffer.length = json_get_cropped_image_string(bufP+1, lep_bufP,
+				cur_stream.crop_r1, cur_stream.crop_c1, cur_stream.crop_r2, cur_stream.crop_c2);
+		}
+	} else {
+		if (binary) {
+			sys_image_rsp_buffer.length = bin_get_image(bufP, lep_bufP);
+		} else {
+			sys_image_rsp_buffer.length = json_get_image_file_string(bufP+1, lep_bufP);
+		}
+	}
+	
+	// Binary records include their own start byte and length
+	if (!binary) {
+		delimit_image_rsp_buffer();
 	}
+	alarm_image_pending = false;
 	
+	system_stage_time_add(&rsp_perf.encode, tb);
 #ifdef LOG_PROC_TIMESTAMP
-	te = esp_timer_get_time();
-	ESP_LOGI(TAG, "process_image took %d uSec", (int) (te - tb));
+	ESP_LOGI(TAG, "process_image took %d uSec", rsp_perf.encode.last_usec);
 #endif
 
 	return sys_image_rsp_buffer.length;
@@ -587,6 +867,35 @@ static void send_response(char* rsp, int rsp_length, bool ser_mode)
 }
 
 
+/**
+ * Atomically load a delimited json string into the command response buffer.  It is
+ * discarded if there isn't room for all of it.
+ */
+static void push_response(char* rsp, int len)
+{
+	int i;
+	
+	xSemaphoreTake(sys_cmd_response_buffer.mutex, portMAX_DELAY);
+	
+	// Only load if there's room for this response
+	if (len <= (CMD_RESPONSE_BUFFER_LEN - sys_cmd_response_buffer.length)) {
+		for (i=0; i<len; i++) {
+			// Push data
+			*sys_cmd_response_buffer.pushP = rsp[i];
+			
+			// Increment push pointer
+			if (++sys_cmd_response_buffer.pushP >= (sys_cmd_response_buffer.bufferP + CMD_RESPONSE_BUFFER_LEN)) {
+				sys_cmd_response_buffer.pushP = sys_cmd_response_buffer.bufferP;
+			}
+		}
+		
+		sys_cmd_response_buffer.length += len;
+	}
+	
+	xSemaphoreGive(sys_cmd_response_buffer.mutex);
+}
+
+
 /**
  * Atomically check if there is a response from cmd_task to transmit and load our global
  * cmd_response_length variable with its length
@@ -726,7 +1035,6 @@ static void send_spi_image(char* rsp, int rsp_length)
 static void send_get_fw()
 {
 	char* response_buffer;
-	int i;
 	uint32_t get_fw_length;
 	uint32_t response_length;
 	
@@ -740,23 +1048,141 @@ static void send_get_fw()
 	// Get the json string
 	response_buffer = json_get_get_fw(fw_cur_loc, get_fw_length, &response_length);
 	
-	// Atomically load cmd_task_response_buffer
-	xSemaphoreTake(sys_cmd_response_buffer.mutex, portMAX_DELAY);
+	push_response(response_buffer, response_length);
+}
+
+
+/**
+ * Convert one segment of lepton data in the specified segment buffer into a json
+ * record with delimitors for transmission over the network
+ */
+static int process_segment(lep_segment_buffer_t* lep_segP, int seg)
+{
+	int64_t tb;
 	
-	// Only load if there's room for this response
-	if (response_length <= (CMD_RESPONSE_BUFFER_LEN - sys_cmd_response_buffer.length)) {
-		for (i=0; i<response_length; i++) {
-			// Push data
-			*sys_cmd_response_buffer.pushP = response_buffer[i];
-			
-			// Increment push pointer
-			if (++sys_cmd_response_buffer.pushP >= (sys_cmd_response_buffer.bufferP + CMD_RESPONSE_BUFFER_LEN)) {
-				sys_cmd_response_buffer.pushP = sys_cmd_response_buffer.bufferP;
+	tb = esp_timer_get_time();
+	
+	// Convert the segment into a json record
+	sys_image_rsp_buffer.length = json_get_image_segment_string(sys_image_rsp_buffer.bufferP+1, lep_segP, seg);
+	delimit_image_rsp_buffer();
+	
+	system_stage_time_add(&rsp_perf.encode, tb);
+	
+	return sys_image_rsp_buffer.length;
+}
+
+
+/**
+ * Send the next frame from the burst capture ring once it is frozen.  One frame is
+ * sent per call so the read-out proceeds at whatever rate the link allows without
+ * holding off other responses.
+ */
+static void process_burst(int if_type)
+{
+	int count;
+	int32_t msec;
+	int64_t tb;
+	lep_buffer_t* burst_bufP;
+	
+	switch (burst_get_state()) {
+		case BURST_STATE_ARMED:
+		case BURST_STATE_TRIGGERED:
+			// Wait for the capture to complete
+			return;
+		
+		case BURST_STATE_FROZEN:
+			count = burst_get_frame_count();
+			burst_bufP = burst_get_frame(burst_send_index, &msec);
+			if (burst_bufP != NULL) {
+				tb = esp_timer_get_time();
+				sys_image_rsp_buffer.length = json_get_burst_image_string(sys_image_rsp_buffer.bufferP+1, burst_bufP,
+				                                                          burst_send_index, count, burst_get_trigger_index(), msec);
+				delimit_image_rsp_buffer();
+				system_stage_time_add(&rsp_perf.encode, tb);
+				if (sys_image_rsp_buffer.length != 0) {
+					send_image(if_type);
+				}
 			}
-		}
+			if (++burst_send_index >= count) {
+				// Done (the ring stays frozen so the host may read it again)
+				burst_sending = false;
+			}
+			break;
 		
-		sys_cmd_response_buffer.length += response_length;
+		default:
+			// Capture stopped or restarted
+			burst_sending = false;
 	}
+}
+
+
+/**
+ * Add the delimitors to the json record in sys_image_rsp_buffer
+ */
+static void delimit_image_rsp_buffer()
+{
+    if ((sys_image_rsp_buffer.length > 0) && (sys_image_rsp_buffer.length < JSON_MAX_IMAGE_TEXT_LEN-2)) {
+        // Add the delimitors
+        *sys_image_rsp_buffer.bufferP = CMD_JSON_STRING_START;
+        *(sys_image_rsp_buffer.bufferP + sys_image_rsp_buffer.length + 1) = CMD_JSON_STRING_STOP;
+        sys_image_rsp_buffer.length = sys_image_rsp_buffer.length + 2;
+    } else {
+        ESP_LOGE(TAG, "Illegal image_json_text for sys_image_rsp_buffer (%d bytes)", sys_image_rsp_buffer.length);
+        sys_image_rsp_buffer.length = 0;
+	}
+}
+
+
+/**
+ * Send the json record in sys_image_rsp_buffer
+ */
+static void send_image(int if_type)
+{
+	int64_t tb;
 	
-	xSemaphoreGive(sys_cmd_response_buffer.mutex);
+	tb = esp_timer_get_time();
+	
+	if (if_type == CTRL_IF_MODE_SIF) {
+		// Configure a SPI slave response if the slave is available,
+		// otherwise drop the response
+		if (!system_spi_slave_busy()) {
+			send_spi_image(sys_image_rsp_buffer.bufferP, sys_image_rsp_buffer.length);
+		} else {
+			return;
+		}
+	} else {
+		send_response(sys_image_rsp_buffer.bufferP, sys_image_rsp_buffer.length, false);
+	}
+	
+	system_stage_time_add(&rsp_perf.send, tb);
+	rsp_perf.images_sent++;
+}
+
+
+/**
+ * Update the image send rate at the end of each measurement period
+ */
+static void update_send_rate()
+{
+	int64_t t;
+	
+	t = esp_timer_get_time() - perf_window_usec;
+	if (t >= (RSP_PERF_WINDOW_MSEC * 1000)) {
+		rsp_perf.send_rate_x10 = (uint32_t) (((int64_t) (rsp_perf.images_sent - perf_window_images) * 10000000LL) / t);
+		perf_window_usec += t;
+		perf_window_images = rsp_perf.images_sent;
+	}
+}
+
+
+/**
+ * If streaming, determine if we have sent the required number of images if necessary
+ */
+static void count_stream_frame()
+{
+	if (stream_on && (cur_stream.num_frames != 0)) {
+		if (--stream_remaining_frames == 0) {
+			stream_on = false;
+		}
+	}
 }
@@ -27,6 +27,7 @@
 #define RSP_TASK_H
 
 #include <stdint.h>
+#include "sys_utilities.h"
 
 
 //
@@ -61,12 +62,15 @@
 // Maximum wait time for a fw_segment response to a get_fw request from this firmware before retrying
 #define RSP_MAX_FW_UPD_GET_WAIT_MSEC 10000
 
+// Period over which the image send rate is measured
+#define RSP_PERF_WINDOW_MSEC 2000
+
 // Response Task notifications
 #define RSP_NOTIFY_CMD_GET_IMG_MASK    0x00000001
 #define RSP_NOTIFY_CMD_STREAM_ON_MASK  0x00000002
 #define RSP_NOTIFY_CMD_STREAM_OFF_MASK 0x00000004
-#define RSP_NOTIFY_LEP_FRAME_MASK_0    0x00000010
-#define RSP_NOTIFY_LEP_FRAME_MASK_1    0x00000020
+#define RSP_NOTIFY_CMD_BURST_GET_MASK  0x00000008
+#define RSP_NOTIFY_LEP_SEGMENT_MASK    0x00000020
 #define RSP_NOTIFY_FW_UPD_REQ_MASK     0x00000100
 #define RSP_NOTIFY_FW_UPD_SEG_MASK     0x00000200
 #define RSP_NOTIFY_FW_UPD_EN_MASK      0x00000400
@@ -74,13 +78,27 @@
 
 
 
+//
+// RSP Task typedefs
+//
+typedef struct {
+	uint32_t images_sent;        // Images, image segments and burst images sent
+	uint32_t send_rate_x10;      // Images sent per second * 10 over the last measurement period
+	uint32_t images_unchanged;   // Images not sent while streaming because they had not changed
+	sys_stage_time_t encode;     // Converting images to json
+	sys_stage_time_t send;       // Sending images to the host
+} rsp_perf_t;
+
+
 //
 // RSP Task API
 //
 void rsp_task();
-void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames);
+void rsp_set_image_parameters(bool binary);
+void rsp_set_stream_parameters(json_stream_on_t* stream_paramsP);
 void rsp_set_cam_info_msg(uint32_t info_value, char* info_string);
 void rsp_set_fw_upd_req_info(uint32_t length, char* version);
 void rsp_set_fw_upd_seg_info(uint32_t start, uint32_t length);
+void rsp_get_perf(rsp_perf_t* perfP);
 
 #endif /* RSP_TASK_H */
\ No newline at end of file
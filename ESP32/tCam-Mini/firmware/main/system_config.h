@@ -121,6 +121,36 @@
 #define I2C_MASTER_NUM     1
 #define I2C_MASTER_FREQ_HZ 100000
 
+// Lepton
+//   Uncomment to have the Lepton send telemetry as a header (before the image data)
+//   instead of as a footer (after the image data, the Lepton's default).  Header
+//   telemetry lets duplicate frames be identified from their first segment.
+//#define LEP_TELEM_LOCATION_HEADER
+//
+//   Comment out to skip computing a histogram of each frame as it is read.  The bins
+//   span the previous frame's pixel range (the number of bins may be a power of 2 from
+//   64 to 1024).  Used by the AGC preview.
+#define LEP_HISTOGRAM_BINS 256
+//
+//   Number of frame buffers in the ring between lep_task and rsp_task (must be a power
+//   of 2).  Each is about 39 kB of PSRAM.  One is always being filled by lep_task so
+//   8 buffers hold about 800 mSec of frames while the network is stalled.
+#define LEP_FRAME_RING_SLOTS 8
+//
+//   Uncomment to discard new frames instead of the oldest unsent frame when the ring
+//   is full
+//#define LEP_FRAME_RING_DROP_NEWEST
+//
+//   Comment out to read the Lepton continuously instead of stopping VoSPI reads (except
+//   for a periodic check) while no client is using images
+#define LEP_IDLE_WHEN_UNUSED
+
+// Burst capture
+//   Number of frames held in the burst capture ring.  Each is about 39 kB of PSRAM,
+//   allocated only while a capture is in progress.  48 frames hold about 5.5 seconds
+//   of images.
+#define BURST_NUM_FRAMES 48
+
 // SPI
 //   Lepton uses HSPI (no MOSI)
 //   Host SPI Slave uses VSPI (no MOSI)
@@ -128,6 +158,18 @@
 #define LEP_DMA_NUM     2
 #define LEP_SPI_FREQ_HZ 16000000
 
+// Comment out to read every VoSPI segment instead of skipping the segments between
+// the last segment of a frame and the expected first segment of the next frame
+#define LEP_PHASE_LOCK
+
+// Comment out to read VoSPI segments with one polled SPI transaction per packet
+// instead of queueing a segment's worth of packets as DMA transactions
+#define LEP_SPI_SEG_DMA
+
+// Comment out to skip the VoSPI packet CRC check (frames containing a packet with
+// a bad CRC are discarded)
+#define LEP_SPI_CHECK_CRC
+
 #define HOST_SPI_HOST   VSPI_HOST
 #define HOST_DMA_NUM    1
 #define HOST_SPI_MODE   0
@@ -35,6 +35,11 @@
  * packet with an unexpected count it resets.  If it has previously triggered
  * PRU1 to start reading out packets then it sends an abort notification to PRU1.
  *
+ * When CHECK_CRC is defined this PRU also computes the CRC of each non-discard
+ * packet as it is read and treats a packet with a bad CRC like a packet with an
+ * unexpected count (the frame is aborted).  This adds a table lookup per byte,
+ * stretching the packet read by about 8 uSec.
+ *
  * PRU1 sets an enable locatation in shared memory buffer to 1 to indicate when
  * to run.  Otherwise this PRU spins waiting to be enabled.
  *
@@ -74,6 +79,9 @@
 #define RESYNC_THRESHOLD_USEC 200000
 #define RESYNC_THRESHOLD_COUNT (RESYNC_THRESHOLD_USEC / PKT_SAMPLE_USEC)
 
+/* Comment out to skip checking the CRC of each packet */
+#define CHECK_CRC
+
 /* PRU Cycles to reset Lepton -> 185 mSec */
 #define LEP_RESYNC_USEC 190000
 #define LEP_RESYNC_CYCLES (LEP_RESYNC_USEC * PRU_CLK_PER_USEC)
@@ -98,6 +106,9 @@
 #define LEP_PACKET_SIZE      164 // Bytes
 #define LEP_PACKET_DATA_SIZE 160 // Bytes
 
+/* CRC16 polynomial (x^16 + x^12 + x^5 + x^0) */
+#define LEP_CRC16_POLY       0x1021
+
 
 /* --------- */
 /* Run state */
@@ -135,11 +146,34 @@ uint8_t cur_count = 0;   /* 0 - 239 */
 uint16_t lep_resync_count = 0; /* Counts sample intervals, reset each trigger */
 uint32_t lep_discard_pkt_count = 0;  /* Counts consecutive Lepton discard packets in a row */
                                      /* for diag purposes to read out with prudebug */
+uint32_t lep_crc_err_count = 0;      /* Counts packets with a bad CRC */
+                                     /* for diag purposes to read out with prudebug */
+#ifdef CHECK_CRC
+uint16_t crc16_table[256];           /* CRC16 byte-wise lookup table */
+#endif
 
 
 /* =========== */
 /* Subroutines */
 /* =========== */
+#ifdef CHECK_CRC
+void init_crc16_table()
+{
+	uint16_t i;
+	uint8_t j;
+	uint16_t crc;
+
+	for (i=0; i<256; i++) {
+		crc = i << 8;
+		for (j=0; j<8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ LEP_CRC16_POLY : (crc << 1);
+		}
+		crc16_table[i] = crc;
+	}
+}
+#endif
+
+
 void init_pru()
 {
 	/* Enable OCP Master Port */
@@ -152,6 +186,10 @@ void init_pru()
 	SET_PIN(CSN,1);
 	SET_PIN(CLK,1);
 
+#ifdef CHECK_CRC
+	init_crc16_table();
+#endif
+
 	/* Slow blink the LED to let them know we've started */
 	SET_PIN(LED,1);
 	__delay_cycles(100000000);
@@ -228,12 +266,22 @@ uint8_t get_packet()
 	uint8_t i;
 	uint8_t pktNumHigh;
 	uint8_t pktNumLow;
+#ifdef CHECK_CRC
+	uint16_t pktCrc;
+	uint8_t d;
+	uint16_t crc;
+#endif
 
 	/* Read one packet */
 	pktNumHigh = spi_read8();  /* TTT bits and discard indication */
 	pktNumLow = spi_read8();   /* Packet number */
-	i = spi_read8();           /* Throw away CRC for now */
-	i = spi_read8();           /* Throw away CRC for now */
+#ifdef CHECK_CRC
+	pktCrc = spi_read8() << 8; /* CRC */
+	pktCrc |= spi_read8();
+#else
+	(void) spi_read8();        /* CRC */
+	(void) spi_read8();
+#endif
 
 	/* Look to see if we should discard this packet */
 	if (((pktNumHigh & 0x0F) == 0x0F) || (run_state == RUN_STATE_DISCARD)) {
@@ -254,6 +302,31 @@ uint8_t get_packet()
 	/* Reset consecutive discard count */
 	lep_discard_pkt_count = 0;
 
+#ifdef CHECK_CRC
+	/* CRC is computed with the TTT bits and CRC field zeroed */
+	crc = crc16_table[pktNumHigh & 0x0F];
+	crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ pktNumLow];
+	crc = (crc << 8) ^ crc16_table[crc >> 8];
+	crc = (crc << 8) ^ crc16_table[crc >> 8];
+
+	/* Store packet - low 8-bits of each word */
+	for (i=0; i<LEP_PACKET_DATA_SIZE/2; i++) {
+		d = spi_read8();                   /* High half only used for CRC */
+		crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ d];
+		d = spi_read8();                   /* Store low half - output of AGC module */
+		crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ d];
+		*buf_cur_ptr++ = d;
+		if (buf_cur_ptr > SMEM_BUF_END) {
+			buf_cur_ptr = SMEM_BUF_START;
+		}
+	}
+
+	if (crc != pktCrc) {
+		/* Corrupted packet */
+		++lep_crc_err_count;
+		return PKT_ILLEGAL;
+	}
+#else
 	/* Store packet - low 8-bits of each word */
 	for (i=0; i<LEP_PACKET_DATA_SIZE/2; i++) {
 		(void) spi_read8();                /* Skip high half */
@@ -262,6 +335,7 @@ uint8_t get_packet()
 			buf_cur_ptr = SMEM_BUF_START;
 		}
 	}
+#endif
 
 	/* Update state */
 	if (pktNumLow == 20) {